@@ -0,0 +1,126 @@
+/*
+ * Bus time of a typical second of I2C traffic, all at 100kHz vs. at
+ * the clocks of i2cClock[] in tc_i2c.cpp, through the queue of
+ * tc_i2cq.h. The bus is a bit-timing model (9 bits per byte, start,
+ * stop, repeated start); driver overhead is not included. Run by
+ * "make bench".
+ */
+
+#include <stdio.h>
+
+#include "tc_i2c.h"
+#include "tc_i2cq.h"
+
+// As in tc_i2c.cpp
+static const uint16_t i2cClock[I2CD_NUM] = {
+    400, 400, 400,  // HT16K33
+    100,            // Speedo
+    100,            // Keypad
+    100, 100,       // Rotary encoders
+    400,            // DS3231, PCF2129
+    400,            // GPS
+    100, 100        // Sensors
+};
+
+struct ModelBus {
+    uint32_t now = 0;           // ns
+    uint16_t clk = I2CQ_SLOWCLK;
+    int      clockChanges = 0;
+
+    int xfer(uint8_t, const uint8_t *, int wlen, uint8_t *, int rlen, bool rstart)
+    {
+        uint32_t bits = 2 + 9 * (1 + wlen);
+
+        if(rlen) bits += (rstart ? 1 : 2) + 9 * (1 + rlen);
+        now += bits * 1000000 / clk;
+        return rlen;
+    }
+    void setClock(uint16_t khz) { clk = khz; clockChanges++; }
+    uint32_t micros() { return now / 1000; }
+};
+
+// Per second: device, rate, bytes written, bytes read
+static const struct {
+    int dev, hz, wlen, rlen;
+} load[] = {
+    { I2CD_DEST,   20, 17, 0 },
+    { I2CD_PRES,   20, 17, 0 },
+    { I2CD_DEPT,   20, 17, 0 },
+    { I2CD_SPEED,  20, 17, 0 },
+    { I2CD_KEYPAD, 50, 1,  1 },
+    { I2CD_RTC,    1,  1,  7 },
+    { I2CD_GPS,    5,  1,  64 },
+    { I2CD_TEMP,   1,  1,  6 },
+    { I2CD_LIGHT,  1,  1,  2 },
+};
+
+static I2CQueue q;
+static uint8_t  rbuf[64];
+
+static void run(bool fast, ModelBus& bus)
+{
+    i2cq_init(&q);
+    for(int i = 0; i < I2CD_NUM; i++) {
+        if(fast) i2cq_setClock(&q, i, i2cClock[i]);
+    }
+
+    for(int ms = 0; ms < 1000; ms++) {
+        I2CTxn *t;
+        if(bus.now < ms * 1000000u) bus.now = ms * 1000000u;
+        for(const auto& l : load) {
+            if(ms % (1000 / l.hz)) continue;
+            t = i2cq_alloc(&q);
+            t->dev = l.dev;
+            t->addr = 0x70 + l.dev;
+            t->wlen = l.wlen;
+            t->wbuf = t->data;
+            t->rlen = l.rlen;
+            t->rbuf = rbuf;
+            t->flags = l.rlen ? I2CT_RSTART : 0;
+            i2cq_push(&q, t, bus.micros());
+        }
+        while((t = i2cq_pop(&q, bus.micros()))) {
+            i2cq_exec(&q, t, bus);
+            i2cq_free(&q, t);
+        }
+    }
+}
+
+static uint32_t busTime(int from, int to)
+{
+    uint32_t us = 0;
+
+    for(int i = from; i <= to; i++) us += q.stats[i].us;
+    return us;
+}
+
+int main()
+{
+    static const struct {
+        const char *name;
+        int from, to;
+    } groups[] = {
+        { "displays", I2CD_DEST, I2CD_DEPT },
+        { "speedo", I2CD_SPEED, I2CD_SPEED },
+        { "keypad", I2CD_KEYPAD, I2CD_KEYPAD },
+        { "RTC", I2CD_RTC, I2CD_RTC },
+        { "GPS", I2CD_GPS, I2CD_GPS },
+        { "sensors", I2CD_TEMP, I2CD_LIGHT },
+        { "total", 0, I2CD_NUM - 1 },
+    };
+    uint32_t slow[7], fast[7];
+    ModelBus b1, b2;
+
+    run(false, b1);
+    for(int i = 0; i < 7; i++) slow[i] = busTime(groups[i].from, groups[i].to);
+    run(true, b2);
+    for(int i = 0; i < 7; i++) fast[i] = busTime(groups[i].from, groups[i].to);
+
+    printf("  Bus time per second        100kHz     i2cClock[]\n");
+    for(int i = 0; i < 7; i++) {
+        printf("  %-22s %8.1f ms  %8.1f ms\n", groups[i].name, slow[i] / 1e3, fast[i] / 1e3);
+    }
+    printf("  Clock switches per second: %d\n", b2.clockChanges);
+
+    return 0;
+}
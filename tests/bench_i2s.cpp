@@ -0,0 +1,106 @@
+/*
+ * CPU time per second of 44.1kHz stereo audio spent pushing samples
+ * through AudioOutputI2S: One ConsumeSample() per frame as the MP3 and
+ * WAV generators did before vs. ConsumeSamples() with a 32-frame MP3
+ * synth block. i2s_write() is a memcpy into a DMA-sized buffer, so the
+ * numbers are the cost of the calls and the gain stage only. Run by
+ * "make bench".
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "driver/i2s.h"
+#include "src/ESP8266Audio/AudioOutputI2S.h"
+
+#define RATE    44100
+#define SECONDS 100
+#define BLOCK   32
+
+// 8 DMA buffers of 64 frames, like AudioOutputI2S's defaults
+static uint8_t dma[8 * 64 * 4];
+static size_t dmaPos;
+
+esp_err_t i2s_write(i2s_port_t, const void *src, size_t size, size_t *written, uint32_t)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    size_t n = size;
+
+    while(n) {
+        size_t c = sizeof(dma) - dmaPos;
+        if(c > n) c = n;
+        memcpy(dma + dmaPos, s, c);
+        dmaPos = (dmaPos + c) % sizeof(dma);
+        s += c;
+        n -= c;
+    }
+    *written = size;
+    return ESP_OK;
+}
+
+static double cpuNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// One MP3 synth block, planar like mad_pcm
+static int16_t pcm[2][BLOCK];
+static volatile uint32_t sink;
+
+static double runSingle(AudioOutput *out)
+{
+    double t0 = cpuNow();
+
+    for(int s = 0; s < SECONDS; s++) {
+        for(int f = 0; f < RATE; f += BLOCK) {
+            for(int i = 0; i < BLOCK; i++) {
+                if(!out->ConsumeSample(pcm[0][i], pcm[1][i])) break;
+            }
+        }
+    }
+    sink += dma[dmaPos];
+
+    return cpuNow() - t0;
+}
+
+static double runBlock(AudioOutput *out)
+{
+    double t0 = cpuNow();
+
+    for(int s = 0; s < SECONDS; s++) {
+        for(int f = 0; f < RATE; f += BLOCK) {
+            out->ConsumeSamples(pcm[0], pcm[1], 1, BLOCK);
+        }
+    }
+    sink += dma[dmaPos];
+
+    return cpuNow() - t0;
+}
+
+int main(int, char **argv)
+{
+    AudioOutputI2S *out = new AudioOutputI2S(0, AudioOutputI2S::EXTERNAL_I2S, 8, AudioOutputI2S::APLL_DISABLE);
+    double tOld, tNew;
+
+    for(int i = 0; i < BLOCK; i++) {
+        pcm[0][i] = i * 1021;
+        pcm[1][i] = -i * 977;
+    }
+
+    out->begin();
+    out->SetGain(0.5);
+
+    runSingle(out);     // warm up
+    tOld = runSingle(out);
+    tNew = runBlock(out);
+
+    printf("%s:\n", argv[0]);
+    printf("  %-28s old %8.1f us, new %6.1f us, %5.1fx\n", "CPU per second of audio",
+           tOld * 1e6 / SECONDS, tNew * 1e6 / SECONDS, tOld / tNew);
+
+    delete out;
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Timing of the renamer sort (tc_mpsort.h) against the insertion sort
+ * with mpren_strGT() that tc_audio.cpp had before, copied as it was.
+ * Checks that both give the same order. Run by "make bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <string>
+
+#include "tc_mpsort.h"
+
+namespace old {
+
+static unsigned char mpren_toUpper(char a)
+{
+    if(a >= 'a' && a <= 'z')
+        a &= ~0x20;
+
+    return (unsigned char)a;
+}
+
+static bool mpren_strGT(const char *a, const char *b)
+{
+    int aa = strlen(a);
+    int bb = strlen(b);
+    int cc = aa < bb ? aa : bb;
+
+    for(int i = 0; i < cc; i++) {
+        unsigned char aaa = mpren_toUpper(*a);
+        unsigned char bbb = mpren_toUpper(*b);
+        if(aaa < bbb) return false;
+        if(aaa > bbb) return true;
+        a++; b++;
+    }
+
+    return false;
+}
+
+static void mpren_insertionSort(char **a, int n)
+{
+    for(int i = 1; i < n; i++) {
+        char *k = a[i];
+        int j = i - 1;
+        while(j >= 0 && mpren_strGT(a[j], k)) {
+            a[j+1] = a[j];
+            j--;
+        }
+        a[j + 1] = k;
+    }
+}
+
+}
+
+#define RUNS 5
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Names as found on a card: a few artists, many titles, all ".mp3"
+static std::string randName()
+{
+    static const char *artist[] = { "The Beatles - ", "the beatles - ", "ABBA - ", "Huey Lewis - ", "" };
+    std::string s = artist[rnd() % 5];
+    int n = 4 + rnd() % 20;
+
+    for(int i = 0; i < n; i++) {
+        s += "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789"[rnd() % 63];
+    }
+
+    return s + ".mp3";
+}
+
+static void bench(int n)
+{
+    std::vector<std::string> names;
+    std::vector<char *>      a(n);
+    std::vector<MpSortEnt>   b(n), tmp(n);
+    double tOld = 0, tNew = 0, t;
+
+    for(int i = 0; i < n; i++) {
+        names.push_back(randName());
+    }
+
+    for(int r = 0; r < RUNS; r++) {
+        for(int i = 0; i < n; i++) {
+            a[i] = &names[i][0];
+        }
+        t = now();
+        old::mpren_insertionSort(a.data(), n);
+        tOld += now() - t;
+
+        t = now();
+        for(int i = 0; i < n; i++) {
+            mpsort_setEnt(&b[i], &names[i][0]);
+        }
+        mpsort_sort(b.data(), tmp.data(), n);
+        tNew += now() - t;
+    }
+
+    for(int i = 0; i < n; i++) {
+        if(a[i] != b[i].name) {
+            printf("%d names: order differs at #%d ('%s' vs '%s')\n", n, i, a[i], b[i].name);
+            exit(1);
+        }
+    }
+
+    printf("  %5d names: insertion/strGT %6.1fms, merge/keys %4.1fms\n", n,
+           tOld * 1e3 / RUNS, tNew * 1e3 / RUNS);
+}
+
+int main()
+{
+    bench(1000);
+    bench(5000);
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * Timing of the calendar and time zone code against the functions
+ * it replaced (old_time.h). Run by "make bench"; the numbers are host numbers
+ * and only good for comparing the two.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "time_stub.h"
+#include "time_impl.h"
+#include "old_time.h"
+
+#define COUNT 1000000
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct {
+    int y, m, d, h, mi;
+} dates[COUNT];
+
+static volatile uint64_t sink;
+
+static void report(const char *what, double tOld, double tNew, int count)
+{
+    printf("  %-28s old %8.1f ns, new %6.1f ns, %5.1fx\n", what,
+           tOld * 1e9 / count, tNew * 1e9 / count, tOld / tNew);
+}
+
+// dateToMins() and back, random dates of the years 0-9999
+static void benchCalendar()
+{
+    double t0, t1, t2;
+    uint64_t s = 0;
+    int y, m, d, h, mi;
+
+    for(int i = 0; i < COUNT; i++) {
+        dates[i].y = rnd() % 10000;
+        dates[i].m = 1 + rnd() % 12;
+        dates[i].d = 1 + rnd() % 28;
+        dates[i].h = rnd() % 24;
+        dates[i].mi = rnd() % 60;
+    }
+
+    t0 = now();
+    for(int i = 0; i < COUNT; i++) {
+        old::minsToDate(old::dateToMins(dates[i].y, dates[i].m, dates[i].d, dates[i].h, dates[i].mi), y, m, d, h, mi);
+        s += y + d + mi;
+    }
+    t1 = now();
+    for(int i = 0; i < COUNT; i++) {
+        minsToDate(dateToMins(dates[i].y, dates[i].m, dates[i].d, dates[i].h, dates[i].mi), y, m, d, h, mi);
+        s += y + d + mi;
+    }
+    t2 = now();
+    sink = s;
+
+    report("dateToMins+minsToDate", t1 - t0, t2 - t1, COUNT);
+}
+
+// convTime() with offsets of up to three days
+static void benchConv()
+{
+    static int diffs[COUNT];
+    double t0, t1, t2;
+    uint64_t s = 0;
+
+    for(int i = 0; i < COUNT; i++) {
+        diffs[i] = (int)(rnd() % (2*3*24*60+1)) - 3*24*60;
+    }
+
+    t0 = now();
+    for(int i = 0; i < COUNT; i++) {
+        int y = dates[i].y + 1, m = dates[i].m, d = dates[i].d, h = dates[i].h, mi = dates[i].mi;
+        old::convTime(diffs[i], y, m, d, h, mi);
+        s += y + d + mi;
+    }
+    t1 = now();
+    for(int i = 0; i < COUNT; i++) {
+        int y = dates[i].y + 1, m = dates[i].m, d = dates[i].d, h = dates[i].h, mi = dates[i].mi;
+        convTime(diffs[i], y, m, d, h, mi);
+        s += y + d + mi;
+    }
+    t2 = now();
+    sink = s;
+
+    report("convTime, up to +-3 days", t1 - t0, t2 - t1, COUNT);
+}
+
+/*
+ * World Clock: three zones converted every second, over a year;
+ * one zone east of UTC, two west, one of them on a half hour
+ */
+static void setZone(int index, const char *tz)
+{
+    char *s = index == 0 ? settings.timeZone : (index == 1 ? settings.timeZoneDest : settings.timeZoneDep);
+
+    strcpy(s, tz);
+    parseTZ(index, 2025);
+}
+
+static void benchWC()
+{
+    const time_t start = 1735689600, secs = 365 * 86400;
+    double tOld = 0, tNew = 0, t0;
+    uint64_t s = 0;
+    DateTime dtl;
+
+    setZone(0, "CET-1CEST,M3.5.0,M10.5.0/3");
+    setZone(1, "NST3:30NDT,M3.2.0,M11.1.0");
+    setZone(2, "PST8PDT,M3.2.0,M11.1.0");
+
+    // A day's worth of seconds at a time, so the clock reads add nothing
+    for(time_t day = start; day < start + secs; day += 86400) {
+        static DateTime u[86400];
+        for(int i = 0; i < 86400; i++) {
+            time_t tt = day + i;
+            struct tm tu;
+            gmtime_r(&tt, &tu);
+            u[i].set(tu.tm_year + 1900, tu.tm_mon + 1, tu.tm_mday, tu.tm_hour, tu.tm_min, tu.tm_sec);
+        }
+        t0 = now();
+        for(int i = 0; i < 86400; i++) {
+            for(int z = 0; z < 3; z++) {
+                old::UTCtoLocal(u[i], dtl, z);
+                s += dtl.day() + dtl.minute();
+            }
+        }
+        tOld += now() - t0;
+        t0 = now();
+        for(int i = 0; i < 86400; i++) {
+            for(int z = 0; z < 3; z++) {
+                UTCtoLocal(u[i], dtl, z);
+                s += dtl.day() + dtl.minute();
+            }
+        }
+        tNew += now() - t0;
+    }
+    sink = s;
+
+    report("3-zone UTCtoLocal per second", tOld, tNew, secs);
+}
+
+/*
+ * Per second in WC mode: present time every second, destination
+ * and departed when the minute changes; three UTCtoLocal() calls
+ * as main_loop() did before vs. updateAllTimes()
+ */
+static DateTime wcDest, wcDep;
+
+static void setDatesTimesWCInt(const DateTime& dtu, int32_t *utcDayNum)
+{
+    UTCtoLocalInt(dtu, wcDest, 1, utcDayNum);
+    UTCtoLocalInt(dtu, wcDep, 2, utcDayNum);
+}
+
+static void benchAllTimes()
+{
+    const time_t start = 1735689600, secs = 365 * 86400;
+    double tOld = 0, tNew = 0, t0;
+    uint64_t s = 0;
+    int lastMin = -1;
+
+    wcMode = true;
+
+    for(time_t day = start; day < start + secs; day += 86400) {
+        static DateTime u[86400];
+        for(int i = 0; i < 86400; i++) {
+            time_t tt = day + i;
+            struct tm tu;
+            gmtime_r(&tt, &tu);
+            u[i].set(tu.tm_year + 1900, tu.tm_mon + 1, tu.tm_mday, tu.tm_hour, tu.tm_min, tu.tm_sec);
+        }
+        t0 = now();
+        for(int i = 0; i < 86400; i++) {
+            old::UTCtoLocal(u[i], gdtl, 0);
+            if(u[i].minute() != lastMin) {
+                lastMin = u[i].minute();
+                old::UTCtoLocal(u[i], wcDest, 1);
+                old::UTCtoLocal(u[i], wcDep, 2);
+            }
+            s += gdtl.day() + wcDest.minute() + wcDep.minute();
+        }
+        tOld += now() - t0;
+        t0 = now();
+        for(int i = 0; i < 86400; i++) {
+            updateAllTimes(u[i]);
+            s += gdtl.day() + wcDest.minute() + wcDep.minute();
+        }
+        tNew += now() - t0;
+    }
+    sink = s;
+
+    report("WC mode, per second", tOld, tNew, secs);
+}
+
+int main(int, char **argv)
+{
+    #ifdef TC_JULIAN_CAL
+    old::calcJulianData();
+    #endif
+
+    printf("%s:\n", argv[0]);
+    benchCalendar();
+    benchConv();
+    benchWC();
+    benchAllTimes();
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Copy the calendar and time zone code out of tc_main.cpp, as is, 
+# for test_time. Each section runs from the line starting with the
+# first marker up to the one starting with the second; a marker in
+# a comment block takes the whole block along (or leaves it out).
+#
+
+src=${1:-../timecircuits-A10001986/tc_main.cpp}
+
+sect()
+{
+    awk -v s="$1" -v e="$2" '
+    { l[NR] = $0 }
+    END {
+        for(i = 1; i <= NR && index(l[i], s) != 1; i++) ;
+        for(j = i; j <= NR && index(l[j], e) != 1; j++) ;
+        if(i > NR || j > NR) exit 1
+        if(substr(l[i], 1, 2) == " *") while(substr(l[i], 1, 2) != "/*") i--
+        if(substr(l[j], 1, 2) == " *") while(substr(l[j], 1, 2) != "/*") j--
+        for(k = i; k < j; k++) print l[k]
+    }' "$src" || { echo "extract.sh: \"$1\" not found in $src" >&2; exit 1; }
+}
+
+echo "// Generated by extract.sh from $src"
+sect "// Time calculations" "/// Native NTP"
+sect "// TZ/DST status & data" "#ifdef TC_DBG_BOOT"
+sect "// Date & time stuff" "#define a(f, j)"
+sect " * Return doW from given date" " * Return RTC-fit year"
+sect " ***               Timezone and DST handling" " ***                       Native NTP"
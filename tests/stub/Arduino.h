@@ -0,0 +1,64 @@
+// Just enough of Arduino.h for the host builds in tests/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+
+struct HostSerial {
+    void println(const char *) { }
+    void printf(const char *, ...) { }
+};
+static HostSerial Serial __attribute__((unused));
+
+typedef uint8_t byte;
+
+using std::min;
+using std::max;
+
+// No separate flash address space on the host
+#define PSTR(s)             (s)
+#define memcpy_P(d, s, n)   memcpy(d, s, n)
+
+#ifdef HOST_CLOCK
+// The test keeps the time
+uint32_t micros();
+unsigned long millis();
+void delay(unsigned long ms);
+#else
+static inline void delay(unsigned long) { }
+
+static inline uint32_t micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline unsigned long millis()
+{
+    return micros() / 1000;
+}
+#endif
+
+static inline uint32_t esp_random()
+{
+    return rand();
+}
+
+#define LOW             0
+#define HIGH            1
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+
+// Up to the test
+bool psramFound();
+void pinMode(uint8_t pin, uint8_t mode);
+int  digitalRead(uint8_t pin);
@@ -0,0 +1,71 @@
+// In-memory files for the host tests. The firmware's SD.h is kept
+// out (its include guard is defined here); SD and LittleFS are both
+// a HostFS. Reads can be slowed down to stand in for the SD card.
+#pragma once
+
+#define _SD_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#define FILE_READ "r"
+
+struct HostFileData {
+    std::vector<uint8_t> data;
+    time_t   mtime = 0;
+    uint32_t readDelay = 0;     // us per read() call
+    uint32_t bytesRead = 0;
+};
+
+class File
+{
+  public:
+    File(HostFileData *d = NULL) : d(d) { }
+
+    size_t read(uint8_t *buf, size_t len)
+    {
+        if(!d) return 0;
+        if(d->readDelay) std::this_thread::sleep_for(std::chrono::microseconds(d->readDelay));
+        if(len > d->data.size() - pos) len = d->data.size() - pos;
+        memcpy(buf, d->data.data() + pos, len);
+        pos += len;
+        d->bytesRead += len;
+        return len;
+    }
+    bool seek(uint32_t p)
+    {
+        if(!d || p > d->data.size()) return false;
+        pos = p;
+        return true;
+    }
+    size_t position() const { return pos; }
+    size_t size() const     { return d ? d->data.size() : 0; }
+    time_t getLastWrite()   { return d ? d->mtime : 0; }
+    void close()            { d = NULL; pos = 0; }
+    operator bool() const   { return d != NULL; }
+
+  private:
+    HostFileData *d;
+    uint32_t     pos = 0;
+};
+
+class HostFS
+{
+  public:
+    File open(const char *name, const char *)
+    {
+        auto i = files.find(name);
+        return File(i == files.end() ? NULL : &i->second);
+    }
+
+    std::map<std::string, HostFileData> files;
+};
+
+// Defined by the test
+extern HostFS SD, LittleFS;
@@ -0,0 +1,4 @@
+// See FS.h
+#pragma once
+
+#include "FS.h"
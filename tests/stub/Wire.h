@@ -0,0 +1,19 @@
+// The I2C bus; the test puts its fake devices behind it
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class TwoWire {
+  public:
+    bool    begin(int sda = -1, int scl = -1, uint32_t freq = 0);
+    bool    setClock(uint32_t freq);
+    void    beginTransmission(uint8_t addr);
+    size_t  write(uint8_t data);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t addr, uint8_t len, bool sendStop = true);
+    int     available();
+    int     read();
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,10 @@
+// PSRAM is the normal heap on the host
+#pragma once
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT   (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+static inline void *heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+static inline void *heap_caps_realloc(void *p, size_t size, uint32_t) { return realloc(p, size); }
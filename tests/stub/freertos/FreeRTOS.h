@@ -0,0 +1,87 @@
+// FreeRTOS tasks, notifications and mutexes on host threads;
+// just what the firmware's tasks use.
+#pragma once
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE          1
+#define pdFALSE         0
+#define pdPASS          1
+#define portMAX_DELAY   0xffffffff
+
+struct HostTask {
+    std::mutex              m;
+    std::condition_variable cv;
+    uint32_t                notify = 0;
+};
+typedef HostTask *TaskHandle_t;
+typedef std::mutex *SemaphoreHandle_t;
+
+static inline HostTask *&hostCurrentTask()
+{
+    static thread_local HostTask *t = NULL;
+    return t;
+}
+
+// Tasks run detached, forever
+static inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *, uint32_t,
+                                                 void *param, UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+    HostTask *t = new HostTask;
+    *handle = t;
+    std::thread([fn, param, t] {
+        hostCurrentTask() = t;
+        fn(param);
+    }).detach();
+    return pdPASS;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t)
+{
+    HostTask *t = hostCurrentTask();
+    std::unique_lock<std::mutex> l(t->m);
+    uint32_t n;
+    t->cv.wait(l, [t] { return t->notify != 0; });
+    n = t->notify;
+    t->notify = clear ? 0 : n - 1;
+    return n;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t t)
+{
+    std::lock_guard<std::mutex> l(t->m);
+    t->notify++;
+    t->cv.notify_one();
+    return pdPASS;
+}
+
+// Ticks are 100us here, so tests that wait don't take long
+static inline void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(ticks * 100));
+}
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new std::mutex;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t)
+{
+    s->lock();
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    s->unlock();
+    return pdTRUE;
+}
@@ -0,0 +1,29 @@
+/*
+ * Minimal checks for the host tests: Failures are counted, the
+ * first few are printed.
+ */
+
+#ifndef _TEST_H
+#define _TEST_H
+
+#include <stdio.h>
+
+static long fails = 0;
+
+#define CHECK(c, ...) do {                                  \
+    if(!(c)) {                                              \
+        if(fails++ < 10) {                                  \
+            printf("%s:%d: ", __FILE__, __LINE__);          \
+            printf(__VA_ARGS__);                            \
+            printf("\n");                                   \
+        }                                                   \
+    }                                                       \
+} while(0)
+
+static int testResult(const char *name)
+{
+    printf("%s: %s, %ld failures\n", name, fails ? "FAILED" : "ok", fails);
+    return fails ? 1 : 0;
+}
+
+#endif
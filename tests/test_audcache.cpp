@@ -0,0 +1,212 @@
+/*
+ * Decoded sound cache (tc_audcache.cpp): Budget, LRU eviction, the
+ * entry being played, flush. Built with ASan, which also catches
+ * buffers the cache leaks or frees twice.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "tc_audcache.h"
+
+#define ROUNDS 20000
+
+static bool havePSRAM;
+
+bool psramFound()
+{
+    return havePSRAM;
+}
+
+// Sounds are filled with a pattern derived from the name
+static int16_t seed(const char *name)
+{
+    int16_t h = 0;
+    while(*name) h = h * 33 + *name++;
+    return h;
+}
+
+static int16_t *mkSound(const char *name, uint32_t bytes)
+{
+    int16_t *pcm = audc_alloc(bytes);
+    int16_t s = seed(name);
+
+    for(uint32_t i = 0; i < bytes / 2; i++) {
+        pcm[i] = (int16_t)(i * 31 + s);
+    }
+    return pcm;
+}
+
+// Every 61st sample and the last one
+static bool sndOk(const AudCacheEntry *e, const char *name)
+{
+    uint32_t n = e->bytes / 2;
+    int16_t s = seed(name);
+
+    if(e->pcm[n - 1] != (int16_t)((n - 1) * 31 + s)) return false;
+    for(uint32_t i = 0; i < n; i += 61) {
+        if(e->pcm[i] != (int16_t)(i * 31 + s)) return false;
+    }
+    return true;
+}
+
+static void add(const char *name, uint32_t bytes)
+{
+    audc_insert(name, mkSound(name, bytes), bytes, 44100, 1);
+}
+
+static void testBasics()
+{
+    const AudCacheEntry *e, *e2;
+    const AudCacheStats *s = audc_getStats();
+    char name[40];
+
+    havePSRAM = false;
+    audc_setup();
+    CHECK(s->budget == AUDC_BUDGET_HEAP && audc_maxSound() == AUDC_MAXSND_HEAP, "heap budget");
+
+    // 4 x 10K fit into 48K
+    add("/key1.mp3", 10000);
+    add("/key2.mp3", 10000);
+    add("/key3.mp3", 10000);
+    add("/key4.mp3", 10000);
+    CHECK(s->bytes == 40000 && s->inserts == 4 && !s->evictions, "4 inserts: %u bytes", s->bytes);
+
+    // key1 was used last, so key2 goes first
+    e = audc_find("/key1.mp3");
+    CHECK(e && e->bytes == 10000 && e->rate == 44100 && sndOk(e, "/key1.mp3"), "find key1");
+    add("/key5.mp3", 10000);
+    CHECK(!audc_find("/key2.mp3") && audc_find("/key1.mp3") && audc_find("/key3.mp3"), "LRU");
+    CHECK(s->evictions == 1 && s->bytes == 40000, "evictions %u", s->evictions);
+
+    // Same name replaces
+    add("/key3.mp3", 2000);
+    e = audc_find("/key3.mp3");
+    CHECK(e && e->bytes == 2000 && sndOk(e, "/key3.mp3") && s->bytes == 32000, "replace");
+
+    // Rejects, and the buffers are freed (ASan)
+    add("/big.mp3", AUDC_MAXSND_HEAP + 2);
+    add("", 100);
+    memset(name, 'a', sizeof(name) - 1);
+    name[sizeof(name) - 1] = 0;
+    add(name, 100);
+    CHECK(s->rejects == 3 && !audc_find("/big.mp3"), "rejects %u", s->rejects);
+    CHECK(!audc_insert("/null.mp3", NULL, 100, 44100, 1), "NULL pcm");
+
+    // The entries being played (one per mixer voice) survive eviction
+    // and replacement
+    e = audc_find("/key4.mp3");
+    e2 = audc_find("/key1.mp3");
+    audc_setInUse(0, e);
+    audc_setInUse(1, e2);
+    for(int i = 0; i < 20; i++) {
+        snprintf(name, sizeof(name), "/fill%d.mp3", i);
+        add(name, 12000);
+    }
+    CHECK(audc_find("/key4.mp3") == e && sndOk(e, "/key4.mp3"), "in use evicted");
+    CHECK(audc_find("/key1.mp3") == e2 && sndOk(e2, "/key1.mp3"), "in use (voice 1) evicted");
+    CHECK(s->bytes <= s->budget, "over budget");
+    CHECK(!audc_insert("/key4.mp3", mkSound("/key4.mp3", 100), 100, 44100, 1), "in use replaced");
+
+    // Flush keeps them until they are no longer played, but they can't
+    // be found
+    audc_flush();
+    CHECK(!audc_find("/key4.mp3") && !audc_find("/key1.mp3") && s->bytes == 20000, "flush in use");
+    CHECK(sndOk(e, "/key4.mp3") && sndOk(e2, "/key1.mp3"), "flush in use freed");
+    audc_setInUse(0, NULL);
+    audc_setInUse(1, NULL);
+    add("/big1.mp3", 16000);
+    add("/big2.mp3", 16000);
+    add("/big3.mp3", 16000);
+    CHECK(s->bytes == 48000, "unnamed entries not evicted: %u", s->bytes);
+
+    audc_flush();
+    CHECK(!s->bytes, "flush: %u bytes left", s->bytes);
+}
+
+// Random inserts and lookups against a model of the use order
+static void testRandom()
+{
+    const AudCacheStats *s = audc_getStats();
+    static const uint32_t sizes[] = { 2000, 8000, 30000, 100000, 390000 };
+    char     names[64][AUDC_NAMELEN];
+    uint32_t used[64] = { 0 }, tick = 0, r = 1;
+    const AudCacheEntry *inUse = NULL;
+    int      inUseIdx = -1;
+
+    havePSRAM = true;
+    audc_setup();
+    CHECK(s->budget == AUDC_BUDGET_PS && audc_maxSound() == AUDC_MAXSND_PS, "PSRAM budget");
+
+    for(int i = 0; i < 64; i++) {
+        snprintf(names[i], AUDC_NAMELEN, "/snd%02d.mp3", i);
+    }
+
+    for(int i = 0; i < ROUNDS; i++) {
+        int n;
+        r = r * 1103515245 + 12345;
+        n = (r >> 8) % 64;
+
+        if((r >> 20) % 4) {
+            const AudCacheEntry *e = audc_find(names[n]);
+            if(e) {
+                CHECK(used[n] && sndOk(e, names[n]), "%d: %s corrupt", i, names[n]);
+                used[n] = ++tick;
+            } else {
+                CHECK(!used[n], "%d: %s lost", i, names[n]);
+            }
+        } else {
+            uint32_t b = sizes[(r >> 24) % 5], oldest = ~0u, newest = 0;
+            bool gone[64] = { false };
+            if(n != inUseIdx) {
+                audc_insert(names[n], mkSound(names[n], b), b, 22050, 2);
+                used[n] = 0;
+            }
+            if(audc_find(names[n])) used[n] = ++tick;
+            // Whatever was evicted was used before all that stayed
+            for(int j = 0; j < 64; j++) {
+                if(j == n || !used[j]) continue;
+                if(!audc_find(names[j])) {
+                    gone[j] = true;
+                    if(used[j] > newest) newest = used[j];
+                } else {
+                    if(j != inUseIdx && used[j] < oldest) oldest = used[j];
+                    used[j] = ++tick;
+                }
+            }
+            CHECK(newest < oldest, "%d: evicted out of order", i);
+            for(int j = 0; j < 64; j++) {
+                if(gone[j]) used[j] = 0;
+            }
+        }
+        CHECK(s->bytes <= s->budget, "%d: over budget", i);
+
+        // Play something now and then
+        if(!((r >> 12) % 50)) {
+            inUse = audc_find(names[n]);
+            inUseIdx = inUse ? n : -1;
+            if(inUse) used[n] = ++tick;
+            audc_setInUse(0, inUse);
+        }
+        if(inUse) {
+            CHECK(sndOk(inUse, names[inUseIdx]), "%d: sound in use corrupt", i);
+        }
+    }
+
+    audc_setInUse(0, NULL);
+    audc_flush();
+    CHECK(!s->bytes, "flush: %u bytes left", s->bytes);
+}
+
+int main(int, char **argv)
+{
+    char buf[512];
+
+    testBasics();
+    testRandom();
+
+    CHECK(audc_report(buf, sizeof(buf)) > 0 && strstr(buf, "hits"), "report");
+
+    return testResult(argv[0]);
+}
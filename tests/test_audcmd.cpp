@@ -0,0 +1,90 @@
+/*
+ * Audio commands (tc_audcmd.h): Packing, and the single-producer/
+ * single-consumer ring between two threads.
+ */
+
+#include <thread>
+
+#include "test.h"
+#include "tc_audcmd.h"
+
+#define COUNT 2000000
+
+static SPSCRing<AudCmd, 16> ring;
+
+static void testPack()
+{
+    AudCmd  c;
+    int16_t segs[4] = { 3, 5, 0, 7 };
+    int16_t bad[1] = { AC_FNLEN / 2 };
+    char    big[AC_FNLEN + 8];
+
+    CHECK(audcmd_pack_play(c, (const char *)segs, true, 1, 0.5f, -1), "segs");
+    CHECK(c.cmd == AC_PLAY && c.u.segs[0] == 3 && c.u.segs[3] == 7 && c.mute == -1 && c.gain == 0.5f, "segs content");
+
+    CHECK(audcmd_pack_play(c, "/music1/001.mp3", false, 0x12, 1.0f, 0), "file");
+    CHECK(!strcmp(c.u.fn, "/music1/001.mp3") && c.flags == 0x12 && !c.start && !c.size && !c.voice, "file content");
+
+    memset(big, 'a', sizeof(big) - 1);
+    big[sizeof(big) - 1] = 0;
+    CHECK(!audcmd_pack_play(c, big, false, 0, 0, 0), "long name accepted");
+    big[AC_FNLEN] = 0;
+    CHECK(!audcmd_pack_play(c, big, false, 0, 0, 0), "name without room for 0 accepted");
+    big[AC_FNLEN - 1] = 0;
+    CHECK(audcmd_pack_play(c, big, false, 0, 0, 0), "longest name rejected");
+    CHECK(!audcmd_pack_play(c, (const char *)bad, true, 0, 0, 0), "long segment list accepted");
+
+    audcmd_pack(c, AC_KEYPAD, 0.25f, 1, '7');
+    CHECK(c.cmd == AC_KEYPAD && c.gain == 0.25f && c.mute == 1 && c.key == '7' && !c.flags, "pack");
+}
+
+static void fill(AudCmd& c, uint32_t i)
+{
+    char fn[AC_FNLEN];
+
+    snprintf(fn, sizeof(fn), "/music%u/%03u.mp3", i % 10, i % 1000);
+    audcmd_pack_play(c, fn, false, i, (float)(i & 1023), i & 1);
+    c.seq = i;
+    c.start = i * 3;
+    c.size = ~i;
+}
+
+// Every command arrives once, complete and in order
+static void testRing()
+{
+    std::thread prod([] {
+        AudCmd c;
+        for(uint32_t i = 1; i <= COUNT; i++) {
+            fill(c, i);
+            while(!ring.push(c)) std::this_thread::yield();
+        }
+    });
+
+    std::thread cons([] {
+        AudCmd c, e;
+        for(uint32_t i = 1; i <= COUNT; ) {
+            if(!ring.pop(c)) {
+                std::this_thread::yield();
+                continue;
+            }
+            fill(e, i);
+            if(memcmp(&c, &e, sizeof(c))) {
+                CHECK(false, "ring: command %u damaged (seq %u)", i, c.seq);
+                return;
+            }
+            i++;
+        }
+    });
+
+    prod.join();
+    cons.join();
+    CHECK(ring.isEmpty(), "ring not empty");
+}
+
+int main(int, char **argv)
+{
+    testPack();
+    testRing();
+
+    return testResult(argv[0]);
+}
@@ -0,0 +1,166 @@
+/*
+ * Display RAM writes (tcddisplay.cpp) with a fake HT16K33 behind a
+ * fake I2C bus manager: Random updates, sent as diffs against the
+ * shadow, must leave the display RAM as full writes would. Failed
+ * writes (NACKs, partial writes) must be repaired by the next full
+ * write.
+ */
+
+#include "tc_global.h"
+#include <Arduino.h>
+
+#define private public      // directBuf() and directCol()
+#include "tcddisplay.h"
+#undef private
+#include "tc_i2c.h"
+
+#include "test.h"
+
+#define ROUNDS 100000
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+// HT16K33: 16 bytes of display RAM, written with auto-increment
+// after an address byte 0x00-0x0f; everything else is a command
+static struct {
+    uint8_t  ram[16];
+    int      failAfter;     // >= 0: only that many bytes get through
+    uint32_t errors;
+    uint32_t txns, bytes;
+} ht;
+
+// The queue's task runs the write at once; a failure shows in
+// i2c_errors() afterwards
+bool i2c_write(uint8_t, uint8_t, const uint8_t *buf, int len)
+{
+    int n = len;
+
+    if(ht.failAfter >= 0 && ht.failAfter < n) n = ht.failAfter;
+
+    ht.txns++;
+    ht.bytes += len;
+    if(n > 1 && buf[0] < 0x10) {
+        for(int i = 1, a = buf[0]; i < n; i++, a = (a + 1) & 15) {
+            ht.ram[a] = buf[i];
+        }
+    }
+
+    if(n < len) {
+        ht.failAfter = -1;
+        ht.errors++;
+    }
+    return true;
+}
+
+uint32_t i2c_errors(uint8_t)
+{
+    return ht.errors;
+}
+
+static bool ramIs(const uint16_t *want)
+{
+    for(int i = 0; i < CD_BUF_SIZE; i++) {
+        if(ht.ram[i * 2] != (want[i] & 0xff) || ht.ram[i * 2 + 1] != (want[i] >> 8))
+            return false;
+    }
+    return true;
+}
+
+// What a full write of db does in a single transaction
+static void testCost(tcdDisplay& d)
+{
+    uint16_t db[CD_BUF_SIZE];
+    uint32_t txns, bytes;
+
+    for(int i = 0; i < CD_BUF_SIZE; i++) db[i] = rnd();
+    d.directBuf(db);
+
+    txns = ht.txns; bytes = ht.bytes;
+    d.directBuf(db);
+    CHECK(ht.txns == txns, "unchanged frame sent");
+
+    db[3] ^= 0x8000;        // Colon blink
+    d.directBuf(db);
+    CHECK(ht.txns == txns + 1 && ht.bytes == bytes + 3, "colon blink: %u bytes", ht.bytes - bytes);
+    CHECK(ramIs(db), "colon blink: display RAM differs");
+
+    bytes = ht.bytes;
+    db[1] ^= 0x0101; db[4] ^= 0x0001;
+    d.directBuf(db);
+    CHECK(ht.bytes == bytes + 1 + 4 * 2, "two digits: %u bytes", ht.bytes - bytes);
+    CHECK(ramIs(db), "two digits: display RAM differs");
+}
+
+int main(int, char **argv)
+{
+    tcdDisplay d(0, 0x70);
+    uint16_t want[CD_BUF_SIZE] = { }, db[CD_BUF_SIZE];
+    bool synced = true;
+    int faults = 0;
+
+    memset(ht.ram, 0x5a, sizeof(ht.ram));
+    ht.failAfter = -1;
+    d.begin();
+    CHECK(ramIs(want), "begin() did not clear display RAM");
+
+    for(int r = 0; r < ROUNDS; r++) {
+        int len = CD_BUF_SIZE, col;
+        bool fault = !(rnd() % 50);
+
+        memcpy(db, want, sizeof(db));
+        switch(rnd() % 6) {
+        case 0:         // Colon blink
+            db[3] ^= 0x8000;
+            break;
+        case 1:         // One digit
+            db[rnd() % CD_BUF_SIZE] = rnd();
+            break;
+        case 2:         // Everything
+            for(int i = 0; i < CD_BUF_SIZE; i++) db[i] = rnd();
+            break;
+        case 3:         // Nothing
+            break;
+        case 4:         // Partial frame
+            len = 1 + rnd() % (CD_BUF_SIZE - 1);
+            for(int i = 0; i < len; i++) if(rnd() & 1) db[i] = rnd();
+            break;
+        case 5:         // Single column
+            col = rnd() % CD_BUF_SIZE;
+            db[col] = (rnd() & 1) ? rnd() : want[col];
+            if(fault) ht.failAfter = rnd() % 3;
+            d.directCol(col, db[col]);
+            want[col] = db[col];
+            len = 0;
+            break;
+        }
+
+        if(len) {
+            if(fault) ht.failAfter = rnd() % (1 + len * 2);
+            d.directBuf(db, len);
+            memcpy(want, db, len * sizeof(uint16_t));
+        }
+
+        // A fault only counts if the write was actually sent
+        if(fault && ht.failAfter < 0) {
+            synced = false;
+            faults++;
+        }
+        ht.failAfter = -1;
+        if(len == CD_BUF_SIZE && !fault) synced = true;
+
+        if(synced && !ramIs(want)) {
+            CHECK(false, "round %d: display RAM differs", r);
+            break;
+        }
+    }
+    CHECK(faults > 100, "only %d faults", faults);
+
+    testCost(d);
+
+    return testResult(argv[0]);
+}
@@ -0,0 +1,207 @@
+/*
+ * I2C transaction queue (tc_i2cq.h): Pool, scheduling order,
+ * statistics, and per-device bus clock with fallback.
+ */
+
+#include <vector>
+
+#include "test.h"
+#include "tc_i2cq.h"
+
+// Bus that takes 10us per byte plus 20us per transaction
+struct MockBus {
+    uint32_t         now = 0;
+    uint16_t         clk = I2CQ_SLOWCLK;
+    int              clockChanges = 0;
+    int              nakAddr = -1;
+    bool             nakFastOnly = false;
+    std::vector<int> order;
+
+    int xfer(uint8_t addr, const uint8_t *, int wlen, uint8_t *r, int rlen, bool)
+    {
+        order.push_back(addr);
+        now += 10 * (wlen + rlen) + 20;
+        if(addr == nakAddr && (!nakFastOnly || clk > I2CQ_SLOWCLK)) return I2CE_NAK;
+        for(int i = 0; i < rlen; i++) r[i] = addr + i;
+        return rlen;
+    }
+    void setClock(uint16_t khz) { clk = khz; clockChanges++; }
+    uint32_t micros() { return now; }
+};
+
+static I2CQueue q;
+
+static I2CTxn *post(MockBus& bus, int dev, int addr, int wlen, uint8_t *rbuf = NULL, int rlen = 0)
+{
+    I2CTxn *t = i2cq_alloc(&q);
+
+    CHECK(t, "alloc failed");
+    if(!t) return NULL;
+    t->dev = dev;
+    t->addr = addr;
+    t->wlen = wlen;
+    t->wbuf = t->data;
+    t->rlen = rlen;
+    t->rbuf = rbuf;
+    i2cq_push(&q, t, bus.now);
+
+    return t;
+}
+
+static void runAll(MockBus& bus)
+{
+    I2CTxn *t;
+
+    while((t = i2cq_pop(&q, bus.now))) {
+        i2cq_exec(&q, t, bus);
+        CHECK(t->flags & I2CT_DONE, "not done");
+        i2cq_free(&q, t);
+    }
+}
+
+static void testPool()
+{
+    I2CTxn *all[I2CQ_SIZE];
+
+    i2cq_init(&q);
+    for(int i = 0; i < I2CQ_SIZE; i++) {
+        all[i] = i2cq_alloc(&q);
+        CHECK(all[i], "pool: alloc %d failed", i);
+    }
+    CHECK(!i2cq_alloc(&q), "pool: alloc beyond I2CQ_SIZE");
+    for(int i = 0; i < I2CQ_SIZE; i++) {
+        if(all[i]) i2cq_free(&q, all[i]);
+    }
+    CHECK(i2cq_alloc(&q), "pool: alloc after free failed");
+}
+
+// Priority first, then order of posting; statistics
+static void testOrder()
+{
+    MockBus bus;
+    uint8_t rb[8] = { 0 };
+    int     devs[]  = { 8, 0, 1, 4, 8, 0 };
+    int     addrs[] = { 0x10, 0x70, 0x71, 0x20, 0x11, 0x72 };
+    int     exp[]   = { 0x20, 0x70, 0x71, 0x72, 0x10, 0x11 };
+
+    i2cq_init(&q);
+    i2cq_setPrio(&q, 0, 1);
+    i2cq_setPrio(&q, 1, 1);
+    i2cq_setPrio(&q, 4, 0);
+    i2cq_setPrio(&q, 8, 3);
+    i2cq_setPrio(&q, 9, 99);
+    CHECK(q.prio[9] == I2CQ_PRIOS - 1, "prio not clamped");
+
+    for(int i = 0; i < 6; i++) {
+        post(bus, devs[i], addrs[i], 3, devs[i] == 4 ? rb : NULL, devs[i] == 4 ? 1 : 0);
+    }
+    CHECK(q.pending == 6, "pending %d", q.pending);
+
+    bus.nakAddr = 0x71;
+    runAll(bus);
+    CHECK(q.pending == 0, "pending %d after run", q.pending);
+    for(int i = 0; i < 6; i++) {
+        CHECK(bus.order[i] == exp[i], "order: #%d is 0x%x", i, bus.order[i]);
+    }
+    CHECK(rb[0] == 0x20, "read data");
+    CHECK(q.stats[4].txns == 1 && q.stats[4].bytes == 4 && q.stats[4].us == 60, "keypad stats");
+    CHECK(q.stats[0].txns == 2 && q.stats[0].bytes == 6 && q.stats[0].naks == 0, "display stats");
+    CHECK(q.stats[1].naks == 1 && q.stats[1].bytes == 3, "nak stats");
+    CHECK(q.stats[8].txns == 2 && q.stats[8].maxWait == 60+50*3+50, "wait stats");
+}
+
+// Interleaved push/pop keeps order within a priority, and the
+// pool intact
+static void testInterleaved()
+{
+    MockBus bus;
+    I2CTxn  *t;
+
+    i2cq_init(&q);
+    i2cq_setPrio(&q, 0, 1);
+    i2cq_setPrio(&q, 8, 3);
+
+    for(int round = 0; round < 1000; round++) {
+        int n = 1 + round % I2CQ_SIZE;
+        int lastA = -1, lastB = -1;
+        bool seenLow = false;
+        for(int i = 0; i < n; i++) {
+            post(bus, (i & 1) ? 8 : 0, i, 1);
+        }
+        while((t = i2cq_pop(&q, 0))) {
+            if(t->dev == 0) {
+                CHECK(!seenLow && t->addr > lastA, "round %d: display out of order", round);
+                lastA = t->addr;
+            } else {
+                seenLow = true;
+                CHECK(t->addr > lastB, "round %d: GPS out of order", round);
+                lastB = t->addr;
+            }
+            i2cq_exec(&q, t, bus);
+            i2cq_free(&q, t);
+        }
+    }
+    for(int i = 0; i < I2CQ_SIZE; i++) {
+        CHECK(i2cq_alloc(&q), "pool lost entries");
+    }
+    CHECK(!i2cq_alloc(&q), "pool grew");
+}
+
+// Bus clock is switched per device; a device failing I2CQ_FASTERR
+// times in a row at a fast clock goes back to I2CQ_SLOWCLK
+static void testClock()
+{
+    MockBus bus;
+
+    i2cq_init(&q);
+    i2cq_setClock(&q, 0, 400);
+    post(bus, 0, 0x71, 1);
+    post(bus, 4, 0x20, 1);
+    post(bus, 0, 0x71, 1);
+    runAll(bus);
+    CHECK(bus.clockChanges == 3 && bus.clk == 400, "clock changes %d", bus.clockChanges);
+
+    bus.nakAddr = 0x74;
+    bus.nakFastOnly = true;
+    i2cq_setClock(&q, 2, 400);
+    for(int i = 0; i < I2CQ_FASTERR - 1; i++) {
+        post(bus, 2, 0x74, 1);
+        runAll(bus);
+    }
+    bus.nakAddr = -1;
+    post(bus, 2, 0x74, 1);
+    runAll(bus);
+    CHECK(q.fastErr[2] == 0, "success did not reset error count");
+
+    bus.nakAddr = 0x74;
+    for(int i = 0; i < I2CQ_FASTERR; i++) {
+        CHECK(i2cq_getClock(&q, 2) == 400, "fell back after %d errors", i);
+        post(bus, 2, 0x74, 1);
+        runAll(bus);
+    }
+    CHECK(i2cq_getClock(&q, 2) == I2CQ_SLOWCLK, "no fallback");
+    I2CTxn *t = post(bus, 2, 0x74, 1);
+    t = i2cq_pop(&q, bus.now);
+    i2cq_exec(&q, t, bus);
+    CHECK(t->result >= 0 && bus.clk == I2CQ_SLOWCLK, "fails after fallback");
+    i2cq_free(&q, t);
+
+    // Failures at the slow clock never count
+    i2cq_init(&q);
+    bus.nakFastOnly = false;
+    for(int i = 0; i < 10; i++) {
+        post(bus, 2, 0x74, 1);
+        runAll(bus);
+    }
+    CHECK(q.fastErr[2] == 0, "slow failures counted");
+}
+
+int main(int, char **argv)
+{
+    testPool();
+    testOrder();
+    testInterleaved();
+    testClock();
+
+    return testResult(argv[0]);
+}
@@ -0,0 +1,246 @@
+/*
+ * ID3v2 parser (tc_id3.h): Known tags of all three revisions and
+ * text encodings, frames behind large pictures, and mutated tags
+ * (must never overrun the buffers or read beyond the tag).
+ */
+
+#include <string.h>
+#include <vector>
+
+#include "test.h"
+#include "tc_id3.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Source reading from memory; counts what is actually read
+struct MemSrc {
+    const Bytes *b;
+    uint32_t    pos;
+    uint32_t    bytesRead;
+    uint32_t    maxRead;
+
+    uint32_t read(void *d, uint32_t l)
+    {
+        if(l > maxRead) maxRead = l;
+        if(pos >= b->size()) return 0;
+        uint32_t n = b->size() - pos;
+        if(n > l) n = l;
+        memcpy(d, b->data() + pos, n);
+        pos += n;
+        bytesRead += n;
+        return n;
+    }
+    bool skip(uint32_t l)
+    {
+        if((uint64_t)pos + l > b->size()) {
+            pos = b->size();
+            return false;
+        }
+        pos += l;
+        return true;
+    }
+};
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+static void putNum(uint8_t *p, uint32_t v, int n, int bits)
+{
+    for(int i = n - 1; i >= 0; i--) {
+        p[i] = v & ((1 << bits) - 1);
+        v >>= bits;
+    }
+}
+
+static void addFrame(Bytes& t, int rev, const char *id, const Bytes& data, uint8_t flags = 0)
+{
+    uint8_t h[10] = { 0 };
+
+    if(rev == 2) {
+        memcpy(h, id, 3);
+        putNum(h + 3, data.size(), 3, 8);
+        t.insert(t.end(), h, h + 6);
+    } else {
+        memcpy(h, id, 4);
+        putNum(h + 4, data.size(), 4, (rev == 3) ? 8 : 7);
+        h[9] = flags;
+        t.insert(t.end(), h, h + 10);
+    }
+    t.insert(t.end(), data.begin(), data.end());
+}
+
+static Bytes text(uint8_t enc, const char *s, int len = -1)
+{
+    Bytes d(1, enc);
+
+    d.insert(d.end(), s, s + ((len < 0) ? strlen(s) : len));
+
+    return d;
+}
+
+// Tag with header, frames, padding; followed by some "audio"
+static Bytes makeTag(int rev, const Bytes& frames, int padding = 16, uint8_t hflags = 0)
+{
+    Bytes t = { 'I', 'D', '3', (uint8_t)rev, 0, hflags, 0, 0, 0, 0 };
+
+    putNum(&t[6], frames.size() + padding, 4, 7);
+    t.insert(t.end(), frames.begin(), frames.end());
+    t.resize(t.size() + padding, 0);
+    t.resize(t.size() + 64, 0xff);
+
+    return t;
+}
+
+static void parse(const Bytes& t, int32_t expSize, const char *expArtist, const char *expTrack, const char *what)
+{
+    MemSrc s = { &t, 0, 0, 0 };
+    char   artist[ID3_MAXCHRS + 1], track[ID3_MAXCHRS + 1];
+
+    int32_t size = id3_parse(s, artist, track);
+    CHECK(size == expSize, "%s: size %d, expected %d", what, size, expSize);
+    CHECK(!strcmp(artist, expArtist), "%s: artist '%s', expected '%s'", what, artist, expArtist);
+    CHECK(!strcmp(track, expTrack), "%s: track '%s', expected '%s'", what, track, expTrack);
+}
+
+static void testKnown()
+{
+    Bytes f, t;
+
+    t = Bytes(100, 0xff);
+    parse(t, 0, "", "", "no tag");
+
+    // v2.3, ISO-8859-1 and UTF-8 (non-ASCII dropped, lower case folded, ~ shown as -)
+    f.clear();
+    addFrame(f, 3, "TALB", text(0, "Album"));
+    addFrame(f, 3, "TIT2", text(0, "Hello ~ \xe4 you"));
+    addFrame(f, 3, "TPE1", text(3, "W\xc3\xb6rld\xe2\x82\xac!"));
+    t = makeTag(3, f);
+    parse(t, t.size() - 64, "WRLD!", "HELLO -  YOU", "v2.3");
+
+    // v2.2
+    f.clear();
+    addFrame(f, 2, "TP1", text(0, "Huey Lewis"));
+    addFrame(f, 2, "TT2", text(0, "Back in Time"));
+    t = makeTag(2, f);
+    parse(t, t.size() - 64, "HUEY LEWIS", "BACK IN TIME", "v2.2");
+
+    // v2.4: syncsafe frame sizes, data length indicator
+    f.clear();
+    Bytes big(200, 'x');
+    addFrame(f, 4, "PRIV", big);
+    Bytes dli = text(3, "Time Circuits");
+    dli.insert(dli.begin(), { 0, 0, 0, 14 });
+    addFrame(f, 4, "TIT2", dli, 0x01);
+    addFrame(f, 4, "TPE1", text(0, "Doc"));
+    t = makeTag(4, f);
+    parse(t, t.size() - 64, "DOC", "TIME CIRCUITS", "v2.4");
+
+    // UTF-16 with either BOM, and without (BE); surrogate pairs dropped
+    f.clear();
+    addFrame(f, 3, "TIT2", text(1, "\xff\xfe" "a\0b\0\x3d\xd8\x00\xde" "c\0", 12));
+    addFrame(f, 3, "TPE1", text(2, "\0x\0y", 4));
+    t = makeTag(3, f);
+    parse(t, t.size() - 64, "XY", "ABC", "UTF-16");
+    f.clear();
+    addFrame(f, 3, "TIT2", text(1, "\xfe\xff\0q", 4));
+    t = makeTag(3, f);
+    parse(t, t.size() - 64, "", "Q", "UTF-16 BE BOM");
+
+    // Truncated to ID3_MAXCHRS, terminated by 0
+    f.clear();
+    addFrame(f, 3, "TIT2", text(0, "abcdefghijklmnopqrstuvwxyz"));
+    addFrame(f, 3, "TPE1", text(0, "ab\0cd", 5));
+    t = makeTag(3, f);
+    parse(t, t.size() - 64, "AB", "ABCDEFGHIJKLMNO", "truncate");
+
+    // Extended header (v2.3) is skipped; compressed frame ignored
+    f.clear();
+    f.insert(f.end(), { 0, 0, 0, 6, 0, 0, 0, 0, 0, 0 });
+    addFrame(f, 3, "TIT2", text(0, "packed"), 0x80);
+    addFrame(f, 3, "TPE1", text(0, "Ext"));
+    t = makeTag(3, f, 16, 0x40);
+    parse(t, t.size() - 64, "EXT", "", "ext header");
+
+    // Unknown revision, unsync flag: No usable tag
+    t[3] = 5;
+    parse(t, 0, "", "", "v2.5");
+    t[3] = 3;
+    t[5] = 0x80;
+    parse(t, 0, "", "", "unsync");
+}
+
+// Text frames behind a large picture are found without reading it
+static void testBigPicture()
+{
+    Bytes f, t;
+    Bytes pic(300000, 0x55);
+    char  artist[ID3_MAXCHRS + 1], track[ID3_MAXCHRS + 1];
+
+    addFrame(f, 3, "APIC", pic);
+    addFrame(f, 3, "TIT2", text(0, "Hello"));
+    addFrame(f, 3, "TPE1", text(0, "World"));
+    t = makeTag(3, f);
+
+    MemSrc s = { &t, 0, 0, 0 };
+    id3_parse(s, artist, track);
+    CHECK(!strcmp(artist, "WORLD") && !strcmp(track, "HELLO"), "after APIC: '%s' / '%s'", artist, track);
+    CHECK(s.bytesRead < 100, "after APIC: read %u bytes", s.bytesRead);
+}
+
+static Bytes randomTag()
+{
+    static const char *ids3[] = { "TIT2", "TPE1", "TALB", "APIC", "COMM" };
+    static const char *ids2[] = { "TT2", "TP1", "TAL", "PIC", "COM" };
+    int   rev = 2 + rnd() % 3;
+    Bytes f;
+
+    for(int n = rnd() % 6; n >= 0; n--) {
+        Bytes d(rnd() % 120);
+        for(auto &x : d) x = rnd();
+        if(d.size()) d[0] = rnd() % 5;
+        addFrame(f, rev, rev == 2 ? ids2[rnd() % 5] : ids3[rnd() % 5], d, (rnd() % 4) ? 0 : rnd());
+    }
+
+    return makeTag(rev, f, rnd() % 64, (rnd() % 4) ? 0 : (rnd() & 0x70));
+}
+
+static void testFuzz()
+{
+    for(int i = 0; i < 300000; i++) {
+        Bytes t = randomTag();
+        char   artist[ID3_MAXCHRS + 8], track[ID3_MAXCHRS + 8];
+
+        for(int m = 1 + rnd() % 8; m > 0; m--) {
+            uint32_t p = rnd() % t.size();
+            switch(rnd() % 4) {
+            case 0: t[p] = rnd(); break;
+            case 1: t[p] ^= 1 << (rnd() % 8); break;
+            case 2: t.resize(p + 1); break;
+            case 3: t[p] = (rnd() & 1) ? 0xff : 0x7f; break;
+            }
+        }
+
+        memset(artist, '#', sizeof(artist));
+        memset(track, '#', sizeof(track));
+        MemSrc s = { &t, 0, 0, 0 };
+        int32_t size = id3_parse(s, artist, track);
+
+        CHECK(memchr(artist, 0, ID3_MAXCHRS + 1) && memchr(track, 0, ID3_MAXCHRS + 1), "fuzz %d: not terminated", i);
+        CHECK(artist[ID3_MAXCHRS + 1] == '#' && track[ID3_MAXCHRS + 1] == '#', "fuzz %d: overrun", i);
+        CHECK(s.maxRead <= ID3_TXTMAX, "fuzz %d: read %u at once", i, s.maxRead);
+        CHECK(s.pos <= (uint32_t)size || (!size && s.pos <= 10), "fuzz %d: read beyond tag", i);
+    }
+}
+
+int main(int, char **argv)
+{
+    testKnown();
+    testBigPicture();
+    testFuzz();
+
+    return testResult(argv[0]);
+}
@@ -0,0 +1,197 @@
+/*
+ * Keypad scanning (input.cpp) against a fake PCF8574 with INT, in
+ * model time: Polling every 20ms vs. scanning after INT. Checks the
+ * I2C traffic while idle, the time from press to event, and that
+ * every press gives exactly one press and one release event, also
+ * when a key goes down during the scan that arms INT.
+ */
+
+#include "tc_global.h"
+#include <Arduino.h>
+
+#include "input.h"
+#include "tc_i2c.h"
+
+#include "test.h"
+
+#define INT_PIN 4
+#define PRESSES 200
+
+static const char keys[4*3] = {
+     '1', '2', '3',
+     '4', '5', '6',
+     '7', '8', '9',
+     '*', '0', '#'
+};
+static const uint8_t rowPins[4] = {1, 6, 5, 3};
+static const uint8_t colPins[3] = {2, 0, 4};
+
+static uint32_t now;    // us
+
+uint32_t micros()        { return now; }
+unsigned long millis()   { return now / 1000; }
+void delay(unsigned long ms)    { now += ms * 1000; }
+void pinMode(uint8_t, uint8_t) { }
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+// PCF8574: Quasi-bidirectional pins, low where written 0 or where
+// a pressed key connects a row to a column written 0. INT goes low
+// when the pins differ from what they were at the last access.
+static struct {
+    uint8_t  out;
+    uint8_t  atAccess;
+    int      row, col;
+    uint32_t downAt, upAt;      // us; key is down in between
+    uint32_t xfers;
+} pcf;
+
+static uint8_t pins()
+{
+    uint8_t p = pcf.out;
+    bool down = (int32_t)(now - pcf.downAt) >= 0 && (int32_t)(now - pcf.upAt) < 0;
+
+    if(down && !(pcf.out & (1 << colPins[pcf.col]))) {
+        p &= ~(1 << rowPins[pcf.row]);
+    }
+    return p;
+}
+
+int digitalRead(uint8_t)
+{
+    return (pins() == pcf.atAccess) ? HIGH : LOW;
+}
+
+// The bus manager, running each transaction at once; 100us each
+bool i2c_write(uint8_t, uint8_t, const uint8_t *buf, int)
+{
+    pcf.out = buf[0];
+    pcf.atAccess = pins();
+    pcf.xfers++;
+    now += 100;
+    return true;
+}
+
+int i2c_xfer(uint8_t, uint8_t, const uint8_t *, int, uint8_t *rbuf, int rlen, bool)
+{
+    rbuf[0] = pcf.atAccess = pins();
+    pcf.xfers++;
+    now += 100;
+    return rlen;
+}
+
+static void kpDelay(int, unsigned long ms)
+{
+    now += ms * 1000;
+}
+
+static struct {
+    char     key;
+    int      presses, releases;
+    uint32_t pressAt;       // us of the last press event
+    uint32_t releaseAt;     // us of the last release event
+} ev;
+
+static void keyEvent(char key, KeyState state)
+{
+    if(state == TCKS_PRESSED) {
+        ev.presses++;
+        ev.key = key;
+        ev.pressAt = now;
+    } else if(state == TCKS_RELEASED) {
+        ev.releases++;
+        ev.releaseAt = now;
+    }
+}
+
+// loop() calls scanKeypad() about every millisecond
+static void runFor(Keypad_I2C& kp, uint32_t us)
+{
+    uint32_t end = now + us;
+
+    while((int32_t)(now - end) < 0) {
+        kp.scanKeypad();
+        now += 1000;
+    }
+}
+
+static void testMode(int intPin)
+{
+    const char *mode = (intPin >= 0) ? "INT" : "polling";
+    Keypad_I2C kp((char *)keys, rowPins, colPins, 4, 3, 0x20);
+    uint32_t xfers, latMax = 0, latSum = 0, latNum = 0;
+
+    now = 1000000;
+    pcf = { };
+    pcf.out = pcf.atAccess = 0xff;
+    pcf.downAt = pcf.upAt = now;
+    ev = { };
+
+    kp.begin(20, 100000, kpDelay, intPin);
+    kp.addEventListener(keyEvent);
+
+    runFor(kp, 100000);
+    xfers = pcf.xfers;
+    runFor(kp, 1000000);
+    xfers = pcf.xfers - xfers;
+    if(intPin >= 0) {
+        CHECK(xfers == 0, "%s: %u I2C transactions in an idle second", mode, xfers);
+    } else {
+        CHECK(xfers > 500, "%s: only %u I2C transactions in an idle second", mode, xfers);
+    }
+
+    for(int i = 0; i < PRESSES; i++) {
+        int k = rnd() % 12, presses = ev.presses;
+        bool fromIdle = !i || (i & 1);
+
+        // Wait for the last release
+        for(int w = 0; w < 100 && ev.releases < presses; w++) {
+            runFor(kp, 1000);
+        }
+        CHECK(ev.releases == presses, "%s: %d release events before press %d", mode, ev.releases, i);
+
+        // Either from idle, or during the scan after the release
+        // event, which arms INT at its end
+        pcf.row = k / 3;
+        pcf.col = k % 3;
+        if(fromIdle) {
+            pcf.downAt = now + 50000 + rnd() % 200000;
+        } else {
+            pcf.downAt = ev.releaseAt + 20000 + rnd() % 14000;
+        }
+        pcf.upAt = pcf.downAt + 30000 + rnd() % 300000;
+        runFor(kp, pcf.upAt - now);
+
+        CHECK(ev.presses == presses + 1, "%s: %d press events for one press", mode, ev.presses - presses);
+        CHECK(ev.key == keys[k], "%s: key '%c' reported as '%c'", mode, keys[k], ev.key);
+        if(ev.presses == presses + 1 && fromIdle) {
+            uint32_t t = ev.pressAt - pcf.downAt;
+            latSum += t;
+            latNum++;
+            if(t > latMax) latMax = t;
+        }
+    }
+    runFor(kp, 100000);
+    CHECK(ev.presses == PRESSES && ev.releases == PRESSES, "%s: %d presses, %d releases", mode, ev.presses, ev.releases);
+
+    // From idle, INT starts the scan at once: two debounce delays,
+    // without waiting for the 20ms scan interval
+    if(intPin >= 0) {
+        CHECK(latMax < 15000, "%s: press to event up to %uus", mode, latMax);
+    } else {
+        CHECK(latSum / latNum > 20000, "%s: press to event %uus on average", mode, latSum / latNum);
+    }
+}
+
+int main(int, char **argv)
+{
+    testMode(-1);
+    testMode(INT_PIN);
+
+    return testResult(argv[0]);
+}
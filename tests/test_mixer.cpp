@@ -0,0 +1,270 @@
+/*
+ * AudioOutputMixer: A 44.1kHz music voice with a 32kHz effect on top.
+ * Checks the output length, the resampled effect's duration, the ducked
+ * level and the duck ramps. Also a series of sounds through a fake I2S
+ * output, stopped or persistent.
+ */
+
+#include <stdlib.h>
+#include <vector>
+
+#include "test.h"
+#include "AudioOutputMixer.h"
+
+#define MUSIC_FRAMES  44100     // 1s at 44.1kHz
+#define EFF_FRAMES    8000      // 0.25s at 32kHz
+#define EFF_START     11025     // output frame at which the effect starts
+#define DUCK          0.3f
+
+// Takes what the mixer delivers, up to 48 frames per call
+class Capture : public AudioOutput
+{
+  public:
+    bool SetRate(int hz) override { hertz = hz; return true; }
+    bool begin() override { on = true; begins++; return true; }
+    bool stop() override { on = false; return true; }
+    size_t ConsumeSample(int16_t sL, int16_t sR) override
+    {
+        L.push_back(sL);
+        R.push_back(sR);
+        return 4;
+    }
+    uint16_t ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count) override
+    {
+        if(count > 48) count = 48;
+        for(int i = 0; i < count; i++, sL += stride, sR += stride) {
+            L.push_back(*sL);
+            R.push_back(*sR);
+        }
+        return count;
+    }
+    int rate() { return hertz; }
+
+    std::vector<int16_t> L, R;
+    bool on = false;
+    int  begins = 0;
+};
+
+// Music: stereo, constant; effect: mono, constant
+static void run(Capture& cap, int16_t musL, int16_t musR, int16_t eff)
+{
+    AudioOutputMixer mix(&cap);
+    AudioOutputMixerVoice *m = mix.getVoice(0), *e = mix.getVoice(1);
+    int mFed = 0, eFed = 0;
+    bool eOn = false;
+
+    mix.SetDuck(DUCK);
+
+    m->SetRate(44100);
+    m->SetChannels(2);
+    m->begin();
+
+    while(mFed < MUSIC_FRAMES || eFed < EFF_FRAMES || mix.isBusy()) {
+        // Feed like the generators: a few frames as they fit
+        for(int i = 0; i < 32 && mFed < MUSIC_FRAMES; i++) {
+            if(!m->ConsumeSample(musL, musR)) break;
+            if(++mFed == MUSIC_FRAMES) m->stop();
+        }
+        if(!eOn && cap.L.size() >= EFF_START) {
+            e->SetRate(32000);
+            e->SetChannels(1);
+            e->begin();
+            eOn = true;
+        }
+        if(eOn && eFed < EFF_FRAMES) {
+            int16_t blk[20];
+            for(int i = 0; i < 20; i++) blk[i] = eff;
+            int n = EFF_FRAMES - eFed;
+            if(n > 20) n = 20;
+            eFed += e->ConsumeSamples(blk, blk, 1, n);
+            if(eFed == EFF_FRAMES) e->stop();
+        }
+        mix.loop();
+    }
+
+    CHECK(!cap.on && cap.begins == 1, "output on %d, begins %d", cap.on, cap.begins);
+    CHECK(cap.rate() == 44100, "output rate %d", cap.rate());
+}
+
+static void testEffectOnly()
+{
+    Capture cap;
+    int first = -1, last = -1;
+
+    run(cap, 0, 0, 8000);
+
+    CHECK(cap.L.size() == MUSIC_FRAMES, "output length %d", (int)cap.L.size());
+
+    for(int i = 0; i < (int)cap.L.size(); i++) {
+        if(cap.L[i]) {
+            if(first < 0) first = i;
+            last = i;
+            CHECK(cap.L[i] == 8000 && cap.R[i] == 8000, "effect level %d/%d at %d", cap.L[i], cap.R[i], i);
+        }
+    }
+    // 8000 frames at 32kHz = 11025 at 44.1kHz
+    CHECK(first >= EFF_START && first < EFF_START + 64, "effect starts at %d", first);
+    CHECK(abs(last - first + 1 - EFF_FRAMES * 44100 / 32000) <= 2, "effect length %d", last - first + 1);
+}
+
+static void testDuck()
+{
+    Capture cap;
+    int32_t duck = (int32_t)(DUCK * MIX_GAIN_ONE);
+    int16_t dL = (10000 * duck) >> 12, dR = (-6000 * duck) >> 12;
+    int maxJump = 0, lowFirst = -1, lowLast = -1;
+
+    run(cap, 10000, -6000, 0);
+
+    CHECK(cap.L.size() == MUSIC_FRAMES, "output length %d", (int)cap.L.size());
+    CHECK(cap.L[0] == 10000 && cap.R[0] == -6000, "music level %d/%d", cap.L[0], cap.R[0]);
+    CHECK(cap.L[MUSIC_FRAMES - 1] == 10000, "music not restored: %d", cap.L[MUSIC_FRAMES - 1]);
+
+    for(int i = 1; i < (int)cap.L.size(); i++) {
+        int j = abs(cap.L[i] - cap.L[i - 1]);
+        if(j > maxJump) maxJump = j;
+        if(cap.L[i] == dL) {
+            CHECK(cap.R[i] == dR, "ducked R %d at %d", cap.R[i], i);
+            if(lowFirst < 0) lowFirst = i;
+            lowLast = i;
+        }
+    }
+
+    // Ramps in 16 steps, no step larger than 1/16 of the level
+    CHECK(maxJump <= 10000 / 16 + 1, "jump of %d", maxJump);
+    CHECK(lowFirst > EFF_START && lowFirst <= EFF_START + 17 * MIX_BLOCK, "ducked at %d", lowFirst);
+    CHECK(lowLast >= EFF_START + 11025 - MIX_BLOCK, "restored at %d", lowLast);
+}
+
+static void testMixed()
+{
+    Capture cap;
+    int32_t duck = (int32_t)(DUCK * MIX_GAIN_ONE);
+    int mid = EFF_START + 11025 / 2;
+
+    run(cap, 10000, -6000, 8000);
+
+    CHECK(cap.L.size() == MUSIC_FRAMES, "output length %d", (int)cap.L.size());
+    CHECK(cap.L[mid] == ((10000 * duck) >> 12) + 8000 && cap.R[mid] == ((-6000 * duck) >> 12) + 8000,
+          "mixed level %d/%d", cap.L[mid], cap.R[mid]);
+}
+
+// I2S as the mixer sees it: A DMA ring of 2048 frames that the
+// hardware plays in a loop, repeating whatever is in it
+#define DMA_FRAMES 2048
+
+class FakeI2S : public AudioOutput
+{
+  public:
+    bool SetRate(int hz) override
+    {
+        if(on && hz != hertz) rateChanges++;
+        hertz = hz;
+        return true;
+    }
+    bool begin() override
+    {
+        if(!on) installs++;
+        on = true;
+        return true;
+    }
+    bool stop() override
+    {
+        if(on) uninstalls++;
+        on = false;
+        silence();
+        return true;
+    }
+    void silence() override
+    {
+        memset(dma, 0, sizeof(dma));
+        queued = 0;
+    }
+    size_t ConsumeSample(int16_t sL, int16_t sR) override
+    {
+        return ConsumeSamples(&sL, &sR, 1, 1) ? 4 : 0;
+    }
+    uint16_t ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count) override
+    {
+        if(count > DMA_FRAMES - queued) count = DMA_FRAMES - queued;
+        for(int i = 0; i < count; i++, sL += stride, sR += stride) {
+            dma[wr][0] = *sL;
+            dma[wr][1] = *sR;
+            wr = (wr + 1) % DMA_FRAMES;
+        }
+        queued += count;
+        return count;
+    }
+    void play(int frames) { queued = (queued > frames) ? queued - frames : 0; }
+    bool allZero()
+    {
+        for(int i = 0; i < DMA_FRAMES; i++) {
+            if(dma[i][0] || dma[i][1]) return false;
+        }
+        return true;
+    }
+
+    int16_t dma[DMA_FRAMES][2] = { };
+    int  wr = 0, queued = 0;
+    bool on = false;
+    int  installs = 0, uninstalls = 0, rateChanges = 0;
+};
+
+// Effects at various rates, the last one stopped halfway
+static void testSeries(bool persistent)
+{
+    static const int rates[] = { 32000, 44100, 32000, 48000, 44100, 32000 };
+    const char *mode = persistent ? "persistent" : "stopped";
+    FakeI2S i2s;
+    AudioOutputMixer mix(&i2s);
+    AudioOutputMixerVoice *e = mix.getVoice(1);
+
+    if(persistent) mix.SetPersistent(DMA_FRAMES);
+
+    for(int s = 0; s < 6; s++) {
+        int16_t blk[20];
+        int fed = 0, len = rates[s] / 4;
+        bool cut = (s == 5);
+
+        for(int i = 0; i < 20; i++) blk[i] = 5000 + s;
+        e->SetRate(rates[s]);
+        e->SetChannels(1);
+        e->begin();
+        while(fed < len) {
+            fed += e->ConsumeSamples(blk, blk, 1, (len - fed > 20) ? 20 : len - fed);
+            mix.loop();
+            i2s.play(16);
+            if(cut && fed >= len / 2) {
+                CHECK(!i2s.allZero(), "%s: sound %d not in the DMA ring", mode, s);
+                e->flush();
+                CHECK(i2s.allZero(), "%s: DMA ring not silent after the stop", mode);
+                break;
+            }
+        }
+        if(!cut) e->stop();
+        while(mix.isBusy()) {
+            mix.loop();
+            i2s.play(64);
+        }
+        mix.loop();     // The audio task keeps calling it
+        CHECK(i2s.allZero(), "%s: DMA ring not silent after sound %d", mode, s);
+    }
+
+    if(persistent) {
+        CHECK(i2s.installs == 1 && !i2s.uninstalls, "%s: %d installs, %d uninstalls", mode, i2s.installs, i2s.uninstalls);
+        CHECK(i2s.rateChanges == 1, "%s: %d rate changes", mode, i2s.rateChanges);
+    } else {
+        CHECK(i2s.installs == 6 && i2s.uninstalls == 6, "%s: %d installs, %d uninstalls", mode, i2s.installs, i2s.uninstalls);
+    }
+}
+
+int main(int, char **argv)
+{
+    testEffectOnly();
+    testDuck();
+    testMixed();
+    testSeries(false);
+    testSeries(true);
+
+    return testResult(argv[0]);
+}
@@ -0,0 +1,99 @@
+/*
+ * Renamer sort (tc_mpsort.h): Both the merge sort and the insertion
+ * sort fallback must give the same order as a stable sort with a
+ * plain case-insensitive comparison.
+ */
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "test.h"
+#include "tc_mpsort.h"
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+// Reference: a-z folded to A-Z, then unsigned byte order
+static int refCmp(const char *a, const char *b)
+{
+    for(;;) {
+        unsigned char x = (unsigned char)*a++, y = (unsigned char)*b++;
+        if(x >= 'a' && x <= 'z') x -= 0x20;
+        if(y >= 'a' && y <= 'z') y -= 0x20;
+        if(x != y) return (x < y) ? -1 : 1;
+        if(!x) return 0;
+    }
+}
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+static std::string randName()
+{
+    static const char *pre[] = { "The Beatles", "the beatles", "ZZ Top", "abba", "ABBA", "a", "Ab", "" };
+    static const char chars[] = "aAbBzZ_ -.019~\xc3\xa4\xe9";
+    std::string s = pre[rnd() % 8];
+    int n = rnd() % 12;
+
+    for(int i = 0; i < n; i++) {
+        s += chars[rnd() % (sizeof(chars) - 1)];
+    }
+    if(rnd() & 1) s += ".mp3";
+
+    return s;
+}
+
+static void testSort(int n)
+{
+    std::vector<std::string> names;
+    std::vector<MpSortEnt>   a(n + 1), b(n + 1), tmp(n + 1);
+    std::vector<int>         idx;
+
+    for(int i = 0; i < n; i++) {
+        names.push_back(randName());
+    }
+    for(int i = 0; i < n; i++) {
+        mpsort_setEnt(&a[i], &names[i][0]);
+        mpsort_setEnt(&b[i], &names[i][0]);
+        idx.push_back(i);
+    }
+
+    std::stable_sort(idx.begin(), idx.end(), [&](int x, int y) {
+        return refCmp(names[x].c_str(), names[y].c_str()) < 0;
+    });
+
+    mpsort_sort(a.data(), tmp.data(), n);
+    mpsort_sort(b.data(), NULL, n);
+
+    for(int i = 0; i < n; i++) {
+        CHECK(a[i].name == &names[idx[i]][0], "merge, n=%d: #%d is '%s', expected '%s'", n, i, a[i].name, names[idx[i]].c_str());
+        CHECK(b[i].name == &names[idx[i]][0], "insertion, n=%d: #%d is '%s', expected '%s'", n, i, b[i].name, names[idx[i]].c_str());
+    }
+}
+
+int main(int, char **argv)
+{
+    // Comparison, including names shorter than the key
+    for(int i = 0; i < 200000; i++) {
+        std::string x = randName(), y = randName();
+        MpSortEnt a, b;
+        mpsort_setEnt(&a, &x[0]);
+        mpsort_setEnt(&b, &y[0]);
+        CHECK(sign(mpsort_cmp(&a, &b)) == refCmp(x.c_str(), y.c_str()), "cmp '%s' '%s'", x.c_str(), y.c_str());
+    }
+
+    for(int n = 0; n <= 70; n++) {
+        testSort(n);
+    }
+    testSort(1000);
+    testSort(4099);
+
+    return testResult(argv[0]);
+}
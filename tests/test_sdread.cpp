@@ -0,0 +1,238 @@
+/*
+ * SD read-ahead (AudioFileSourceLoop): Two sources read random files
+ * through the "sdread" task, with random read sizes, seeks, loop
+ * points and loop cut-offs, and are compared against a model of what
+ * the file delivers. The file is slowed down so the decoder side
+ * runs dry now and then. Built with TSan.
+ *
+ * Also segment playback from a TCC.bin and its cached TOC.
+ */
+
+#include "test.h"
+#include "AudioFileSourceLoop.h"
+
+#define FILES 300
+
+HostFS SD, LittleFS;
+
+static bool havePSRAM;
+
+bool psramFound()
+{
+    return havePSRAM;
+}
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+// What the source should deliver
+struct Model {
+    const std::vector<uint8_t> *d;
+    uint32_t pos, start;
+    bool     loop;
+    bool     looped;        // loop was on at some point
+
+    uint32_t size() { return d->size(); }
+
+    uint32_t read(uint8_t *buf, uint32_t len)
+    {
+        uint32_t n = 0;
+        while(n < len) {
+            if(pos == size()) {
+                if(!loop || start >= size()) break;
+                pos = start;
+            }
+            buf[n++] = (*d)[pos++];
+        }
+        return n;
+    }
+
+    // A position at the end of a looped file is also its loop start
+    bool posIs(uint32_t p)
+    {
+        return p == pos || (looped && pos == size() && p == start);
+    }
+};
+
+struct Session {
+    AudioFileSourceSDLoop src;
+    Model    m;
+    int      file = -1;
+    int      ops = 0;
+};
+
+static Session sess[2];
+static int     files = 0;
+
+static void openNext(Session& s)
+{
+    char     name[32];
+    uint8_t  head[10];
+    uint32_t size, pos;
+    HostFileData *fd;
+
+    snprintf(name, sizeof(name), "/music0/%03d.mp3", files);
+    fd = &SD.files[name];
+    switch(rnd() % 4) {
+    case 0:  size = rnd() % 600; break;
+    case 1:  size = (1 + rnd() % 40) * 512; break;
+    default: size = rnd() % 70000; break;
+    }
+    fd->data.resize(size);
+    for(uint32_t i = 0; i < size; i++) fd->data[i] = rnd() >> 24;
+    fd->readDelay = (size > 4096) ? rnd() % 50 : 0;
+
+    havePSRAM = rnd() & 1;
+
+    s.file = files++;
+    s.ops = 0;
+    s.m.d = &fd->data;
+    s.m.loop = false;
+    s.m.pos = 0;
+
+    CHECK(s.src.open(name), "open %s", name);
+
+    // Like the audio task: ID3 header, skip, then loop setup
+    s.m.read(head, 10);
+    CHECK(s.src.read(head, 10) == (size < 10 ? size : 10) && (size < 10 || !memcmp(head, fd->data.data(), 10)),
+          "file %d: head", s.file);
+    pos = size ? rnd() % (size < 3000 ? size : 3000) : 0;
+    CHECK(s.src.seek(pos, SEEK_SET), "file %d: seek %u", s.file, pos);
+    s.m.pos = pos;
+    s.src.setStartPos(pos);
+    s.m.start = pos;
+    s.m.loop = s.m.looped = rnd() % 3 == 0;
+    s.src.setPlayLoop(s.m.loop);
+}
+
+// One read, seek or cut-off
+static bool step(Session& s)
+{
+    static uint8_t got[8192], want[8192];
+    uint32_t r = rnd() % 100, len, n, w, size = s.m.size();
+
+    if(r < 8 && size) {
+        uint32_t p = rnd() % (size + 1);
+        switch(rnd() % 3) {
+        case 0:
+            CHECK(s.src.seek(p, SEEK_SET), "file %d: seek set", s.file);
+            break;
+        case 1:
+            n = s.src.getPos();
+            p = rnd() % (size - n + 1);
+            CHECK(s.src.seek(p, SEEK_CUR), "file %d: seek cur", s.file);
+            p += n;
+            break;
+        case 2:
+            CHECK(s.src.seek(-(int32_t)p, SEEK_END), "file %d: seek end", s.file);
+            p = size - p;
+            break;
+        }
+        s.m.pos = p;
+    } else if(r < 10 && s.m.loop) {
+        s.src.setPlayLoop(false);
+        s.m.loop = false;
+    } else {
+        len = 1 + rnd() % (r < 50 ? 64 : sizeof(got));
+        n = s.src.read(got, len);
+        w = s.m.read(want, len);
+        CHECK(n == w && !memcmp(got, want, n), "file %d, op %d: read %u, got %u, want %u", s.file, s.ops, len, n, w);
+        if(!w) return false;
+    }
+    CHECK(s.m.posIs(s.src.getPos()), "file %d, op %d: pos %u, want %u", s.file, s.ops, s.src.getPos(), s.m.pos);
+
+    return ++s.ops < 150;
+}
+
+static uint32_t plain(uint8_t *, uint32_t len, uint32_t)
+{
+    return len;
+}
+
+// Header, TOC of ~offsets (one more than segments), segment data
+static void mkTCC(HostFileData& fd, int nseg, time_t mtime, std::vector<uint32_t>& offs)
+{
+    uint32_t tlen = (nseg + 1) * 4, o = 12 + tlen;
+    uint32_t hdr[3] = { 0x00434354, 1, tlen };
+
+    fd.data.assign((uint8_t *)hdr, (uint8_t *)hdr + 12);
+    offs.clear();
+    for(int i = 0; i <= nseg; i++) {
+        offs.push_back(o);
+        o += 100 + rnd() % 3000;
+    }
+    for(int i = 0; i <= nseg; i++) {
+        int32_t t = ~offs[i];
+        fd.data.insert(fd.data.end(), (uint8_t *)&t, (uint8_t *)&t + 4);
+    }
+    while(fd.data.size() < offs[nseg]) fd.data.push_back(rnd() >> 24);
+    fd.mtime = mtime;
+}
+
+static void playSegs(AudioFileSourceSDLoop& src, HostFileData& fd, const std::vector<uint32_t>& offs,
+                     const int16_t *segs, uint32_t wantRead, const char *what)
+{
+    static uint8_t got[65536];
+    std::vector<uint8_t> want;
+    uint32_t n = 0, g;
+
+    for(int i = 1; i <= segs[0]; i++) {
+        want.insert(want.end(), fd.data.begin() + offs[segs[i]], fd.data.begin() + offs[segs[i] + 1]);
+    }
+
+    fd.bytesRead = 0;
+    CHECK(src.open_c("/TCC.bin", segs), "%s: open_c", what);
+    while((g = src.read(got + n, 1 + rnd() % 700))) n += g;
+    CHECK(n == want.size() && !memcmp(got, want.data(), n), "%s: %u bytes, want %u", what, n, (uint32_t)want.size());
+    CHECK(fd.bytesRead == wantRead + n, "%s: read %u bytes from the file, want %u", what, fd.bytesRead, wantRead + n);
+    src.close();
+}
+
+// The TOC is read on the first play, and again when the file changes
+static void testSegments()
+{
+    AudioFileSourceSDLoop src;
+    HostFileData& fd = SD.files["/TCC.bin"];
+    std::vector<uint32_t> offs;
+    const int16_t segs[] = { 3, 7, 0, 12 }, bad[] = { 2, 3, 20 };
+
+    src.c = plain;
+
+    mkTCC(fd, 20, 1000, offs);
+    playSegs(src, fd, offs, segs, 12 + 21 * 4, "first play");
+    playSegs(src, fd, offs, segs, 0, "cached TOC");
+
+    mkTCC(fd, 13, 1000, offs);
+    playSegs(src, fd, offs, segs, 12 + 14 * 4, "new size");
+    fd.mtime = 2000;
+    playSegs(src, fd, offs, segs, 12 + 14 * 4, "new date");
+    playSegs(src, fd, offs, segs, 0, "cached again");
+    CHECK(!src.open_c("/TCC.bin", bad), "segment beyond TOC");
+
+    AudioFileSourceLoop::flushTOC();
+    playSegs(src, fd, offs, segs, 12 + 14 * 4, "flushed");
+}
+
+int main(int, char **argv)
+{
+    CHECK(AudioFileSourceLoop::startReader(1, 0), "reader task");
+
+    testSegments();
+
+    openNext(sess[0]);
+    openNext(sess[1]);
+
+    while(files < FILES) {
+        Session& s = sess[rnd() & 1];
+        if(!step(s)) openNext(s);
+    }
+
+    sess[0].src.close();
+    sess[1].src.close();
+
+    return testResult(argv[0]);
+}
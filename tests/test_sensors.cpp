@@ -0,0 +1,504 @@
+/*
+ * Temperature sensors (sensors.cpp) against fake devices, one of the
+ * nine at a time, in model time: Detection, decoding, the CRCs, and
+ * the timing of requestTemp()/loop(): No delay, no access while a
+ * conversion runs (which the devices answer with a NAK, or the AHT20
+ * with its busy bit), a result once the conversion time has passed.
+ */
+
+#include "tc_global.h"
+#include <Arduino.h>
+#include <Wire.h>
+
+#define private public      // _st, _delayNeeded
+#include "sensors.h"
+#undef private
+#include "tc_i2c.h"
+#include "tc_i2cq.h"
+
+#include "test.h"
+
+static const uint8_t addrArr[9*2] = {
+    0x18, MCP9808,
+    0x77, BMx280,
+    0x44, SHT40,
+    0x76, MS8607,   // before Si7021
+    0x40, SI7021,
+    0x49, TMP117,
+    0x38, AHT20,
+    0x41, HTU31,
+    0x45, HDC302X
+};
+
+static const char *names[9] = {
+    "MCP9808", "BMx280", "SHT40", "SI7021", "TMP117", "AHT20", "HTU31", "MS8607", "HDC302X"
+};
+
+// Expected results of the fake devices' readings, and how long a
+// result may take after requestTemp() (0: converts continuously;
+// BMx280 only needs time for the first conversion after begin())
+static const struct {
+    float temp;
+    int   hum;
+    int   readyMs;
+} want[9] = {
+    { 23.5f,   -1, 0  },    // MCP9808
+    { 25.08f,  54, 10 },    // BMx280 (datasheet's example calibration)
+    { 21.503f, 40, 10 },    // SHT40
+    { 24.0f,   55, 13 },    // SI7021
+    { -12.25f, -1, 0  },    // TMP117
+    { 25.0f,   50, 85 },    // AHT20
+    { 22.999f, 35, 20 },    // HTU31
+    { 22.0f,   45, 20 },    // MS8607
+    { 21.503f, 60, 20 },    // HDC302X
+};
+
+static uint32_t now;    // ms
+
+uint32_t micros()        { return now * 1000; }
+unsigned long millis()   { return now; }
+
+static int delays;
+
+void delay(unsigned long ms)
+{
+    now += ms;
+    delays++;
+}
+
+static void sensDelay(unsigned long ms)
+{
+    delay(ms);
+}
+
+// The datasheets' CRC-8 (poly 0x31), with the init value per sensor
+static uint8_t crc(uint8_t init, const uint8_t *buf, int len)
+{
+    uint8_t c = init;
+
+    while(len--) {
+        c ^= *buf++;
+        for(int i = 0; i < 8; i++) c = (c & 0x80) ? (c << 1) ^ 0x31 : (c << 1);
+    }
+    return c;
+}
+
+// One I2C address of the simulated sensor. A command sets up what
+// the next read returns; while busy, the device NAKs (or, AHT20,
+// reports busy)
+struct Part {
+    uint8_t  addr;
+    bool     present;
+    uint32_t busyUntil;
+    uint8_t  out[8];
+    int      outLen;
+    uint16_t r16[16];       // MCP9808, TMP117
+    uint8_t  r8[256 + 8];   // BMx280, SI7021 et al
+};
+
+static struct {
+    int      type;
+    Part     p[2];          // p[1]: MS8607 rH part
+    bool     badCrc;        // corrupt the first CRC of a result
+    uint32_t aht20Extra;    // AHT20: busy that much longer; ~0: stuck
+    uint32_t xfers, naks, early, busyReads;
+} sim;
+
+static Part *part(uint8_t addr)
+{
+    for(auto& p : sim.p) {
+        if(p.present && p.addr == addr) return &p;
+    }
+    return NULL;
+}
+
+static bool busy(Part& p)
+{
+    return (int32_t)(now - p.busyUntil) < 0;
+}
+
+// Two 16 bit words with their CRCs (SHT40, HTU31, HDC302x)
+static void out6(Part& p, uint8_t init, uint16_t t, uint16_t h)
+{
+    p.out[0] = t >> 8; p.out[1] = t; p.out[2] = crc(init, p.out, 2);
+    p.out[3] = h >> 8; p.out[4] = h; p.out[5] = crc(init, p.out + 3, 2);
+    p.outLen = 6;
+    if(sim.badCrc) p.out[2] ^= 1;
+}
+
+static void out3(Part& p, uint8_t init, uint16_t v)
+{
+    p.out[0] = v >> 8; p.out[1] = v; p.out[2] = crc(init, p.out, 2);
+    p.outLen = 3;
+    if(sim.badCrc) p.out[2] ^= 1;
+}
+
+static void command(Part& p, const uint8_t *w, int wlen)
+{
+    uint16_t c16 = (wlen >= 2) ? (w[0] << 8) | w[1] : 0;
+
+    p.outLen = 0;
+
+    switch(sim.type) {
+    case MCP9808:
+    case TMP117:
+        if(wlen == 3) {
+            p.r16[w[0] & 15] = c16 = (w[1] << 8) | w[2];
+            if(sim.type == TMP117 && w[0] == 1 && (c16 & 0x0002)) {
+                p.r16[1] = 0x0220;
+                p.busyUntil = now + 2;
+            }
+        } else if(wlen == 1) {
+            p.out[0] = p.r16[w[0] & 15] >> 8;
+            p.out[1] = p.r16[w[0] & 15];
+            p.outLen = 2;
+        }
+        break;
+
+    case BMx280:
+        if(wlen == 2) {
+            p.r8[w[0]] = w[1];
+            if(w[0] == 0xe0 && w[1] == 0xb6) p.busyUntil = now + 2;
+        } else if(wlen == 1) {
+            memcpy(p.out, &p.r8[w[0]], 8);
+            p.outLen = 8;
+        }
+        break;
+
+    case SHT40:
+        if(w[0] == 0x94) {
+            p.busyUntil = now + 1;
+        } else if(w[0] == 0xe0 || w[0] == 0xf6) {
+            p.busyUntil = now + (w[0] == 0xe0 ? 2 : 5);
+            out6(p, 0xff, 24904, 24117);
+        }
+        break;
+
+    case SI7021:
+        if(wlen == 2) {
+            p.r8[w[0]] = w[1];
+        } else if(w[0] == 0xfe) {
+            p.r8[0xe7] = 0x3a;
+            p.busyUntil = now + 15;
+        } else if(w[0] == 0xf5) {
+            p.busyUntil = now + 12;
+            out3(p, 0x00, 31982);
+        } else if(w[0] == 0xe0) {
+            // Temperature of the last rH measurement, no CRC
+            p.out[0] = 26424 >> 8; p.out[1] = 26424 & 0xff;
+            p.outLen = 2;
+        } else {
+            p.out[0] = p.r8[w[0]];
+            p.outLen = 1;
+        }
+        break;
+
+    case AHT20:
+        if(w[0] == 0xac) {
+            // 20 bits rH, 20 bits temperature
+            uint32_t h = 0x80000, t = 0x60000;
+            p.busyUntil = now + 80 + sim.aht20Extra;
+            if(sim.aht20Extra == ~0u) p.busyUntil = now + 0x7fffffff;
+            p.out[0] = 0x18;            // calibrated, not busy
+            p.out[1] = h >> 12; p.out[2] = h >> 4;
+            p.out[3] = ((h & 0x0f) << 4) | (t >> 16);
+            p.out[4] = t >> 8; p.out[5] = t;
+            p.out[6] = crc(0xff, p.out, 6);
+            p.outLen = 7;
+            if(sim.badCrc) p.out[6] ^= 1;
+        }
+        break;
+
+    case HTU31:
+        if(w[0] == 0x1e) {
+            p.busyUntil = now + 15;
+        } else if(w[0] == 0x44) {
+            p.busyUntil = now + 5;
+            p.r8[0] = 1;
+        } else if(w[0] == 0x00 && p.r8[0]) {
+            out6(p, 0x00, 25022, 23265);
+        }
+        break;
+
+    case MS8607:
+        if(&p == &sim.p[0]) {
+            // Pressure/temperature part; ADC read during a conversion gives 0
+            if(w[0] == 0x1e) {
+                p.busyUntil = now + 3;
+            } else if(w[0] == 0xaa || w[0] == 0xac) {
+                uint16_t v = (w[0] == 0xaa) ? 32768 : 25600;    // C5, C6
+                p.out[0] = v >> 8; p.out[1] = v;
+                p.outLen = 2;
+            } else if(w[0] == 0x54) {
+                p.busyUntil = now + 3;
+                p.r8[0] = 1;
+            } else if(w[0] == 0x00) {
+                uint32_t d2 = 32768 * 256 + 65536;
+                p.out[0] = d2 >> 16; p.out[1] = d2 >> 8; p.out[2] = d2;
+                if(busy(p) || !p.r8[0]) memset(p.out, 0, 3);
+                p.r8[0] = 0;
+                p.outLen = 3;
+            }
+        } else {
+            // rH part, like HTU21
+            if(wlen == 2) {
+                p.r8[w[0]] = w[1];
+            } else if(w[0] == 0xfe) {
+                p.r8[0xe7] = 0x02;
+                p.busyUntil = now + 15;
+            } else if(w[0] == 0xf5) {
+                p.busyUntil = now + 5;
+                out3(p, 0x00, 27001);
+            } else {
+                p.out[0] = p.r8[w[0]];
+                p.outLen = 1;
+            }
+        }
+        break;
+
+    case HDC302X:
+        if(wlen == 5) {
+            p.busyUntil = now + 80;     // EEPROM write
+        } else if(c16 == 0x3781) {
+            out3(p, 0xff, 0x3000);
+        } else if(c16 == 0x61bb || c16 == 0xa004) {
+            out3(p, 0xff, 0x0000);
+        } else if(c16 == 0x30a2) {
+            p.busyUntil = now + 1;
+        } else if(c16 == 0x2400) {
+            p.busyUntil = now + 13;
+            out6(p, 0xff, 24904, 39322);
+        }
+        break;
+    }
+}
+
+int i2c_xfer(uint8_t dev, uint8_t addr, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen, bool)
+{
+    Part *p = part(addr);
+
+    CHECK(dev == I2CD_TEMP, "transaction for device %d", dev);
+
+    sim.xfers++;
+    if(rlen) memset(rbuf, 0xff, rlen);
+    if(!p) return I2CE_NAK;
+
+    if(busy(*p)) {
+        sim.early++;
+        if(sim.type == AHT20) {
+            if(!wlen && rlen) sim.busyReads++;
+        } else if(sim.type != MS8607 || p != &sim.p[0]) {
+            sim.naks++;
+            return I2CE_NAK;
+        }
+    }
+
+    if(wlen) command(*p, wbuf, wlen);
+
+    if(rlen) {
+        int n = (rlen < p->outLen) ? rlen : p->outLen;
+        memcpy(rbuf, p->out, n);
+        if(sim.type == AHT20 && busy(*p)) rbuf[0] |= 0x80;
+        return rlen;
+    }
+    return 0;
+}
+
+// begin() probes with Wire
+TwoWire Wire;
+static uint8_t probeAddr;
+
+void TwoWire::beginTransmission(uint8_t addr)
+{
+    probeAddr = addr;
+}
+
+uint8_t TwoWire::endTransmission(bool)
+{
+    sim.xfers++;
+    return part(probeAddr) ? 0 : 2;
+}
+
+static void setup(int type)
+{
+    static const uint8_t addr[9] = { 0x18, 0x77, 0x44, 0x40, 0x49, 0x38, 0x41, 0x76, 0x45 };
+
+    memset(&sim, 0, sizeof(sim));
+    sim.type = type;
+    now = 1000;
+
+    if(type < 0) return;
+
+    Part& p = sim.p[0];
+    p.addr = addr[type];
+    p.present = true;
+
+    switch(type) {
+    case MCP9808:
+        p.r16[5] = 0x0178;              // 23.5
+        p.r16[6] = 0x0054;
+        p.r16[7] = 0x0400;
+        break;
+    case TMP117:
+        p.r16[0] = (uint16_t)-1568;     // -12.25
+        p.r16[1] = 0x0220;
+        p.r16[15] = 0x2117;
+        break;
+    case BMx280: {
+        static const uint8_t calib[][2] = {
+            { 0x88, 27504 & 0xff }, { 0x89, 27504 >> 8 },   // T1
+            { 0x8a, 26435 & 0xff }, { 0x8b, 26435 >> 8 },   // T2
+            { 0x8c, 0x18 }, { 0x8d, 0xfc },                 // T3 = -1000
+            { 0xa1, 75 },                                   // H1
+            { 0xe1, 362 & 0xff }, { 0xe2, 362 >> 8 },       // H2
+            { 0xe3, 0 },                                    // H3
+            { 0xe4, 313 >> 4 }, { 0xe5, (313 & 0x0f) | ((50 & 0x0f) << 4) }, { 0xe6, 50 >> 4 },
+            { 0xe7, 30 },                                   // H6
+            { 0xd0, 0x60 },                                 // BME280
+        };
+        for(auto& c : calib) p.r8[c[0]] = c[1];
+        // Temperature 519888, rH 30000
+        p.r8[0xfa] = 519888 >> 12; p.r8[0xfb] = (519888 >> 4) & 0xff; p.r8[0xfc] = (519888 & 0x0f) << 4;
+        p.r8[0xfd] = 30000 >> 8;   p.r8[0xfe] = 30000 & 0xff;
+        break;
+        }
+    case SI7021:
+        p.r8[0xe7] = 0x3a;
+        break;
+    case MS8607:
+        sim.p[1].addr = 0x40;
+        sim.p[1].present = true;
+        sim.p[1].r8[0xe7] = 0x02;
+        break;
+    }
+}
+
+static bool near(float a, float b)
+{
+    return fabsf(a - b) < 0.01f;
+}
+
+// requestTemp() and loop() every millisecond until a result is in;
+// returns the time it took, -1 if none after a second
+static int measure(tempSensor& ts)
+{
+    uint32_t start = now;
+
+    ts.requestTemp();
+    for(int i = 0; i < 1000; i++) {
+        uint32_t xfers = sim.xfers;
+        if(ts.loop()) return now - start;
+        CHECK(sim.xfers == xfers || sim.type == AHT20, "%s: loop() accessed the bus without a result", names[sim.type]);
+        now++;
+    }
+    return -1;
+}
+
+static void testSensor(int type)
+{
+    tempSensor ts(9, addrArr);
+    const char *name = names[type];
+    int t;
+
+    setup(type);
+    CHECK(ts.begin(sensDelay, true), "%s: not found", name);
+    CHECK(ts._st == type, "%s: detected as %s", name, ts._st >= 0 ? names[ts._st] : "nothing");
+    CHECK(ts._delayNeeded <= (unsigned)want[type].readyMs, "%s: waits %lums", name, ts._delayNeeded);
+
+    delays = 0;
+    sim.early = sim.naks = 0;
+
+    for(int i = 0; i < 5; i++) {
+        t = measure(ts);
+        CHECK(t >= 0 && t <= want[type].readyMs, "%s: result after %dms", name, t);
+        CHECK(near(ts.readLastTemp(), want[type].temp), "%s: %.3f, expected %.3f", name, ts.readLastTemp(), want[type].temp);
+        CHECK(ts.readLastTempT100() == (int16_t)(want[type].temp * 100.0f), "%s: T100 %d", name, ts.readLastTempT100());
+        if(want[type].hum >= 0) {
+            CHECK(ts.haveHum() && ts.readHum() == want[type].hum, "%s: rH %d, expected %d", name, ts.readHum(), want[type].hum);
+        }
+        now += 1000;
+    }
+
+    // The blocking path gives the same
+    CHECK(near(ts.readTemp(), want[type].temp), "%s: readTemp() %.3f", name, ts.readLastTemp());
+
+    CHECK(sim.early == 0, "%s: %u accesses during a conversion (%u NAKs)", name, sim.early, sim.naks);
+    CHECK(!want[type].readyMs || delays <= 1, "%s: %d delays", name, delays);
+
+    // Without the blocking path: no delays at all
+    delays = 0;
+    measure(ts);
+    CHECK(delays == 0, "%s: %d delays in requestTemp()/loop()", name, delays);
+}
+
+// A corrupt CRC gives NAN, not a wrong reading
+static void testCrc(int type)
+{
+    tempSensor ts(9, addrArr);
+
+    setup(type);
+    ts.begin(sensDelay, true);
+    measure(ts);
+    CHECK(!ts.lastTempNan(), "%s: good CRC: NAN", names[type]);
+
+    now += 1000;
+    sim.badCrc = true;
+    measure(ts);
+    CHECK(ts.lastTempNan() && isnan(ts.readLastTemp()), "%s: bad CRC: %.3f", names[type], ts.readLastTemp());
+    CHECK(ts.readLastTempT100() == -32768, "%s: bad CRC: T100 %d", names[type], ts.readLastTempT100());
+}
+
+// AHT20 reports busy in its status byte instead of a NAK: loop()
+// must wait for the bit, and give up on a sensor that stays busy
+static void testAht20Busy()
+{
+    tempSensor ts(9, addrArr);
+    int t;
+
+    setup(AHT20);
+    ts.begin(sensDelay, true);
+    measure(ts);
+
+    now += 1000;
+    sim.aht20Extra = 30;
+    t = measure(ts);
+    CHECK(t >= 110 && t <= 115, "AHT20 busy 30ms longer: result after %dms", t);
+    CHECK(near(ts.readLastTemp(), 25.0f), "AHT20 busy 30ms longer: %.3f", ts.readLastTemp());
+    CHECK(sim.busyReads <= 7, "AHT20 busy 30ms longer: read %u times while busy", sim.busyReads);
+
+    // Asked every 5ms, not on every loop()
+    now += 1000;
+    sim.aht20Extra = ~0u;
+    sim.busyReads = 0;
+    t = measure(ts);
+    CHECK(t >= 85 * 4 - 10 && t <= 85 * 4 + 10, "AHT20 stuck: gave up after %dms", t);
+    CHECK(ts.lastTempNan(), "AHT20 stuck: %.3f", ts.readLastTemp());
+    CHECK(sim.busyReads <= 52, "AHT20 stuck: read %u times", sim.busyReads);
+
+    // And it recovers
+    now += 1000;
+    sim.aht20Extra = 0;
+    measure(ts);
+    CHECK(near(ts.readLastTemp(), 25.0f), "AHT20 after stuck: %.3f", ts.readLastTemp());
+}
+
+int main(int, char **argv)
+{
+    for(int type = MCP9808; type <= HDC302X; type++) {
+        testSensor(type);
+    }
+
+    testCrc(SHT40);
+    testCrc(AHT20);
+    testCrc(HTU31);
+    testCrc(HDC302X);
+
+    testAht20Busy();
+
+    // Nothing connected
+    tempSensor ts(9, addrArr);
+    setup(-1);
+    CHECK(!ts.begin(sensDelay, true), "found a sensor on an empty bus");
+
+    return testResult(argv[0]);
+}
@@ -0,0 +1,297 @@
+/*
+ * Calendar and time conversion code from tc_main.cpp (pulled out
+ * by extract.sh), checked against a plain Julian Day Number
+ * reference, against the functions it replaced (old_time.h), and
+ * against glibc's POSIX TZ handling.
+ *
+ * Built with and without TC_JULIAN_CAL.
+ *
+ * Usage: test_time <timezones.csv>
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include <fstream>
+
+#include "test.h"
+#include "time_stub.h"
+#include "time_impl.h"
+#include "old_time.h"
+
+static uint32_t rnd()
+{
+    static uint32_t s = 2463534242u;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+}
+
+/*
+ * Reference calendar: Julian Day Numbers
+ */
+#ifdef TC_JULIAN_CAL
+#ifndef JSWITCH_1582
+static const int sY = 1752, sM = 9, sD = 2, sSkip = 11;
+#else
+static const int sY = 1582, sM = 10, sD = 4, sSkip = 10;
+#endif
+#else
+static const int sY = 0, sM = 0, sD = 0, sSkip = 0;
+#endif
+
+static long gregJDN(long y, int m, int d)
+{
+    long a = (14 - m) / 12, yy = y + 4800 - a, mm = m + 12 * a - 3;
+    return d + (153 * mm + 2) / 5 + 365 * yy + yy / 4 - yy / 100 + yy / 400 - 32045;
+}
+
+static long refDays(long y, int m, int d)
+{
+    #ifdef TC_JULIAN_CAL
+    if(y < sY || (y == sY && (m < sM || (m == sM && d <= sD)))) {
+        long a = (14 - m) / 12, yy = y + 4800 - a, mm = m + 12 * a - 3;
+        return d + (153 * mm + 2) / 5 + 365 * yy + yy / 4 - 32083;
+    }
+    #endif
+    return gregJDN(y, m, d);
+}
+
+static void refDate(long jdn, int& y, int& m, int& d)
+{
+    long c, dd, e, mm, b = 0;
+
+    #ifdef TC_JULIAN_CAL
+    if(jdn < gregJDN(sY, sM, sD + sSkip + 1)) {
+        c = jdn + 32082;
+    } else
+    #endif
+    {
+        long a = jdn + 32044;
+        b = (4 * a + 3) / 146097;
+        c = a - (146097 * b) / 4;
+    }
+    dd = (4 * c + 3) / 1461;
+    e = c - (1461 * dd) / 4;
+    mm = (5 * e + 2) / 153;
+    d = e - (153 * mm + 2) / 5 + 1;
+    m = mm + 3 - 12 * (mm / 10);
+    y = 100 * b + dd - 4800 + mm / 10;
+}
+
+static bool skipped(int y, int m, int d)
+{
+    return (y == sY && m == sM && d > sD && d <= sD + sSkip);
+}
+
+static void testCalendar()
+{
+    const long d0 = refDays(0, 1, 1);
+
+    for(int y = 0; y <= 9999; y++) {
+        CHECK(isLeapYear(y) == (refDays(y, 3, 1) - refDays(y, 2, 1) == 29), "isLeapYear %d", y);
+        for(int m = 1; m <= 12; m++) {
+            long dim = refDays(m == 12 ? y + 1 : y, m == 12 ? 1 : m + 1, 1) - refDays(y, m, 1);
+            if(y == sY && m == sM) dim += sSkip;
+            CHECK(daysInMonth(m, y) == dim, "daysInMonth %d-%d", y, m);
+            for(int d = 1; d <= dim; d++) {
+                if(skipped(y, m, d)) continue;
+                long dn = refDays(y, m, d);
+                int h = rnd() % 24, mi = rnd() % 60;
+                int y2, m2, d2, h2, mi2;
+                uint64_t mins = dateToMins(y, m, d, h, mi);
+                CHECK(mins == (uint64_t)(dn - d0) * 1440 + h * 60 + mi, "dateToMins %d-%d-%d", y, m, d);
+                CHECK(mins == old::dateToMins(y, m, d, h, mi), "dateToMins %d-%d-%d differs from old", y, m, d);
+                minsToDate(mins, y2, m2, d2, h2, mi2);
+                CHECK(y2 == y && m2 == m && d2 == d && h2 == h && mi2 == mi, "minsToDate %d-%d-%d", y, m, d);
+                // First and last minute of the day, as the old code has them
+                for(int k = 0; k < 2; k++) {
+                    uint64_t t = mins - h * 60 - mi + k * 1439;
+                    int oy, om, od, oh, omi;
+                    old::minsToDate(t, oy, om, od, oh, omi);
+                    minsToDate(t, y2, m2, d2, h2, mi2);
+                    CHECK(y2 == oy && m2 == om && d2 == od && h2 == oh && mi2 == omi,
+                          "minsToDate %d-%d-%d +%d differs from old", y, m, d, k * 1439);
+                }
+                CHECK(dayOfWeek(d, m, y) == (dn + 1) % 7, "dayOfWeek %d-%d-%d", y, m, d);
+            }
+        }
+    }
+}
+
+/*
+ * convTime() against minute arithmetic on the reference (it
+ * subtracts diff, which is in POSIX TZ sign convention) and against
+ * the old convTime(); years wrap from 9999 to 1 and vice versa.
+ * The old code could end up inside the days skipped by the Julian
+ * switch, so it is only compared outside the year of the switch.
+ * With a day number pointer, as used by updateAllTimes(), the
+ * result must be the same.
+ */
+static void testConvTime()
+{
+    const long d1 = refDays(1, 1, 1);
+    const long span = (refDays(10000, 1, 1) - d1) * 1440;
+
+    for(long i = 0; i < 2000000; i++) {
+        int y = (i % 1000) ? 1 + rnd() % 9999 : ((i & 1000) ? 9999 : 1);
+        int m = 1 + rnd() % 12;
+        int d = 1 + rnd() % daysInMonth(m, y);
+        int h = rnd() % 24, mi = rnd() % 60;
+        int32_t dayNum = -1;
+
+        if(skipped(y, m, d)) continue;
+
+        for(int k = 0; k < 3; k++) {
+            int diff = (i % 7) ? (int)(rnd() % (2*26*60+1)) - 26*60 : (int)(rnd() % (2*3*24*60+1)) - 3*24*60;
+            int yy = y, mm = m, dd = d, hh = h, mimi = mi;
+            int oy = y, om = m, od = d, oh = h, omi = mi;
+            int ey, em, ed;
+            long t = (refDays(y, m, d) - d1) * 1440 + h * 60 + mi - diff;
+
+            t = ((t % span) + span) % span;
+            refDate(d1 + t / 1440, ey, em, ed);
+
+            convTime(diff, yy, mm, dd, hh, mimi, k ? &dayNum : NULL);
+            CHECK(yy == ey && mm == em && dd == ed && hh == (t % 1440) / 60 && mimi == t % 60,
+                  "convTime %d-%d-%d %d:%d %+d%s: %d-%d-%d %d:%d", y, m, d, h, mi, diff, k ? " (dayNum)" : "",
+                  yy, mm, dd, hh, mimi);
+            if(y != sY && ey != sY) {
+                old::convTime(diff, oy, om, od, oh, omi);
+                CHECK(yy == oy && mm == om && dd == od && hh == oh && mimi == omi,
+                      "convTime %d-%d-%d %d:%d %+d differs from old", y, m, d, h, mi, diff);
+            }
+        }
+    }
+}
+
+/*
+ * UTCtoLocal() against glibc for all time zones of the Config
+ * Portal's list: 1970-2100 coarsely, one year in 15 minute steps
+ */
+static bool checkZone(const char *tz, long from, long to, long step)
+{
+    for(long t = from; t < to; t += step) {
+        time_t tt = t;
+        struct tm u, l;
+        DateTime dtu, dtl;
+
+        gmtime_r(&tt, &u);
+        localtime_r(&tt, &l);
+        dtu.set(u.tm_year + 1900, u.tm_mon + 1, u.tm_mday, u.tm_hour, u.tm_min, u.tm_sec);
+        UTCtoLocal(dtu, dtl, 0);
+        if(dtl.year() != l.tm_year + 1900 || dtl.month() != l.tm_mon + 1 || dtl.day() != l.tm_mday ||
+           dtl.hour() != l.tm_hour || dtl.minute() != l.tm_min) {
+            CHECK(false, "%s: UTC %d-%02d-%02d %02d:%02d -> %d-%02d-%02d %02d:%02d, glibc %02d:%02d", tz,
+                  dtu.year(), dtu.month(), dtu.day(), dtu.hour(), dtu.minute(),
+                  dtl.year(), dtl.month(), dtl.day(), dtl.hour(), dtl.minute(), l.tm_hour, l.tm_min);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void setZone(int index, const char *tz)
+{
+    char *s = index == 0 ? settings.timeZone : (index == 1 ? settings.timeZoneDest : settings.timeZoneDep);
+
+    strcpy(s, tz);
+    tzIsValid[index] = -1;
+    tzHasDST[index] = -1;
+    tzForYear[index] = 0;
+}
+
+static int testZones(const char *csv)
+{
+    std::ifstream f(csv);
+    std::string line;
+    int zones = 0;
+
+    while(std::getline(f, line)) {
+        size_t p = line.find("\",\"");
+        if(p == std::string::npos) continue;
+        std::string tz = line.substr(p + 3);
+        tz = tz.substr(0, tz.rfind('"'));
+        zones++;
+
+        setZone(0, tz.c_str());
+        CHECK(parseTZ(0, 2022), "parseTZ %s", tz.c_str());
+
+        setenv("TZ", tz.c_str(), 1);
+        tzset();
+
+        checkZone(tz.c_str(), 0, 4102444800L, 4999 * 60) &&
+        checkZone(tz.c_str(), 1735689600L, 1767225600L, 15 * 60);
+    }
+
+    return zones;
+}
+
+/*
+ * updateAllTimes() in WC mode: Same local times as three separate
+ * UTCtoLocal() calls, destination/departed only updated when the
+ * minute changes
+ */
+static DateTime wcDest, wcDep;
+
+static void setDatesTimesWCInt(const DateTime& dtu, int32_t *utcDayNum)
+{
+    UTCtoLocalInt(dtu, wcDest, 1, utcDayNum);
+    UTCtoLocalInt(dtu, wcDep, 2, utcDayNum);
+    wcUpdates++;
+}
+
+static void same(const DateTime& a, const DateTime& b, const char *what, const DateTime& u)
+{
+    CHECK(a.year() == b.year() && a.month() == b.month() && a.day() == b.day() &&
+          a.hour() == b.hour() && a.minute() == b.minute(),
+          "updateAllTimes %s at %d-%d-%d %d:%d", what, u.year(), u.month(), u.day(), u.hour(), u.minute());
+}
+
+static void testAllTimes()
+{
+    setZone(0, "CET-1CEST,M3.5.0,M10.5.0/3");
+    setZone(1, "NST3:30NDT,M3.2.0,M11.1.0");
+    setZone(2, "LHST-10:30LHDT-11,M10.1.0,M4.1.0");
+    for(int i = 0; i < 3; i++) parseTZ(i, 2026);
+    wcMode = true;
+
+    // March 1 to mid May 2026, across all three DST changes
+    for(time_t t = 1772323200; t < 1772323200 + 76*86400; t += 11) {
+        struct tm tu;
+        DateTime u, l;
+
+        gmtime_r(&t, &tu);
+        u.set(tu.tm_year + 1900, tu.tm_mon + 1, tu.tm_mday, tu.tm_hour, tu.tm_min, tu.tm_sec);
+        int before = wcUpdates;
+        bool newMin = (u.minute() != wcLastMin);
+        updateAllTimes(u);
+        CHECK(wcUpdates - before == newMin, "updateAllTimes: WC update at %d:%d:%d", u.hour(), u.minute(), u.second());
+        UTCtoLocal(u, l, 0); same(gdtl, l, "present", u);
+        UTCtoLocal(u, l, 1); same(wcDest, l, "destination", u);
+        UTCtoLocal(u, l, 2); same(wcDep, l, "departed", u);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    int zones;
+
+    if(argc < 2) {
+        printf("Usage: %s <timezones.csv>\n", argv[0]);
+        return 2;
+    }
+
+    #ifdef TC_JULIAN_CAL
+    old::calcJulianData();
+    #endif
+
+    testCalendar();
+    testConvTime();
+    testAllTimes();
+    zones = testZones(argv[1]);
+
+    CHECK(zones > 400, "%s: only %d zones", argv[1], zones);
+
+    return testResult(argv[0]);
+}
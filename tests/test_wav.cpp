@@ -0,0 +1,172 @@
+/*
+ * AudioGeneratorWAV with in-place reading: The beep from tc_beep.h,
+ * played from AudioFileSourcePROGMEM, must come out as the samples in
+ * its data chunk, without a malloc and without a read() after the
+ * header. The buffered path (source without readPtr(), or data not
+ * 16 bit aligned) must give the same output, also when read()
+ * returns odd lengths, which splits frames across reads.
+ */
+
+#include <stdlib.h>
+#include <vector>
+
+#include "test.h"
+#include "src/ESP8266Audio/AudioFileSourcePROGMEM.h"
+#include "src/ESP8266Audio/AudioGeneratorWAV.h"
+#include "tc_beep.h"
+
+// Takes 512 frames per loop, like the mixer's voice ring
+class Capture : public AudioOutput
+{
+  public:
+    Capture() { L.reserve(1 << 16); R.reserve(1 << 16); }   // no mallocs while playing
+    bool begin() override { return true; }
+    bool stop() override { return true; }
+    size_t ConsumeSample(int16_t sL, int16_t sR) override
+    {
+        if(room <= 0) return 0;
+        L.push_back(sL);
+        R.push_back(sR);
+        room--;
+        return 4;
+    }
+    uint16_t ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count) override
+    {
+        if(count > room) count = room;
+        for(int i = 0; i < count; i++, sL += stride, sR += stride) {
+            L.push_back(*sL);
+            R.push_back(*sR);
+        }
+        room -= count;
+        return count;
+    }
+
+    std::vector<int16_t> L, R;
+    int room = 0;
+};
+
+// Counts read() calls; optionally hides readPtr() (the old path),
+// and returns at most maxRead bytes per read()
+class Src : public AudioFileSourcePROGMEM
+{
+  public:
+    Src(const void *d, uint32_t len, bool inPlace) : AudioFileSourcePROGMEM(d, len), inPlace(inPlace) {}
+    uint32_t read(void *data, uint32_t len) override
+    {
+        reads++;
+        if(maxRead && len > maxRead) len = maxRead;
+        return AudioFileSourcePROGMEM::read(data, len);
+    }
+    const void *readPtr(uint32_t *len) override
+    {
+        if(inPlace) return AudioFileSourcePROGMEM::readPtr(len);
+        *len = 0;
+        return NULL;
+    }
+
+    bool     inPlace;
+    int      reads = 0;
+    uint32_t maxRead = 0;
+};
+
+static int mallocs;
+static bool countMallocs;
+
+extern "C" void *__libc_malloc(size_t);
+
+extern "C" void *malloc(size_t n)
+{
+    if(countMallocs) mallocs++;
+    return __libc_malloc(n);
+}
+
+static void play(const void *data, uint32_t len, bool inPlace, Capture& cap, int& nMalloc, int& nRead, uint32_t maxRead = 0)
+{
+    Src src(data, len, inPlace);
+    AudioGeneratorWAV wav;
+
+    mallocs = 0;
+    countMallocs = true;
+    CHECK(wav.begin(&src, &cap), "begin");
+    nRead = src.reads;
+    src.maxRead = maxRead;      // after the header
+    while(wav.isRunning()) {
+        cap.room = 512;
+        if(!wav.loop()) break;
+    }
+    countMallocs = false;
+    wav.stop();
+    nMalloc = mallocs;
+    nRead = src.reads - nRead;
+}
+
+int main(int, char **argv)
+{
+    Capture inPlace, buffered, odd;
+    int m, r;
+
+    // Expected: the data chunk as it is (16 bit mono, which the
+    // generator puts out as L = R)
+    const uint8_t *d = data_beep_wav + 12;
+    while(memcmp(d, "data", 4)) {
+        d += 8 + (d[4] | (d[5] << 8) | (d[6] << 16) | (d[7] << 24));
+    }
+    uint32_t dlen = d[4] | (d[5] << 8) | (d[6] << 16) | (d[7] << 24);
+    const int16_t *want = (const int16_t *)(d + 8);
+
+    play(data_beep_wav, data_beep_wav_len, true, inPlace, m, r);
+    CHECK(m == 0, "in place: %d mallocs", m);
+    CHECK(r == 0, "in place: %d reads after the header", r);
+    CHECK(inPlace.L.size() == dlen / 2, "in place: %u frames, expected %u", (unsigned)inPlace.L.size(), dlen / 2);
+    for(size_t i = 0; i < inPlace.L.size() && i < dlen / 2; i++) {
+        if(inPlace.L[i] != want[i] || inPlace.R[i] != want[i]) {
+            CHECK(false, "in place: frame %u is %d/%d, expected %d", (unsigned)i, inPlace.L[i], inPlace.R[i], want[i]);
+            break;
+        }
+    }
+
+    play(data_beep_wav, data_beep_wav_len, false, buffered, m, r);
+    CHECK(m == 1, "buffered: %d mallocs", m);
+    CHECK(r > 0, "buffered: no reads");
+    CHECK(buffered.L == inPlace.L && buffered.R == inPlace.R, "buffered: output differs");
+
+    // Odd address: must not be read in place
+    std::vector<uint8_t> copy(data_beep_wav_len + 1);
+    memcpy(&copy[1], data_beep_wav, data_beep_wav_len);
+    play(&copy[1], data_beep_wav_len, true, odd, m, r);
+    CHECK(m == 1, "odd address: %d mallocs", m);
+    CHECK(odd.L == inPlace.L && odd.R == inPlace.R, "odd address: output differs");
+
+    // Short reads of odd length
+    Capture shortRd;
+    play(data_beep_wav, data_beep_wav_len, false, shortRd, m, r, 61);
+    CHECK(shortRd.L == inPlace.L && shortRd.R == inPlace.R, "short reads: output differs");
+
+    // Stereo, L = i, R = ~i, with frames split by short reads
+    const uint32_t frames = 5000;
+    std::vector<uint8_t> st(44 + frames * 4);
+    const uint32_t hdr[11] = {
+        0x46464952, 36 + frames * 4, 0x45564157,        // RIFF, WAVE
+        0x20746d66, 16, 0x00020001, 44100, 44100 * 4,   // fmt: PCM, 2 ch
+        0x00100004,                                     // 4 bytes/frame, 16 bit
+        0x61746164, frames * 4                          // data
+    };
+    memcpy(&st[0], hdr, sizeof(hdr));
+    for(uint32_t i = 0; i < frames; i++) {
+        int16_t s[2] = { (int16_t)i, (int16_t)~i };
+        memcpy(&st[44 + i * 4], s, 4);
+    }
+    for(uint32_t maxRead : { 0u, 125u, 2u, 7u }) {
+        Capture stereo;
+        play(&st[0], st.size(), false, stereo, m, r, maxRead);
+        CHECK(stereo.L.size() == frames, "stereo, reads of %u: %u frames", maxRead, (unsigned)stereo.L.size());
+        for(size_t i = 0; i < stereo.L.size(); i++) {
+            if(stereo.L[i] != (int16_t)i || stereo.R[i] != (int16_t)~i) {
+                CHECK(false, "stereo, reads of %u: frame %u is %d/%d", maxRead, (unsigned)i, stereo.L[i], stereo.R[i]);
+                break;
+            }
+        }
+    }
+
+    return testResult(argv[0]);
+}
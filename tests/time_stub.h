@@ -0,0 +1,61 @@
+/*
+ * Host stand-ins for what the time code in tc_main.cpp needs
+ * (see extract.sh)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static struct {
+    template<typename... A> void printf(const char *, A...) {}
+} Serial;
+
+class DateTime {
+    public:
+        uint16_t year()   const { return _y; }
+        uint8_t  month()  const { return _m; }
+        uint8_t  day()    const { return _d; }
+        uint8_t  hour()   const { return _hh; }
+        uint8_t  minute() const { return _mm; }
+        uint8_t  second() const { return _ss; }
+        void     set(uint16_t yyy, uint8_t mon, uint8_t ddd, 
+                     uint8_t hhh = 0, uint8_t mmm = 0, uint8_t sss = 0) 
+                    {
+                        _y  = yyy; _m  = mon; _d  = ddd; 
+                        _hh = hhh; _mm = mmm; _ss = sss;
+                    }
+    private:
+        uint16_t _y = 2000;
+        uint8_t  _m = 1, _d = 1, _hh = 0, _mm = 0, _ss = 0;
+};
+
+static struct {
+    char timeZone[64];
+    char timeZoneDest[64];
+    char timeZoneDep[64];
+} settings;
+
+// From tc_main.h
+uint8_t   dayOfWeek(int d, int m, int y);
+int       daysInMonth(int month, int year);
+bool      isLeapYear(int year);
+uint32_t  getHrs1KYrs(int index);
+void      correctNonExistingDate(int year, int month, int& day);
+int       mins2Date(int year, int month, int day, int hour, int mins);
+bool      parseTZ(int index, int currYear, bool doparseDST = true);
+int       timeIsDST(int index, int year, int month, int day, int hour, int mins, int& currTimeMins);
+void      UTCtoLocal(DateTime &dtu, DateTime& dtl, int index);
+void      updateAllTimes(const DateTime& dtu);
+void      LocalToUTC(int& ny, int& nm, int& nd, int& nh, int& nmm, int index);
+
+// WC mode, for updateAllTimes()
+#define WCF_Trigger 0x01
+static uint32_t wcf = 0;
+static int      wcLastMin = -1;
+static bool     wcMode = false;
+static DateTime gdtl;
+static int      wcUpdates = 0;
+
+static bool isWcMode() { return wcMode; }
+static void setDatesTimesWCInt(const DateTime& dtu, int32_t *utcDayNum);
@@ -11,18 +11,71 @@
 
 #include "tc_global.h"
 #include "AudioFileSourceLoop.h"
+#include "tc_prof.h"
+#include <esp_heap_caps.h>
+#include <atomic>
+
+#define RA_SECTOR     512
+#define RA_BUFSIZE    2048      // Per buffer; multiple of RA_SECTOR
+#define RA_BUFSIZE_PS 16384     // same, in PSRAM
+#define RA_MAX_SRCS   4
+#define RA_NOWRAP     0xffffffff
+#define RA_TASK_STACK 4096
+
+struct LoopReadAhead {
+    uint8_t  *buf[2];
+    uint32_t size;
+    uint32_t len[2];            // valid bytes
+    uint32_t fpos[2];           // file position of first byte
+    uint32_t wrap[2];           // offset where data from startPos first begins
+    uint32_t period[2];         // loop length; further wraps follow every period bytes
+    bool     last[2];           // buffer ends at end of file
+    std::atomic<bool> full[2];  // written by reader, cleared by consumer
+    int      cur;               // consumer: buffer being read
+    uint32_t off;               //           read offset in it
+    uint32_t lpos;              //           logical file position
+    bool     primed;            //           first buffer read
+    bool     done;              //           end of file reached
+    uint32_t skip;              // after seek: bytes to skip in first buffer
+    int      fillIdx;           // reader: buffer to fill next
+    bool     eof;               //         no more to fill
+};
+
+static struct {
+    uint32_t fills, fillTotal, fillMax;     // refill latency (us)
+    uint32_t starved, starvedTotal;         // decoder had to wait (us)
+    uint32_t lvlCount, lvlSum, lvlMin;      // fill level at read (%)
+} raStats = { 0, 0, 0, 0, 0, 0, 0, 100 };
+
+static int32_t  *tccToc = NULL;     // TOC of segment file
+static uint32_t tccTocLen = 0, tccSize = 0;
+static time_t   tccTime = 0;
+
+static TaskHandle_t        raTask = NULL;
+static SemaphoreHandle_t   raMutex = NULL;
+static AudioFileSourceLoop *raSrcs[RA_MAX_SRCS] = { NULL };
 
 AudioFileSourceLoop::~AudioFileSourceLoop()
 {
+    raEnd();
+    if(raMutex) {
+        xSemaphoreTake(raMutex, portMAX_DELAY);
+        for(int i = 0; i < RA_MAX_SRCS; i++) {
+            if(raSrcs[i] == this) raSrcs[i] = NULL;
+        }
+        xSemaphoreGive(raMutex);
+    }
     if(f) f.close();
 }
 
 uint32_t AudioFileSourceLoop::read(void *data, uint32_t len)
 {
     uint32_t glen = 0, rlen = len, g;
+    PROF_SCOPE(PROF_FREAD);
     
     switch(ftype) {
     case 1:
+        if(ra) return raRead((uint8_t *)data, len);
         glen = f.read((uint8_t *)data, len);
         if(!doPlayLoop || glen == len) return glen;
         seek(startPos, SEEK_SET);
@@ -49,6 +102,11 @@ uint32_t AudioFileSourceLoop::read(void *data, uint32_t len)
 bool AudioFileSourceLoop::seek(int32_t pos, int dir)
 {
     if(!f) return false;
+    if(ra) {
+        if(dir == SEEK_CUR)      pos += raPos();
+        else if(dir == SEEK_END) pos += f.size();
+        return raSeek(pos);
+    }
     if(dir == SEEK_SET)      return f.seek(pos);
     else if(dir == SEEK_CUR) return f.seek(f.position() + pos);
     else if(dir == SEEK_END) return f.seek(f.size() + pos);
@@ -57,7 +115,7 @@ bool AudioFileSourceLoop::seek(int32_t pos, int dir)
 
 bool AudioFileSourceLoop::open_c(const char *filename, const int16_t *segs)
 {
-    uint32_t temp[3];
+    uint32_t tlen;
     int32_t *ftoc;
     int gsi = *segs;
     int si = 0;
@@ -68,21 +126,17 @@ bool AudioFileSourceLoop::open_c(const char *filename, const int16_t *segs)
     
     if((toc = (int32_t *)malloc(segIdx * 4))) {
         if(open(filename)) {
-            if(read((uint8_t *)&temp[0], 12) == 12) {
-                int16_t hsegi = (temp[2] >> 2) - 2;
-                if((ftoc = (int32_t *)malloc(temp[2]))) {
-                    if(read((uint8_t *)ftoc, temp[2]) == temp[2]) {
-                        while(gsi) {
-                            if(segs[gsi] > hsegi) break;
-                            toc[si++] = ftoc[segs[gsi]] - ftoc[segs[gsi] + 1];
-                            toc[si++] = ~ftoc[segs[gsi--]];
-                        }
-                        if(!gsi) {
-                            free(ftoc);
-                            ftype = 2;
-                            if(seekNext()) return true;
-                        }
-                    }
+            raEnd();
+            if((ftoc = loadTOC(&tlen))) {
+                int16_t hsegi = (tlen >> 2) - 2;
+                while(gsi) {
+                    if(segs[gsi] > hsegi) break;
+                    toc[si++] = ftoc[segs[gsi]] - ftoc[segs[gsi] + 1];
+                    toc[si++] = ~ftoc[segs[gsi--]];
+                }
+                if(!gsi) {
+                    ftype = 2;
+                    if(seekNext()) return true;
                 }
             }
             close();
@@ -92,6 +146,48 @@ bool AudioFileSourceLoop::open_c(const char *filename, const int16_t *segs)
     return false;
 }
 
+// The segment file's TOC is read once and kept; as long as the
+// file's size and date are unchanged, a segment play only needs
+// to seek to the segment.
+int32_t *AudioFileSourceLoop::loadTOC(uint32_t *tlen)
+{
+    uint32_t temp[3];
+    uint32_t fsize = f.size();
+    time_t   ftime = f.getLastWrite();
+
+    if(tccToc && fsize == tccSize && ftime == tccTime) {
+        *tlen = tccTocLen;
+        return tccToc;
+    }
+
+    flushTOC();
+
+    if(read((uint8_t *)&temp[0], 12) != 12 || temp[2] > fsize)
+        return NULL;
+
+    if(!(tccToc = (int32_t *)malloc(temp[2])))
+        return NULL;
+
+    if(read((uint8_t *)tccToc, temp[2]) != temp[2]) {
+        flushTOC();
+        return NULL;
+    }
+
+    tccTocLen = *tlen = temp[2];
+    tccSize = fsize;
+    tccTime = ftime;
+
+    return tccToc;
+}
+
+void AudioFileSourceLoop::flushTOC()
+{
+    if(tccToc) free(tccToc);
+    tccToc = NULL;
+    tccTocLen = tccSize = 0;
+    tccTime = 0;
+}
+
 bool AudioFileSourceLoop::seekNext()
 {
     if(!segIdx || !toc) {
@@ -111,6 +207,317 @@ uint32_t AudioFileSourceLoop::c_read(uint8_t *buf, uint32_t len)
     return (*c)(buf, f.read(buf, len), maxSegs);
 }
 
+void AudioFileSourceLoop::setStartPos(int32_t newStartPos)
+{
+    if(!ra) {
+        startPos = newStartPos;
+        return;
+    }
+
+    // The reader wraps around on its own
+    xSemaphoreTake(raMutex, portMAX_DELAY);
+    startPos = newStartPos;
+    xSemaphoreGive(raMutex);
+}
+
+void AudioFileSourceLoop::setPlayLoop(bool playLoop)
+{
+    if(!ra) {
+        doPlayLoop = playLoop;
+        return;
+    }
+
+    xSemaphoreTake(raMutex, portMAX_DELAY);
+    doPlayLoop = playLoop;
+    if(!playLoop && ra->primed) {
+        // Loop switched off while playing: If the reader already
+        // wrapped around, cut off what was read beyond the end
+        int i = ra->cur;
+        for(int k = 0; k < 2; k++, i ^= 1) {
+            uint32_t w = ra->wrap[i], from = k ? 0 : ra->off;
+            if(!ra->full[i].load(std::memory_order_acquire)) break;
+            if(w == RA_NOWRAP) continue;
+            if(w < from && ra->period[i]) {
+                w += ((from - w + ra->period[i] - 1) / ra->period[i]) * ra->period[i];
+            }
+            if(w >= from && w <= ra->len[i]) {
+                ra->len[i] = w;
+                ra->last[i] = ra->eof = true;
+                if(!k) ra->full[i ^ 1].store(false, std::memory_order_release);
+                break;
+            }
+        }
+    } else if(playLoop && ra->eof && !ra->done) {
+        // Switched on after the reader hit the end
+        ra->last[0] = ra->last[1] = ra->eof = false;
+    }
+    xSemaphoreGive(raMutex);
+}
+
+/*
+ * Read-ahead
+ * 
+ * The consumer (audio task) reads from one buffer while the 
+ * reader task fills the other. Only the first buffer after 
+ * open/seek is read by the consumer itself. All file access
+ * except the (sequential) reads happens under raMutex. There is
+ * one raMutex for all sources; they share the card and raStats.
+ *
+ * loop() uses the card at the same time (settings, music folder
+ * index, renamer, uploads). FatFs serializes every call per volume
+ * (FF_FS_REENTRANT in ESP-IDF), but does not keep a file from being
+ * removed or renamed while another task has it open. Hence loop()
+ * has the audio task close its files (stopAudio(true)) before it
+ * removes or renames sound files.
+ */
+
+bool AudioFileSourceLoop::startReader(UBaseType_t prio, BaseType_t core)
+{
+    if(!raMutex && !(raMutex = xSemaphoreCreateMutex())) return false;
+
+    if(!raTask) {
+        xTaskCreatePinnedToCore(readerTask, "sdread", RA_TASK_STACK, NULL, prio, &raTask, core);
+    }
+    return !!raTask;
+}
+
+void AudioFileSourceLoop::readerTask(void *param)
+{
+    bool more;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        do {
+            more = false;
+            for(int i = 0; i < RA_MAX_SRCS; i++) {
+                xSemaphoreTake(raMutex, portMAX_DELAY);
+                if(raSrcs[i] && raSrcs[i]->raFill()) more = true;
+                xSemaphoreGive(raMutex);
+            }
+        } while(more);
+    }
+}
+
+// Set up read-ahead for a freshly opened file; if this fails,
+// we read directly
+bool AudioFileSourceLoop::raBegin()
+{
+    int      slot = -1;
+    uint32_t size = RA_BUFSIZE;
+    uint8_t  *b = NULL;
+
+    if(!raTask) return false;
+
+    for(int i = 0; i < RA_MAX_SRCS; i++) {
+        if(raSrcs[i] == this) { slot = i; break; }
+        if(!raSrcs[i] && slot < 0) slot = i;
+    }
+    if(slot < 0) return false;
+
+    if(psramFound()) {
+        size = RA_BUFSIZE_PS;
+        b = (uint8_t *)heap_caps_malloc(2 * size, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+    }
+    if(!b) {
+        size = RA_BUFSIZE;
+        if(!(b = (uint8_t *)malloc(2 * size))) return false;
+    }
+
+    LoopReadAhead *r = new LoopReadAhead;
+    r->buf[0] = b;
+    r->buf[1] = b + size;
+    r->size = size;
+    r->full[0].store(false);
+    r->full[1].store(false);
+    r->cur = r->fillIdx = 0;
+    r->off = r->lpos = r->skip = 0;
+    r->primed = r->done = r->eof = false;
+
+    xSemaphoreTake(raMutex, portMAX_DELAY);
+    ra = r;
+    raSrcs[slot] = this;
+    xSemaphoreGive(raMutex);
+
+    return true;
+}
+
+void AudioFileSourceLoop::raEnd()
+{
+    LoopReadAhead *r = ra;
+
+    if(!r) return;
+
+    xSemaphoreTake(raMutex, portMAX_DELAY);
+    ra = NULL;
+    xSemaphoreGive(raMutex);
+
+    free(r->buf[0]);
+    delete r;
+}
+
+// Reader task: Fill the next buffer, if it is free.
+// Called with raMutex held.
+bool AudioFileSourceLoop::raFill()
+{
+    bool did = false;
+
+    if(ra && ra->primed && !ra->eof && !ra->full[ra->fillIdx].load(std::memory_order_acquire)) {
+        raFillBuf(ra->fillIdx);
+        did = true;
+    }
+
+    return did;
+}
+
+// Called with raMutex held. Reads are sized so that the
+// next one starts on a sector boundary.
+void AudioFileSourceLoop::raFillBuf(int i)
+{
+    LoopReadAhead *r = ra;
+    uint8_t  *b = r->buf[i];
+    uint32_t n = 0, g, lw = RA_NOWRAP, us = micros();
+    uint32_t want = r->size - (f.position() & (RA_SECTOR - 1));
+
+    r->fpos[i] = f.position();
+    r->wrap[i] = RA_NOWRAP;
+    r->last[i] = false;
+
+    while(n < want) {
+        g = f.read(b + n, want - n);
+        n += g;
+        if(n < want) {
+            if(!doPlayLoop || (!g && lw == n)) {
+                r->last[i] = r->eof = true;
+                break;
+            }
+            if(r->wrap[i] == RA_NOWRAP) r->wrap[i] = n;
+            r->period[i] = f.size() - startPos;
+            lw = n;
+            f.seek(startPos);
+        }
+    }
+
+    r->len[i] = n;
+    r->fillIdx = i ^ 1;
+    r->full[i].store(true, std::memory_order_release);
+
+    us = micros() - us;
+    raStats.fills++;
+    raStats.fillTotal += us;
+    if(us > raStats.fillMax) raStats.fillMax = us;
+}
+
+uint32_t AudioFileSourceLoop::raRead(uint8_t *data, uint32_t len)
+{
+    LoopReadAhead *r = ra;
+    uint32_t glen = 0, n, lvl;
+    int      i;
+
+    while(glen < len && !r->done) {
+
+        i = r->cur;
+
+        if(!r->full[i].load(std::memory_order_acquire)) {
+            if(!r->primed) {
+                xSemaphoreTake(raMutex, portMAX_DELAY);
+                raFillBuf(i);
+                r->off = r->skip;
+                r->primed = true;
+                xSemaphoreGive(raMutex);
+                xTaskNotifyGive(raTask);
+            } else {
+                uint32_t us = micros();
+                raStats.starved++;
+                while(!r->full[i].load(std::memory_order_acquire)) {
+                    vTaskDelay(1);
+                }
+                raStats.starvedTotal += micros() - us;
+            }
+        }
+
+        if(r->off < r->len[i]) {
+            n = r->len[i] - r->off;
+            if(n > len - glen) n = len - glen;
+            memcpy(data + glen, r->buf[i] + r->off, n);
+            if(r->off + n > r->wrap[i]) {
+                r->lpos = startPos + (r->period[i] ? (r->off + n - r->wrap[i]) % r->period[i] : 0);
+            } else {
+                r->lpos += n;
+            }
+            r->off += n;
+            glen += n;
+        }
+
+        if(r->off >= r->len[i]) {
+            if(r->last[i]) r->done = true;
+            r->off = 0;
+            r->cur = i ^ 1;
+            r->full[i].store(false, std::memory_order_release);
+            xTaskNotifyGive(raTask);
+        }
+    }
+
+    // Buffered ahead, relative to what we can buffer
+    i = r->cur;
+    lvl = r->full[i].load(std::memory_order_acquire) ? r->len[i] - r->off : 0;
+    if(r->full[i ^ 1].load(std::memory_order_acquire)) lvl += r->len[i ^ 1];
+    lvl = lvl * 100 / (2 * r->size);
+    if(!r->done) {
+        raStats.lvlCount++;
+        raStats.lvlSum += lvl;
+        if(lvl < raStats.lvlMin) raStats.lvlMin = lvl;
+    }
+
+    return glen;
+}
+
+bool AudioFileSourceLoop::raSeek(uint32_t pos)
+{
+    LoopReadAhead *r = ra;
+    int  i = r->cur;
+    bool ret;
+
+    // Within what we have (ID3 skip, wav header)
+    if(r->primed && r->full[i].load(std::memory_order_acquire) && r->wrap[i] == RA_NOWRAP &&
+       pos >= r->fpos[i] && pos < r->fpos[i] + r->len[i]) {
+        r->off = pos - r->fpos[i];
+        r->lpos = pos;
+        r->done = false;
+        return true;
+    }
+
+    xSemaphoreTake(raMutex, portMAX_DELAY);
+    r->full[0].store(false);
+    r->full[1].store(false);
+    r->cur = r->fillIdx = 0;
+    r->off = 0;
+    r->primed = r->done = r->eof = false;
+    if((ret = f.seek(pos & ~(RA_SECTOR - 1)))) {
+        r->skip = pos & (RA_SECTOR - 1);
+        r->lpos = pos;
+    }
+    xSemaphoreGive(raMutex);
+
+    return ret;
+}
+
+uint32_t AudioFileSourceLoop::raPos()
+{
+    return ra->lpos;
+}
+
+int AudioFileSourceLoop::raReport(char *buf, int bufLen)
+{
+    int l = snprintf(buf, bufLen, 
+            "SD read-ahead: %u refills, avg %uus, max %uus; %u starved, %uus waited; fill avg %u%%, min %u%%\n",
+            raStats.fills, raStats.fills ? raStats.fillTotal / raStats.fills : 0, raStats.fillMax,
+            raStats.starved, raStats.starvedTotal,
+            raStats.lvlCount ? raStats.lvlSum / raStats.lvlCount : 0, 
+            raStats.lvlCount ? raStats.lvlMin : 0);
+
+    return (l < 0 || l >= bufLen) ? bufLen - 1 : l;
+}
+
 // SD -----------------------------------------------
 
 AudioFileSourceSDLoop::AudioFileSourceSDLoop()
@@ -126,8 +533,14 @@ AudioFileSourceSDLoop::AudioFileSourceSDLoop(const char *filename)
 
 bool AudioFileSourceSDLoop::open(const char *filename)
 {
+    raEnd();
     f = SD.open(filename, FILE_READ);
     ftype = 1;
+    // No looping until the caller says so; the reader might
+    // otherwise wrap around using the previous file's settings
+    doPlayLoop = false;
+    startPos = 0;
+    if(f) raBegin();
     return f;
 }
 
@@ -7,6 +7,9 @@
  *
  * Based on AudioFileSourceSD by Earle F. Philhower, III
  *
+ * SD files are read ahead into two buffers by a reader task
+ * (if started), so that a slow card does not starve the decoder.
+ * Loop wrap-around is done by the reader, too.
  */
 
 #ifndef _AudioFileSourceLoop_H
@@ -16,6 +19,8 @@
 #include "src/SD/SD.h"
 #include <LittleFS.h>
 
+struct LoopReadAhead;
+
 class AudioFileSourceLoop : public AudioFileSource
 {
   public:
@@ -26,15 +31,22 @@ class AudioFileSourceLoop : public AudioFileSource
     bool open_c(const char *filename, const int16_t *segs);
     uint32_t read(void *data, uint32_t len) override;
     bool seek(int32_t pos, int dir) override;
-    bool close() override                    { if(toc) { free(toc); toc = NULL; } f.close(); return true; }
+    bool close() override                    { raEnd(); if(toc) { free(toc); toc = NULL; } f.close(); return true; }
     bool isOpen() override                   { return f ? true : false; }
     uint32_t getSize() override              { return f ? f.size() : 0; }
-    uint32_t getPos() override               { return f ? ((ftype == 2) ? (csegOLen - csegLen) : f.position()) : 0; }
-    void setStartPos(int32_t newStartPos)    { startPos = newStartPos; }
-    void setPlayLoop(bool playLoop)          { doPlayLoop = playLoop; }
+    uint32_t getPos() override               { return f ? ((ftype == 2) ? (csegOLen - csegLen) : (ra ? raPos() : f.position())) : 0; }
+    void setStartPos(int32_t newStartPos);   // before setPlayLoop(true)
+    void setPlayLoop(bool playLoop);
     uint32_t (*c)(uint8_t *, uint32_t, uint32_t) = NULL;
 
+    static void flushTOC();
+    static bool startReader(UBaseType_t prio, BaseType_t core);
+    static int  raReport(char *buf, int bufLen);
+
   protected:
+    bool    raBegin();
+    void    raEnd();
+
     File    f;
     int32_t startPos = 0;
     bool    doPlayLoop = false;
@@ -42,12 +54,22 @@ class AudioFileSourceLoop : public AudioFileSource
     
   private:
     bool     seekNext();
+    int32_t  *loadTOC(uint32_t *tlen);
     uint32_t c_read(uint8_t *buf, uint32_t len);
 
+    static void readerTask(void *param);
+    bool     raFill();
+    void     raFillBuf(int i);
+    uint32_t raRead(uint8_t *data, uint32_t len);
+    bool     raSeek(uint32_t pos);
+    uint32_t raPos();
+
     int32_t        *toc = NULL;
     int            segIdx = 0;
     uint32_t       csegLen = 0, csegOLen = 0;
     uint32_t       maxSegs = 0;
+
+    LoopReadAhead     *ra = NULL;
 };
 
 class AudioFileSourceSDLoop : public AudioFileSourceLoop
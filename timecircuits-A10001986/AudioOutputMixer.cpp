@@ -0,0 +1,352 @@
+/*
+ * AudioOutputMixer
+ * Mix several voices (each fed by its own AudioGenerator) into
+ * one AudioOutput
+ *
+ * Thomas Winischhofer (A10001986), 2026
+ *
+ * Inspired by AudioOutputMixer by Earle F. Philhower, III
+ *
+ */
+
+#include "AudioOutputMixer.h"
+
+#define MIX_RING_MASK   (MIX_RING_SIZE - 1)
+#define MIX_STEP_ONE    0x10000
+#define MIX_DUCK_STEP   (MIX_GAIN_ONE / 16)     // Ramp over 16 blocks (~23ms)
+
+/*
+ * Voice
+ */
+
+bool AudioOutputMixerVoice::SetRate(int hz)
+{
+    hertz = hz;
+    mix->voiceRate(this);
+    return true;
+}
+
+bool AudioOutputMixerVoice::SetChannels(int chan)
+{
+    channels = chan;
+    return true;
+}
+
+bool AudioOutputMixerVoice::SetGain(float f1, int mutechnls)
+{
+    int32_t g = (int32_t)(f1 * MIX_GAIN_ONE);
+
+    if(!mutechnls)         { gainL = gainR = g; }
+    else if(mutechnls > 0) { gainR = g; gainL = 0; }
+    else                   { gainL = g; gainR = 0; }
+
+    return true;
+}
+
+bool AudioOutputMixerVoice::begin()
+{
+    active = true;
+    return mix->voiceBegin(this);
+}
+
+size_t AudioOutputMixerVoice::ConsumeSample(int16_t sL, int16_t sR)
+{
+    if(head - tail >= MIX_RING_SIZE)
+        return 0;
+
+    if(channels == 1) sR = sL;
+    ring[head++ & MIX_RING_MASK] = ((uint32_t)(uint16_t)sR << 16) | (uint16_t)sL;
+
+    return sizeof(uint32_t);
+}
+
+uint16_t AudioOutputMixerVoice::ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count)
+{
+    uint32_t space = MIX_RING_SIZE - (head - tail);
+
+    if(count > space) count = space;
+
+    if(channels == 1) sR = sL;
+
+    for(int i = 0; i < count; i++, sL += stride, sR += stride) {
+        ring[head++ & MIX_RING_MASK] = ((uint32_t)(uint16_t)*sR << 16) | (uint16_t)*sL;
+    }
+
+    return count;
+}
+
+bool AudioOutputMixerVoice::stop()
+{
+    active = false;
+    return true;
+}
+
+void AudioOutputMixerVoice::flush()
+{
+    head = tail = phase = 0;
+    active = false;
+    mix->voiceIdle();
+}
+
+// Number of output frames we can deliver at the given step
+uint16_t AudioOutputMixerVoice::outFrames(uint32_t step)
+{
+    uint32_t avail = head - tail;
+
+    if(step == MIX_STEP_ONE && !phase) {
+        return (avail > MIX_BLOCK) ? MIX_BLOCK : avail;
+    }
+
+    // Interpolation needs the following frame as well; unless the
+    // sound has ended, in which case the last one is repeated.
+    if(active) {
+        if(!avail) return 0;
+        avail--;
+    }
+
+    avail <<= 16;
+    if(avail <= phase) return 0;
+
+    avail = (avail - phase + step - 1) / step;
+
+    return (avail > MIX_BLOCK) ? MIX_BLOCK : avail;
+}
+
+// Add up to n frames to accL/accR, resampled by step, with gain
+uint16_t AudioOutputMixerVoice::pull(int32_t *accL, int32_t *accR, uint16_t n, uint32_t step, int32_t gL, int32_t gR)
+{
+    uint16_t m = outFrames(step);
+    uint32_t f;
+
+    if(m > n) m = n;
+
+    if(step == MIX_STEP_ONE && !phase) {
+
+        for(int i = 0; i < m; i++) {
+            f = ring[(tail + i) & MIX_RING_MASK];
+            accL[i] += ((int16_t)f * gL) >> 12;
+            accR[i] += ((int16_t)(f >> 16) * gR) >> 12;
+        }
+        tail += m;
+
+    } else {
+
+        uint32_t avail = head - tail;
+
+        for(int i = 0; i < m; i++) {
+            uint32_t idx = phase >> 16;
+            int32_t  fr = (phase & 0xffff) >> 1;
+            uint32_t a = ring[(tail + idx) & MIX_RING_MASK];
+            uint32_t b = (idx + 1 < avail) ? ring[(tail + idx + 1) & MIX_RING_MASK] : a;
+            int32_t  l = (int16_t)a;
+            int32_t  r = (int16_t)(a >> 16);
+            l += (((int16_t)b - l) * fr) >> 15;
+            r += (((int16_t)(b >> 16) - r) * fr) >> 15;
+            accL[i] += (l * gL) >> 12;
+            accR[i] += (r * gR) >> 12;
+            phase += step;
+        }
+        if((phase >> 16) > avail) phase = avail << 16;
+        tail += phase >> 16;
+        phase &= 0xffff;
+
+    }
+
+    return m;
+}
+
+/*
+ * Mixer
+ */
+
+AudioOutputMixer::AudioOutputMixer(AudioOutput *dest)
+{
+    out = dest;
+    for(int i = 0; i < MIX_MAX_VOICES; i++) {
+        voice[i] = new AudioOutputMixerVoice(this);
+    }
+}
+
+void AudioOutputMixer::SetDuck(float level)
+{
+    duckLevel = (int32_t)(level * MIX_GAIN_ONE);
+}
+
+// Keep the output running from now on; dmaFrames is how much silence
+// to feed after the last sound so that the output's DMA buffers only
+// hold zeros (which the I2S DMA then repeats)
+bool AudioOutputMixer::SetPersistent(uint16_t dmaFrames)
+{
+    keepFrames = dmaFrames;
+
+    if(!outOn) {
+        out->SetRate(rate);
+        out->SetBitsPerSample(16);
+        out->SetChannels(2);
+        if(!out->begin()) return false;
+        outOn = true;
+    }
+
+    return true;
+}
+
+bool AudioOutputMixer::othersActive(AudioOutputMixerVoice *v)
+{
+    for(int i = 0; i < MIX_MAX_VOICES; i++) {
+        if(voice[i] != v && voice[i]->isActive()) return true;
+    }
+    return false;
+}
+
+bool AudioOutputMixer::isBusy()
+{
+    return (outPtr < outLen) || zeroLeft || othersActive(NULL);
+}
+
+// The first voice to play determines the output rate;
+// all others are resampled. A persistent output is only
+// reconfigured if that avoids downsampling.
+void AudioOutputMixer::voiceRate(AudioOutputMixerVoice *v)
+{
+    if(v->hertz == rate || othersActive(v))
+        return;
+
+    if(keepFrames && outOn && v->hertz < rate)
+        return;
+
+    rate = v->hertz;
+    if(outOn) out->SetRate(rate);
+}
+
+bool AudioOutputMixer::voiceBegin(AudioOutputMixerVoice *v)
+{
+    voiceRate(v);
+
+    if(!outOn) {
+        out->SetRate(rate);
+        out->SetBitsPerSample(16);
+        out->SetChannels(2);
+        if(!out->begin()) return false;
+        outOn = true;
+    }
+
+    return true;
+}
+
+// A voice was flushed; if nothing else plays, drop what we have
+// and stop the output (which clears the DMA buffers), or just
+// silence it if persistent
+void AudioOutputMixer::voiceIdle()
+{
+    if(othersActive(NULL))
+        return;
+
+    outPtr = outLen = 0;
+    zeroLeft = 0;
+    if(outOn) {
+        if(keepFrames) {
+            out->silence();
+        } else {
+            out->stop();
+            outOn = false;
+        }
+    }
+}
+
+void AudioOutputMixer::stop()
+{
+    for(int i = 0; i < MIX_MAX_VOICES; i++) {
+        voice[i]->flush();
+    }
+}
+
+uint16_t AudioOutputMixer::mixBlock()
+{
+    int32_t  accL[MIX_BLOCK], accR[MIX_BLOCK];
+    uint32_t step[MIX_MAX_VOICES];
+    uint16_t nFed = MIX_BLOCK, nDrain = 0, n, k;
+    bool     haveFed = false, others = false;
+    int32_t  target;
+
+    for(int i = 0; i < MIX_MAX_VOICES; i++) {
+        AudioOutputMixerVoice *v = voice[i];
+        step[i] = 0;
+        if(!v->isActive()) continue;
+        step[i] = (v->hertz == rate) ? MIX_STEP_ONE : (uint32_t)(((uint64_t)v->hertz << 16) / rate);
+        k = v->outFrames(step[i]);
+        if(v->active) {
+            // Voice still being fed: Wait for it
+            if(k < nFed) nFed = k;
+            haveFed = true;
+        } else if(k > nDrain) {
+            nDrain = k;
+        }
+        if(i) others = true;
+    }
+
+    if(!(n = haveFed ? nFed : nDrain))
+        return 0;
+
+    // Duck voice 0 while others play; ramp to avoid clicks
+    target = others ? duckLevel : MIX_GAIN_ONE;
+    if(duck < target) {
+        duck += MIX_DUCK_STEP;
+        if(duck > target) duck = target;
+    } else if(duck > target) {
+        duck -= MIX_DUCK_STEP;
+        if(duck < target) duck = target;
+    }
+
+    memset((void *)accL, 0, n * sizeof(int32_t));
+    memset((void *)accR, 0, n * sizeof(int32_t));
+
+    for(int i = 0; i < MIX_MAX_VOICES; i++) {
+        AudioOutputMixerVoice *v = voice[i];
+        int32_t gL = v->gainL, gR = v->gainR;
+        if(!step[i]) continue;
+        if(!i) {
+            gL = (gL * duck) >> 12;
+            gR = (gR * duck) >> 12;
+        }
+        v->pull(accL, accR, n, step[i], gL, gR);
+    }
+
+    for(int i = 0; i < n; i++) {
+        outL[i] = (accL[i] > 32767) ? 32767 : ((accL[i] < -32768) ? -32768 : accL[i]);
+        outR[i] = (accR[i] > 32767) ? 32767 : ((accR[i] < -32768) ? -32768 : accR[i]);
+    }
+
+    return n;
+}
+
+bool AudioOutputMixer::loop()
+{
+    for(;;) {
+        if(outPtr < outLen) {
+            outPtr += out->ConsumeSamples(&outL[outPtr], &outR[outPtr], 1, outLen - outPtr);
+            if(outPtr < outLen) return true;    // Output full
+        }
+        outPtr = outLen = 0;
+        if(!(outLen = mixBlock())) break;
+        zeroLeft = keepFrames;
+    }
+
+    if(!outOn || othersActive(NULL))
+        return false;
+
+    // Everything played out: Stop output, or push silence
+    // through it until its buffers hold nothing else
+    if(!keepFrames) {
+        out->stop();
+        outOn = false;
+    } else if(zeroLeft) {
+        memset((void *)outL, 0, sizeof(outL));
+        while(zeroLeft) {
+            uint16_t n = out->ConsumeSamples(outL, outL, 1, (zeroLeft > MIX_BLOCK) ? MIX_BLOCK : zeroLeft);
+            zeroLeft -= n;
+            if(!n) return true;     // Output full
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,102 @@
+/*
+ * AudioOutputMixer
+ * Mix several voices (each fed by its own AudioGenerator) into
+ * one AudioOutput
+ *
+ * Thomas Winischhofer (A10001986), 2026
+ *
+ * Inspired by AudioOutputMixer by Earle F. Philhower, III
+ *
+ * Every voice buffers its samples at its own sample rate; the mixer
+ * resamples (linear interpolation) to the rate of the output, which
+ * is the rate of whatever voice started first. Voice 0 is ducked
+ * while any other voice is playing.
+ *
+ * The output is stopped when everything has played out, unless it is
+ * persistent: Then it is fed silence when idle, and only switched to
+ * a higher rate; lower rates are resampled.
+ *
+ * Not thread-safe; mixer, voices and generators must all be run
+ * from the same task.
+ */
+
+#ifndef _AudioOutputMixer_H
+#define _AudioOutputMixer_H
+
+#include "src/ESP8266Audio/AudioOutput.h"
+
+#define MIX_MAX_VOICES  2
+#define MIX_RING_SIZE   512     // Frames buffered per voice; power of 2
+#define MIX_BLOCK       64      // Frames mixed per pass
+#define MIX_GAIN_ONE    4096    // Gains are fixed point 4.12
+
+class AudioOutputMixer;
+
+class AudioOutputMixerVoice : public AudioOutput
+{
+  public:
+    AudioOutputMixerVoice(AudioOutputMixer *mixer) { mix = mixer; hertz = 44100; channels = 2; }
+
+    bool SetRate(int hz) override;
+    bool SetChannels(int chan) override;
+    bool SetGain(float f1, int mutechnls = 0) override;
+    bool begin() override;
+    size_t ConsumeSample(int16_t sL, int16_t sR) override;
+    uint16_t ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count) override;
+    bool stop() override;           // End of sound: Play out what is buffered
+    void flush() override;          // Drop what is buffered
+
+    bool isActive()                 { return active || (head != tail); }
+
+  private:
+    friend class AudioOutputMixer;
+
+    uint16_t outFrames(uint32_t step);
+    uint16_t pull(int32_t *accL, int32_t *accR, uint16_t n, uint32_t step, int32_t gL, int32_t gR);
+
+    AudioOutputMixer *mix;
+    uint32_t ring[MIX_RING_SIZE];   // (R << 16) | L
+    uint32_t head = 0;              // free running
+    uint32_t tail = 0;
+    uint32_t phase = 0;             // fractional read position, 16.16
+    int32_t  gainL = MIX_GAIN_ONE;
+    int32_t  gainR = MIX_GAIN_ONE;
+    bool     active = false;
+};
+
+class AudioOutputMixer
+{
+  public:
+    AudioOutputMixer(AudioOutput *dest);
+
+    AudioOutputMixerVoice *getVoice(int idx) { return voice[idx]; }
+    void SetDuck(float level);      // Gain of voice 0 while others play
+    bool SetPersistent(uint16_t dmaFrames); // Start output, keep it running
+    bool loop();                    // Returns true if output is full
+    bool isBusy();
+    void stop();                    // Drop everything, stop output
+
+  private:
+    friend class AudioOutputMixerVoice;
+
+    void voiceRate(AudioOutputMixerVoice *v);
+    bool voiceBegin(AudioOutputMixerVoice *v);
+    void voiceIdle();
+    bool othersActive(AudioOutputMixerVoice *v);
+    uint16_t mixBlock();
+
+    AudioOutput *out;
+    AudioOutputMixerVoice *voice[MIX_MAX_VOICES];
+    int16_t  outL[MIX_BLOCK];
+    int16_t  outR[MIX_BLOCK];
+    uint16_t outPtr = 0;
+    uint16_t outLen = 0;
+    uint16_t keepFrames = 0;        // persistent: frames the output buffers
+    uint16_t zeroLeft = 0;          // silence still to feed
+    int      rate = 44100;
+    int32_t  duck = MIX_GAIN_ONE;
+    int32_t  duckLevel = MIX_GAIN_ONE / 3;
+    bool     outOn = false;
+};
+
+#endif
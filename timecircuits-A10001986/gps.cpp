@@ -61,6 +61,7 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include "gps.h"
+#include "tc_i2c.h"
 
 #define GPS_MPH_PER_KNOT  1.15077945f
 #define GPS_KMPH_PER_KNOT 1.852f
@@ -575,25 +576,21 @@ void tcGPS::requestVersion()
 
 void tcGPS::sendCommand(const char *prefix, const char *str)
 { 
-    Wire.beginTransmission(_address);
-    if(prefix) {
-        for(int i = 0; i < strlen(prefix); i++) {
-            Wire.write((uint8_t)prefix[i]);
-        }
-    }
-    for(int i = 0; i < strlen(str); i++) {
-        Wire.write((uint8_t)str[i]);
-    }
-    Wire.write(0x0d);
-    Wire.write(0x0a);
-    Wire.endTransmission(true);
+    uint8_t cmd[128];
+    int     len;
+
+    len = snprintf((char *)cmd, sizeof(cmd) - 2, "%s%s", prefix ? prefix : "", str);
+    if(len > (int)sizeof(cmd) - 3) len = sizeof(cmd) - 3;
+    cmd[len++] = 0x0d;
+    cmd[len++] = 0x0a;
+    i2c_xfer(I2CD_GPS, _address, cmd, len);
     (*_customDelayFunc)(30);
 }
 
 bool tcGPS::readAndParse(bool doDelay)
 {
     char   curr_char = 0;
-    size_t i2clen = 0;
+    int    i2clen = 0;
     int    buff_max = 0;
     int    buff_idx = 0;
     bool   haveParsedSome = false;
@@ -601,14 +598,14 @@ bool tcGPS::readAndParse(bool doDelay)
 
     switch(_type) {
     case GPST_MTK333X:
-        i2clen = Wire.requestFrom(_address, _lenArr[_lenIdx++]);
+        i2clen = i2c_xfer(I2CD_GPS, _address, NULL, 0, (uint8_t *)_buffer, _lenArr[_lenIdx++]);
         _lenIdx &= _lenLimit;
     
-        if(i2clen) {
+        if(i2clen > 0) {
     
-            // Read i2c data to _buffer
+            // Filter i2c data in _buffer
             for(int i = 0; i < i2clen; i++) {
-                curr_char = Wire.read();
+                curr_char = _buffer[i];
                 // Skip "empty data" (ie LF if not preceeded by CR)
                 if((curr_char != 0x0a) || (_last_char == 0x0d)) {
                      _buffer[buff_max++] = curr_char;
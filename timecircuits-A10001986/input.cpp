@@ -77,6 +77,7 @@
 
 #include "input.h"
 #include "tc_audio.h"
+#include "tc_i2c.h"
 
 #define OPEN    false
 #define CLOSED  true
@@ -89,6 +90,35 @@ static void defaultDelay(int iter, unsigned long mydelay)
     delay(mydelay);
 }
 
+#ifdef TC_PROFILER
+static struct {
+    uint32_t scans;
+    uint32_t xfers;         // I2C transactions for scanning
+    uint32_t wakeups;       // INT seen
+    uint32_t presses;
+    uint32_t latSum;        // us, activity seen until press reported
+    uint32_t latMax;
+    unsigned long since;
+} kpdStats;
+
+int kpd_report(char *buf, int bufLen)
+{
+    uint32_t secs = kpdStats.since ? (millis() - kpdStats.since) / 1000 : 0;
+    int l;
+
+    if(!secs) secs = 1;
+
+    l = snprintf(buf, bufLen, "Keypad: %u scans (%u/s), %u I2C xfers (%u/s), %u wakeups; %u presses, latency avg %u max %u us\n",
+              kpdStats.scans, kpdStats.scans / secs, kpdStats.xfers, kpdStats.xfers / secs, kpdStats.wakeups,
+              kpdStats.presses, kpdStats.presses ? kpdStats.latSum / kpdStats.presses : 0, kpdStats.latMax);
+
+    return (l < 0) ? 0 : ((l < bufLen) ? l : bufLen - 1);
+}
+#define KPD_COUNT(x, n) kpdStats.x += (n)
+#else
+#define KPD_COUNT(x, n)
+#endif
+
 /*
  * Keypad_i2c class
  */
@@ -122,8 +152,9 @@ Keypad_I2C::Keypad_I2C(char *userKeymap, const uint8_t *row, const uint8_t *col,
     _key.stateChanged = false;
 }
 
-// Initialize I2C
-void Keypad_I2C::begin(unsigned int scanInterval, unsigned int holdTime, void (*myDelay)(int, unsigned long))
+// Initialize I2C; if intPin is given, it must be connected to 
+// the PCF8574's INT output
+void Keypad_I2C::begin(unsigned int scanInterval, unsigned int holdTime, void (*myDelay)(int, unsigned long), int intPin)
 {
     _scanInterval = scanInterval;
     _holdTime = holdTime;
@@ -132,16 +163,28 @@ void Keypad_I2C::begin(unsigned int scanInterval, unsigned int holdTime, void (*
     port_write(0xff);
 
     // Read initial value for shadow output pin state
-    Wire.requestFrom(_i2caddr, (int)1);
-    _pinState = Wire.read();
+    i2c_xfer(I2CD_KEYPAD, _i2caddr, NULL, 0, &_pinState, 1);
 
     // Build rowMask for quick scanning
     _rowMask = 0;
     for(int i = 0; i < _rows; i++) {
         _rowMask |= (1 << _rowPins[i]);
     }
+    _colMask = 0;
+    for(int i = 0; i < _columns; i++) {
+        _colMask |= (1 << _columnPins[i]);
+    }
 
     _customDelayFunc = myDelay;
+
+    #ifdef TC_PROFILER
+    kpdStats.since = millis();
+    #endif
+
+    if((_intPin = intPin) >= 0) {
+        pinMode(_intPin, INPUT_PULLUP);
+        armInt();
+    }
 }
 
 // Scan keypad and update key state
@@ -149,9 +192,26 @@ bool Keypad_I2C::scanKeypad()
 {
     bool keyChanged = false;
 
-    if((millis() - _scanTime) > _scanInterval) {
-        keyChanged = scanKeys();
-        _scanTime = millis();
+    if(_idle) {
+        // INT is low until the port is read or written
+        if(digitalRead(_intPin) == HIGH)
+            return false;
+        _idle = false;
+        _wakeTime = micros();
+        KPD_COUNT(wakeups, 1);
+        port_write(_pinState | _colMask);
+        KPD_COUNT(xfers, 1);
+    } else if((millis() - _scanTime) <= _scanInterval) {
+        return false;
+    } else if(_intPin < 0 && _key.kState == TCKS_IDLE) {
+        _wakeTime = micros();
+    }
+
+    keyChanged = scanKeys();
+    _scanTime = millis();
+
+    if(_intPin >= 0 && _key.kState == TCKS_IDLE) {
+        armInt();
     }
 
     return keyChanged;
@@ -161,10 +221,31 @@ bool Keypad_I2C::scanKeypad()
  * Private
  */
 
+// Pull all columns low, so that any key press changes a row 
+// input and thereby triggers INT. Reading the port clears INT; 
+// if a row is low already, a key is down and we go on polling.
+void Keypad_I2C::armInt()
+{
+    uint8_t pins = 0xff;
+
+    port_write(_pinState & ~_colMask);
+    i2c_xfer(I2CD_KEYPAD, _i2caddr, NULL, 0, &pins, 1);
+    KPD_COUNT(xfers, 2);
+
+    if((pins & _rowMask) == _rowMask) {
+        _idle = true;
+    } else {
+        _wakeTime = micros();
+        port_write(_pinState | _colMask);
+        KPD_COUNT(xfers, 1);
+    }
+}
+
 // Hardware scan & update key state
 bool Keypad_I2C::scanKeys()
 {
     uint32_t pinVals[3][MAX_COLS], rb;
+    uint8_t  pins;
     int      repeat, haveKey;
     int      maxRetry = 5;
     int      c, r, d;
@@ -180,12 +261,14 @@ bool Keypad_I2C::scanKeys()
 
                 pin_write(_columnPins[c], LOW);
 
-                Wire.requestFrom(_i2caddr, (int)1);
-                if((pinVals[d][c] = Wire.read() & _rowMask) != _rowMask)
+                pins = 0xff;
+                i2c_xfer(I2CD_KEYPAD, _i2caddr, NULL, 0, &pins, 1);
+                if((pinVals[d][c] = pins & _rowMask) != _rowMask)
                     haveKey = c;
 
                 pin_write(_columnPins[c], HIGH);
 
+                KPD_COUNT(xfers, 3);
             }
 
             if(d < 2) (*_customDelayFunc)(d, 5);
@@ -200,6 +283,8 @@ bool Keypad_I2C::scanKeys()
 
     } while(repeat && maxRetry--);
 
+    KPD_COUNT(scans, 1);
+
     _key.stateChanged = false;
 
     // If we currently have an active key, advance its state
@@ -264,6 +349,16 @@ void Keypad_I2C::transitionTo(KeyState nextState)
     _key.kState = nextState;
     _key.stateChanged = true;
 
+    #ifdef TC_PROFILER
+    if(nextState == TCKS_PRESSED && _wakeTime) {
+        uint32_t lat = micros() - _wakeTime;
+        kpdStats.presses++;
+        kpdStats.latSum += lat;
+        if(lat > kpdStats.latMax) kpdStats.latMax = lat;
+        _wakeTime = 0;
+    }
+    #endif
+
     if(_keypadEventListener) {
         _keypadEventListener(_key.kChar, _key.kState);
     }
@@ -282,11 +377,10 @@ void Keypad_I2C::pin_write(uint8_t pinNum, bool level)
     port_write(_pinState);
 }
 
+// Queued; the next read comes after it
 void Keypad_I2C::port_write(uint8_t val)
 {
-    Wire.beginTransmission(_i2caddr);
-    Wire.write(val);
-    Wire.endTransmission();
+    i2c_write(I2CD_KEYPAD, _i2caddr, &val, 1);
     _pinState = val;
 }
 
@@ -783,28 +877,28 @@ bool TCRotEnc::zeroEnc(int offs)
 
 int TCRotEnc::read(uint16_t base, uint8_t reg, uint8_t *buf, uint8_t num)
 {
-    int i2clen;
+    uint8_t cmd[2];
+    int     l = 0, i2clen;
     
-    Wire.beginTransmission(_i2caddr);
-    if(base <= 0xff) Wire.write((uint8_t)base);
-    Wire.write(reg);
-    Wire.endTransmission(true);
+    if(base <= 0xff) cmd[l++] = base;
+    cmd[l++] = reg;
+    i2c_xfer(I2CD_ROTENC + _type, _i2caddr, cmd, l);
     delay(1);
-    i2clen = Wire.requestFrom(_i2caddr, (int)num);
-    for(int i = 0; i < i2clen; i++) {
-        buf[i] = Wire.read();
-    }
-    return i2clen;
+    i2clen = i2c_xfer(I2CD_ROTENC + _type, _i2caddr, NULL, 0, buf, num);
+
+    return (i2clen < 0) ? 0 : i2clen;
 }
 
 void TCRotEnc::write(uint16_t base, uint8_t reg, uint8_t *buf, uint8_t num)
 {
-    Wire.beginTransmission(_i2caddr);
-    if(base <= 0xff) Wire.write((uint8_t)base);
-    Wire.write(reg);
-    for(int i = 0; i < num; i++) {
-        Wire.write(buf[i]);
+    uint8_t cmd[16];
+    int     l = 0;
+
+    if(base <= 0xff) cmd[l++] = base;
+    cmd[l++] = reg;
+    for(int i = 0; i < num && l < (int)sizeof(cmd); i++) {
+        cmd[l++] = buf[i];
     }
-    Wire.endTransmission();
+    i2c_write(I2CD_ROTENC + _type, _i2caddr, cmd, l);
 }
 #endif 
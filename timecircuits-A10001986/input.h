@@ -105,7 +105,7 @@ class Keypad_I2C {
                    unsigned int numRows, unsigned int numCols,
                    int address);
 
-        void begin(unsigned int scanInterval, unsigned int holdTime, void (*myDelay)(int, unsigned long));
+        void begin(unsigned int scanInterval, unsigned int holdTime, void (*myDelay)(int, unsigned long), int intPin = -1);
 
         void addEventListener(void (*listener)(char, KeyState)) { _keypadEventListener = listener; }
 
@@ -114,6 +114,7 @@ class Keypad_I2C {
     private:
 
         bool scanKeys();
+        void armInt();
         void advanceState(bool kstate);
         void transitionTo(KeyState nextState);
 
@@ -133,6 +134,11 @@ class Keypad_I2C {
 
         unsigned long _scanTime = 0;        
         uint32_t      _rowMask;
+        uint8_t       _colMask;
+
+        int           _intPin = -1;
+        bool          _idle = false;      // Columns low, waiting for INT
+        unsigned long _wakeTime = 0;      // micros() when activity was seen
 
         uint8_t       _pinState;  // shadow for output pins
 
@@ -142,6 +148,10 @@ class Keypad_I2C {
         void (*_customDelayFunc)(int, unsigned long) = NULL;
 };
 
+#ifdef TC_PROFILER
+int kpd_report(char *buf, int bufLen);
+#endif
+
 /*
  * TCButton class
  */
@@ -57,6 +57,7 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include "rtc.h"
+#include "tc_i2c.h"
 
 // Registers
 #define DS3231_TIME       0x00 // Time 
@@ -425,20 +426,10 @@ uint8_t tcRTC::read_register(uint8_t reg)
 
 void tcRTC::write_bytes(uint8_t *buffer, uint8_t num)
 {
-    Wire.beginTransmission(_address);
-    for(int i = 0; i < num; i++) {
-        Wire.write(buffer[i]);
-    }
-    Wire.endTransmission();   
+    i2c_xfer(I2CD_RTC, _address, buffer, num);
 }
 
 void tcRTC::read_bytes(uint8_t reg, uint8_t *buffer, uint8_t num)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(reg);
-    Wire.endTransmission();
-    Wire.requestFrom(_address, num);
-    for(int i = 0; i < num; i++) {
-        buffer[i] = Wire.read();
-    }
+    i2c_xfer(I2CD_RTC, _address, &reg, 1, buffer, num);
 }
@@ -87,6 +87,7 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include "sensors.h"
+#include "tc_i2c.h"
 
 static void defaultDelay(unsigned long mydelay)
 {
@@ -108,27 +109,13 @@ static uint8_t crc8(uint8_t initVal, uint8_t poly, uint8_t len, uint8_t *buf)
     return crc;
 }
 
-void tcSensor::prepareRead(uint16_t regno)
-{
-    Wire.beginTransmission(_address);
-    Wire.write((uint8_t)(regno));
-    Wire.endTransmission(false);
-}
-
 uint16_t tcSensor::read16(uint16_t regno, bool LSBfirst)
 {
+    uint8_t  reg = regno, buf[2];
     uint16_t value = 0;
-    size_t i2clen = 0;
 
-    if(regno <= 0xff) {
-        prepareRead(regno);
-    }
-
-    i2clen = Wire.requestFrom(_address, (uint8_t)2);
-
-    if(i2clen > 0) {
-        value = (Wire.read() << 8);
-        value |= Wire.read();
+    if(i2c_xfer(_i2cdev, _address, &reg, (regno <= 0xff) ? 1 : 0, buf, 2, true) > 0) {
+        value = (buf[0] << 8) | buf[1];
     }
     
     if(LSBfirst) {
@@ -140,17 +127,11 @@ uint16_t tcSensor::read16(uint16_t regno, bool LSBfirst)
 
 void tcSensor::read16x2(uint16_t regno, uint16_t& t1, uint16_t& t2)
 {
-    size_t i2clen = 0;
-
-    prepareRead(regno);
-
-    i2clen = Wire.requestFrom(_address, (uint8_t)4);
+    uint8_t reg = regno, buf[4];
 
-    if(i2clen > 0) {
-        t1 = Wire.read();
-        t1 |= (Wire.read() << 8);
-        t2 = Wire.read();
-        t2 |= (Wire.read() << 8);
+    if(i2c_xfer(_i2cdev, _address, &reg, 1, buf, 4, true) > 0) {
+        t1 = buf[0] | (buf[1] << 8);
+        t2 = buf[2] | (buf[3] << 8);
     } else {
         t1 = t2 = 0;
     }
@@ -158,39 +139,50 @@ void tcSensor::read16x2(uint16_t regno, uint16_t& t1, uint16_t& t2)
 
 uint8_t tcSensor::read8(uint16_t regno)
 {
-    uint16_t value = 0;
-
-    prepareRead(regno);
+    uint8_t reg = regno, value = 0xff;
 
-    Wire.requestFrom(_address, (uint8_t)1);
-
-    value = Wire.read();
+    i2c_xfer(_i2cdev, _address, &reg, 1, &value, 1, true);
 
     return value;
 }
 
 void tcSensor::write16(uint16_t regno, uint16_t value, bool LSBfirst)
 {
-    Wire.beginTransmission(_address);
+    uint8_t buf[3];
+    int     l = 0;
+
     if(regno <= 0xff) {
-        Wire.write((uint8_t)(regno));
+        buf[l++] = regno;
     }
     if(LSBfirst) {
         value = (value >> 8) | (value << 8);
     } 
-    Wire.write((uint8_t)(value >> 8));
-    Wire.write((uint8_t)(value & 0xff));
-    Wire.endTransmission();
+    buf[l++] = value >> 8;
+    buf[l++] = value & 0xff;
+    i2c_xfer(_i2cdev, _address, buf, l);
 }
 
 void tcSensor::write8(uint16_t regno, uint8_t value)
 {
-    Wire.beginTransmission(_address);
+    uint8_t buf[2];
+    int     l = 0;
+
     if(regno <= 0xff) {
-        Wire.write((uint8_t)(regno));
+        buf[l++] = regno;
     }
-    Wire.write((uint8_t)(value & 0xff));
-    Wire.endTransmission();
+    buf[l++] = value;
+    i2c_xfer(_i2cdev, _address, buf, l);
+}
+
+// Read num bytes without register address; true if all arrived
+bool tcSensor::readBytes(uint8_t *buf, uint8_t num)
+{
+    return (i2c_xfer(_i2cdev, _address, NULL, 0, buf, num) == num);
+}
+
+void tcSensor::writeBytes(const uint8_t *buf, uint8_t num)
+{
+    i2c_xfer(_i2cdev, _address, buf, num);
 }
 
 #endif
@@ -309,11 +301,15 @@ void tcSensor::write8(uint16_t regno, uint8_t value)
 #define HDC302x_CRC_INIT  0xff
 #define HDC302x_CRC_POLY  0x31
 
+// Retry interval for a sensor still busy after the conversion time
+#define TEMP_RETRY_MS     5
+
 // Store i2c address
 tempSensor::tempSensor(int numTypes, const uint8_t *addrArr)
 {
     _numTypes = numTypes;
     _addrArr = addrArr;
+    _i2cdev = I2CD_TEMP;
 }
 
 // Start the display
@@ -359,8 +355,7 @@ bool tempSensor::begin(void (*myDelay)(unsigned long), bool InCelsius)
                 // Do a test-measurement for id
                 write8(SHT40_DUMMY, SHT40_CMD_RTEMPL);
                 (*_customDelayFunc)(5);
-                if(Wire.requestFrom(_address, (uint8_t)6) == 6) {
-                    for(uint8_t i = 0; i < 6; i++) buf[i] = Wire.read();
+                if(readBytes(buf, 6)) {
                     if(crc8(SHT40_CRC_INIT, SHT40_CRC_POLY, 2, buf) == buf[2]) {
                         foundSt = true;
                     }
@@ -387,9 +382,8 @@ bool tempSensor::begin(void (*myDelay)(unsigned long), bool InCelsius)
                 break;
             case HDC302X:
                 write16(HDC302x_DUMMY, HDC302x_READID);
-                if(Wire.requestFrom(_address, (uint8_t)3) == 3) {
-                    t16 = Wire.read() << 8;
-                    t16 |= Wire.read();
+                if(readBytes(buf, 3)) {
+                    t16 = (buf[0] << 8) | buf[1];
                     if(t16 == 0x3000) {
                         foundSt = true;
                     }
@@ -579,6 +573,9 @@ bool tempSensor::begin(void (*myDelay)(unsigned long), bool InCelsius)
         return false;
     }
 
+    // begin() triggered the first conversion
+    _contConv = (_st == MCP9808 || _st == BMx280 || _st == TMP117);
+    _convRunning = true;
     _tempReadNow = millis();
 
     _customDelayFunc = myDelay;
@@ -586,18 +583,133 @@ bool tempSensor::begin(void (*myDelay)(unsigned long), bool InCelsius)
     return true;
 }
 
-// Read temperature
-float tempSensor::readTemp()
+/*
+ * Measurement: requestTemp() starts a conversion (unless the sensor
+ * converts continuously, or a conversion is already running), loop()
+ * collects the result once the conversion time has passed and updates
+ * _lastTemp/_hum. Nothing here waits, except readTemp().
+ */
+
+// Request a measurement; the result is collected by loop()
+void tempSensor::requestTemp()
+{
+    if(_st < 0)
+        return;
+
+    _tempWanted = true;
+
+    if(!_convRunning) {
+        startConv();
+    }
+}
+
+// Collect a requested measurement if ready. Returns true when
+// _lastTemp (and _hum) were updated.
+bool tempSensor::loop()
 {
     float temp = NAN;
-    uint16_t t = 0, h = 0;
-    uint8_t buf[8];
+    unsigned long elapsed;
+
+    if(!_tempWanted || !_convRunning)
+        return false;
+
+    elapsed = millis() - _tempReadNow;
+    if(elapsed < _delayNeeded)
+        return false;
+
+    if(!collect(temp)) {
+        // Still busy; ask again in a few ms, give up after a while
+        if(++_busyRetries * TEMP_RETRY_MS < _delayNeeded * 3) {
+            _tempReadNow = millis() - _delayNeeded + TEMP_RETRY_MS;
+            return false;
+        }
+        temp = NAN;
+    }
+
+    _busyRetries = 0;
+    _tempWanted = false;
+    _convRunning = _contConv;
+
+    if(!isnan(temp)) {
+        if(!_tempInCelsius) temp = temp * 9.0f / 5.0f + 32.0f;
+        temp += _userOffset;
+        _lastTempNan = false;
+        _lastTempT100 = (int16_t)(temp * 100.0f);
+    } else {
+        _lastTempNan = true;
+        _lastTempT100 = -32768;
+    }
+
+    // We use only 2 digits, so truncate
+    if(_hum > 99) _hum = 99;
     
-    if(_delayNeeded > 0) {
+    #ifdef TC_DBG_SENS
+    Serial.printf("Sensor temp+offset: %f\n", temp);
+    if(_haveHum) {
+        Serial.printf("Sensor humidity: %d\n", _hum);
+    }
+    #endif
+
+    _lastTemp = temp;
+
+    return true;
+}
+
+// Measure and wait for the result
+float tempSensor::readTemp()
+{
+    requestTemp();
+
+    while(_tempWanted && !loop()) {
         unsigned long elapsed = millis() - _tempReadNow;
-        if(elapsed < _delayNeeded) (*_customDelayFunc)(_delayNeeded - elapsed);
+        (*_customDelayFunc)((elapsed < _delayNeeded) ? _delayNeeded - elapsed : 1);
+    }
+
+    return _lastTemp;
+}
+
+// Private functions ###########################################################
+
+void tempSensor::startConv()
+{
+    switch(_st) {
+    case SHT40:
+        write8(SHT40_DUMMY, SHT40_CMD_RTEMPM);
+        break;
+    case SI7021:
+        write8(SI7021_DUMMY, SI7021_CMD_RHUM);
+        break;
+    case AHT20:
+        write16(0xac, 0x3300);
+        break;
+    case HTU31:
+        write8(HTU31_DUMMY, HTU31_CONV);
+        break;
+    case MS8607:
+        _address = MS8607_ADDR_T;
+        write8(MS8607_DUMMY, 0x54);
+        _address = MS8607_ADDR_RH;
+        write8(MS8607_DUMMY, 0xf5);
+        break;
+    case HDC302X:
+        write16(HDC302x_DUMMY, HDC302x_TRIGGER);
+        break;
+    default:
+        // MCP9808, BMx280, TMP117 convert continuously
+        return;
     }
 
+    _tempReadNow = millis();
+    _convRunning = true;
+}
+
+// Read result of last conversion; temp remains NAN on error.
+// Returns false if the sensor is still busy.
+bool tempSensor::collect(float& temp)
+{
+    uint16_t t = 0, h = 0;
+    uint8_t buf[8];
+
     switch(_st) {
 
     case MCP9808:
@@ -611,10 +723,9 @@ float tempSensor::readTemp()
     case BMx280:
         write8(BMx280_DUMMY, BMx280_REG_TEMP);
         t = _haveHum ? 5 : 3;
-        if(Wire.requestFrom(_address, (uint8_t)t) == t) {
+        if(readBytes(buf, t)) {
             uint32_t t1; 
             uint16_t t2 = 0;
-            for(uint8_t i = 0; i < t; i++) buf[i] = Wire.read();
             t1 = (buf[0] << 16) | (buf[1] << 8) | buf[2];
             if(_haveHum) t2 = (buf[3] << 8) | buf[4];
             temp = BMx280_CalcTemp(t1, t2);
@@ -627,12 +738,10 @@ float tempSensor::readTemp()
             _hum = (int8_t)((int32_t)(125 * h) / 65535) - 6;
            if(_hum < 0) _hum = 0;
         }
-        write8(SHT40_DUMMY, SHT40_CMD_RTEMPM);    // Trigger new measurement
         break;
 
     case SI7021:
-        if(Wire.requestFrom(_address, (uint8_t)3) == 3) {
-            for(uint8_t i = 0; i < 3; i++) buf[i] = Wire.read();
+        if(readBytes(buf, 3)) {
             if(crc8(SI7021_CRC_INIT, SI7021_CRC_POLY, 2, buf) == buf[2]) {
                 t = (buf[0] << 8) | buf[1];
                 _hum = (int8_t)((int32_t)((125 * t) >> 16)) - 6;
@@ -640,12 +749,10 @@ float tempSensor::readTemp()
             }
         }
         write8(SI7021_DUMMY, SI7021_CMD_RTEMPQ);
-        if(Wire.requestFrom(_address, (uint8_t)2) == 2) {
-            for(uint8_t i = 0; i < 2; i++) buf[i] = Wire.read();
+        if(readBytes(buf, 2)) {
             t = (buf[0] << 8) | buf[1];
             temp = ((175.72f * (float)t) / 65536.0f) - 46.85f;
         }
-        write8(SI7021_DUMMY, SI7021_CMD_RHUM);    // Trigger new measurement
         break;
 
     case TMP117:
@@ -656,14 +763,13 @@ float tempSensor::readTemp()
         break;
 
     case AHT20:
-        if(Wire.requestFrom(_address, (uint8_t)7) == 7) {
-            for(uint8_t i = 0; i < 7; i++) buf[i] = Wire.read();
+        if(readBytes(buf, 7)) {
+            if(buf[0] & 0x80) return false;     // Busy
             if(crc8(AHT20_CRC_INIT, AHT20_CRC_POLY, 6, buf) == buf[6]) {
                 _hum = (((uint32_t)((buf[1] << 12) | (buf[2] << 4) | (buf[3] >> 4))) * 100) >> 20;
                 temp = ((((float)((uint32_t)(((buf[3] & 0x0f) << 16) | (buf[4] << 8) | buf[5]))) * 200.0f) / 1048576.0f) - 50.0f;
             }
         }
-        write16(0xac, 0x3300);    // Trigger new measurement
         break;
 
     case HTU31:
@@ -672,34 +778,26 @@ float tempSensor::readTemp()
             temp = (((float)(165 * t)) / 65535.0f) - 40.0f;
             _hum = (int8_t)(((float)(100 * h)) / 65535.0f);
         }
-        write8(HTU31_DUMMY, HTU31_CONV);  // Trigger new conversion
         break;
 
     case MS8607:
         _address = MS8607_ADDR_T;
         write8(MS8607_DUMMY, 0x00);
-        if(Wire.requestFrom(_address, (uint8_t)3) == 3) {
-            int32_t dT = 0;
-            for(int i = 0; i < 3; i++) { dT<<=8; dT |= Wire.read(); }
+        if(readBytes(buf, 3)) {
+            int32_t dT = (buf[0] << 16) | (buf[1] << 8) | buf[2];
             dT -= _MS8607_C5;
             temp = (2000.0f + (((float)(dT * _MS8607_C6)) / 8388608.0f)) / 100.0f;
         }
-        // Trigger new conversion t
-        write8(MS8607_DUMMY, 0x54);
         _address = MS8607_ADDR_RH;
-        if(Wire.requestFrom(_address, (uint8_t)3) == 3) {
-            t = Wire.read() << 8; 
-            t |= Wire.read();
+        if(readBytes(buf, 3)) {
+            t = (buf[0] << 8) | buf[1];
             t &= ~0x03;
-            Wire.read();
             _hum = (int8_t)(((int32_t)(t * 12500 / 65536) - 600) / 100);
             //if(temp > 0.0f && temp <= 85.0f) {
             //    _hum += ((int8_t)((float)(20.0f - temp) * -0.18f));   // rh compensated; not worth the computing time
             //}
             if(_hum < 0) _hum = 0;
         }
-        // Trigger new conversion rH
-        write8(MS8607_DUMMY, 0xf5);
         break;
 
     case HDC302X:
@@ -707,39 +805,12 @@ float tempSensor::readTemp()
             temp = (((float)(175 * t)) / 65535.0f) - 45.0f;
             _hum = (int8_t)((uint32_t)(100 * h) / 65535);
         }
-        write16(HDC302x_DUMMY, HDC302x_TRIGGER);  // Trigger new conversion
         break;
     }
 
-    _tempReadNow = millis();
-
-    if(!isnan(temp)) {
-        if(!_tempInCelsius) temp = temp * 9.0f / 5.0f + 32.0f;
-        temp += _userOffset;
-        _lastTempNan = false;
-        _lastTempT100 = (int16_t)(temp * 100.0f);
-    } else {
-        _lastTempNan = true;
-        _lastTempT100 = -32768;
-    }
-
-    // We use only 2 digits, so truncate
-    if(_hum > 99) _hum = 99;
-    
-    #ifdef TC_DBG_SENS
-    Serial.printf("Sensor temp+offset: %f\n", temp);
-    if(_haveHum) {
-        Serial.printf("Sensor humidity: %d\n", _hum);
-    }
-    #endif
-
-    _lastTemp = temp;
-
-    return temp;
+    return true;
 }
 
-// Private functions ###########################################################
-
 float tempSensor::BMx280_CalcTemp(uint32_t ival, uint32_t hval)
 {
     int32_t var1, var2, fine_t, temp;
@@ -775,8 +846,7 @@ void tempSensor::HDC302x_setDefault(uint16_t reg, uint8_t val1, uint8_t val2)
     
     write16(HDC302x_DUMMY, reg);
     (*_customDelayFunc)(5);
-    if(Wire.requestFrom(_address, (uint8_t)3) == 3) {
-        for(uint8_t i = 0; i < 3; i++) buf[i] = Wire.read();
+    if(readBytes(buf, 3)) {
         if(crc8(HDC302x_CRC_INIT, HDC302x_CRC_POLY, 2, buf) == buf[2]) {
             #ifdef TC_DBG_SENS
             Serial.printf("HDC302x: Read 0x%x\n", reg);
@@ -788,11 +858,7 @@ void tempSensor::HDC302x_setDefault(uint16_t reg, uint8_t val1, uint8_t val2)
                 buf[0] = reg >> 8; buf[1] = reg & 0xff;
                 buf[2] = val1; buf[3] = val2;
                 buf[4] = crc8(HDC302x_CRC_INIT, HDC302x_CRC_POLY, 2, &buf[2]);
-                Wire.beginTransmission(_address);
-                for(int i=0; i < 5; i++) {
-                    Wire.write(buf[i]);
-                }
-                Wire.endTransmission();
+                writeBytes(buf, 5);
                 (*_customDelayFunc)(80);
             } else {
                 #ifdef TC_DBG_SENS
@@ -813,8 +879,7 @@ void tempSensor::HDC302x_setDefault(uint16_t reg, uint8_t val1, uint8_t val2)
 
 bool tempSensor::readAndCheck6(uint8_t *buf, uint16_t& t, uint16_t& h, uint8_t crcinit, uint8_t crcpoly)
 {
-    if(Wire.requestFrom(_address, (uint8_t)6) == 6) {
-        for(int i = 0; i < 6; i++) buf[i] = Wire.read();
+    if(readBytes(buf, 6)) {
         if(crc8(crcinit, crcpoly, 2, buf) == buf[2]) {
             t = (buf[0] << 8) | buf[1];
             if(crc8(crcinit, crcpoly, 2, buf+3) == buf[5]) {
@@ -975,6 +1040,7 @@ lightSensor::lightSensor(int numTypes, const uint8_t *addrArr)
 {
     _numTypes = numTypes;
     _addrArr = addrArr;
+    _i2cdev = I2CD_LIGHT;
 }
 
 bool lightSensor::begin(bool skipLast, void (*myDelay)(unsigned long))
@@ -1094,6 +1160,7 @@ void lightSensor::loop()
 {
     uint16_t temp, temp2;
     uint32_t temp1;
+    uint8_t  buf[4];
     unsigned long elapsed = millis() - _lastAccess;
 
     switch(_st) {
@@ -1135,11 +1202,9 @@ void lightSensor::loop()
             return;
 
         write8(LTR303_DUMMY, LTR303_DATA1);
-        if(Wire.requestFrom(_address, (uint8_t)4) == 4) {
-            temp1 = Wire.read();
-            temp1 |= (Wire.read() << 8);
-            temp  = Wire.read();
-            temp  |= (Wire.read() << 8);
+        if(readBytes(buf, 4)) {
+            temp1 = buf[0] | (buf[1] << 8);
+            temp  = buf[2] | (buf[3] << 8);
             if(temp + temp1 == 0) {
                 _lux = 0;
             } else {
@@ -66,14 +66,16 @@ class tcSensor {
 
     protected:
 
-        void     prepareRead(uint16_t regno);
         uint16_t read16(uint16_t regno, bool LSBfirst = false);
         void     read16x2(uint16_t regno, uint16_t& t1, uint16_t& t2);
         uint8_t  read8(uint16_t regno);
         void     write16(uint16_t regno, uint16_t value, bool LSBfirst = false);
         void     write8(uint16_t regno, uint8_t value);
+        bool     readBytes(uint8_t *buf, uint8_t num);
+        void     writeBytes(const uint8_t *buf, uint8_t num);
 
         uint8_t _address;
+        uint8_t _i2cdev;
 
         // Ptr to custom delay function
         void (*_customDelayFunc)(unsigned long) = NULL;
@@ -102,6 +104,8 @@ class tempSensor : tcSensor {
         tempSensor(int numTypes, const uint8_t *addrArr);
         bool begin(void (*myDelay)(unsigned long), bool InCelsius);
 
+        void    requestTemp();
+        bool    loop();
         float   readTemp();
         float   readLastTemp()     { return _lastTemp;     };
         bool    lastTempNan()      { return _lastTempNan;  };
@@ -122,6 +126,10 @@ class tempSensor : tcSensor {
         int8_t  _hum = -1;
         bool    _haveHum = false;
         unsigned long _delayNeeded = 0;
+        bool    _contConv = false;
+        bool    _convRunning = false;   // since _tempReadNow
+        bool    _tempWanted = false;
+        uint8_t _busyRetries = 0;
 
         float   _lastTemp = NAN;
         bool    _lastTempNan = true;
@@ -147,6 +155,8 @@ class tempSensor : tcSensor {
 
         unsigned long _tempReadNow = 0;
 
+        void  startConv();
+        bool  collect(float& temp);
         float BMx280_CalcTemp(uint32_t ival, uint32_t hval);
         void  HDC302x_setDefault(uint16_t reg, uint8_t val1, uint8_t val2);
         bool  readAndCheck6(uint8_t *buf, uint16_t& t, uint16_t& h, uint8_t crcinit, uint8_t crcpoly);
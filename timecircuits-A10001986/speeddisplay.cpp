@@ -66,6 +66,7 @@
 #include <math.h>
 #include "speeddisplay.h"
 #include <Wire.h>
+#include "tc_i2c.h"
 
 // Speedo displays "--" for NO_FIX_DASHES ms if GPS fix is
 // lost, afterwards it will display "00.".
@@ -580,15 +581,17 @@ void speedDisplay::show()
             }
         }
     
-        Wire.beginTransmission(_address);
-        Wire.write(0x00);  // start address
+        uint8_t buf[1 + 8*2];
+        int l = 0;
+
+        buf[l++] = 0x00;  // start address
     
         for(i = 0; i <= _max_buf; i++) {
-            Wire.write(_displayBuffer[i] & 0xFF);
-            Wire.write(_displayBuffer[i] >> 8);
+            buf[l++] = _displayBuffer[i] & 0xFF;
+            buf[l++] = _displayBuffer[i] >> 8;
         }
     
-        Wire.endTransmission();
+        i2c_write(I2CD_SPEED, _address, buf, l);
 
     }
     
@@ -835,21 +838,14 @@ uint16_t speedDisplay::getLEDChar(uint8_t value)
 // Directly clear the display
 void speedDisplay::clearDisplay()
 {
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);  // start address
-
-    for(int i = 0; i < 8*2; i++) {
-        Wire.write(0x0);
-    }
+    uint8_t buf[1 + 8*2] = { 0 };   // start address, data
 
-    Wire.endTransmission();
+    i2c_write(I2CD_SPEED, _address, buf, sizeof(buf));
 }
 
 void speedDisplay::directCmd(uint8_t val)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(val);
-    Wire.endTransmission();
+    i2c_write(I2CD_SPEED, _address, &val, 1);
 }
 
 #ifdef SERVOSPEEDO
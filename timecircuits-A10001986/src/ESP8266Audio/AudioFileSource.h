@@ -38,6 +38,11 @@ class AudioFileSource
     virtual uint32_t getSize() { return 0; };
     virtual uint32_t getPos() { return 0; };
     virtual bool loop() { return true; };
+    // TW: Zero-copy read for sources in (mapped) memory: Return pointer
+    // to up to *len bytes at the current position, advance past them, 
+    // and set *len to what is available. NULL if not supported (which
+    // can be checked for with *len == 0).
+    virtual const void *readPtr(uint32_t *len) { *len = 0; return NULL; };
 };
 
 #endif
@@ -96,4 +96,22 @@ uint32_t AudioFileSourcePROGMEM::read(void *data, uint32_t len)
   return toRead;
 }
 
+// TW: On the ESP32, flash is mapped into the data address space,
+// so the generator can read PROGMEM (and RAM) data in place
+const void *AudioFileSourcePROGMEM::readPtr(uint32_t *len)
+{
+#ifdef ESP32
+  if (!opened || filePointer >= progmemLen) { *len = 0; return NULL; }
+
+  uint32_t avail = progmemLen - filePointer;
+  const uint8_t *p = reinterpret_cast<const uint8_t*>(progmemData) + filePointer;
+  if (*len > avail) *len = avail;
+  filePointer += *len;
+  return p;
+#else
+  *len = 0;
+  return NULL;
+#endif
+}
+
 
@@ -195,6 +195,95 @@ bool AudioGeneratorMP3::DecodeNextFrame()
   return true;
 }
 
+#ifdef TWESP32
+// TW: Synthesize next block of samples (one "ns", 32 samples)
+bool AudioGeneratorMP3::SynthNextBlock()
+{
+    samplePtr = 0;
+
+    switch ( mad_synth_frame_onens(synth, frame, nsCount++) ) {
+        case MAD_FLOW_BREAK:
+          #ifdef HAVE_AUDIO_LOGGER
+          audioLogger->printf_P(PSTR("msf1ns MAD_FLOW_BREAK\n"));
+          #endif
+        case MAD_FLOW_STOP:
+          return false; // Either way we're done
+        default:
+          break; // Do nothing
+    }
+
+    if (synth->pcm.samplerate != lastRate) {
+        output->SetRate(synth->pcm.samplerate);
+        lastRate = synth->pcm.samplerate;
+    }
+    if (synth->pcm.channels != lastChannels) {
+        output->SetChannels(synth->pcm.channels);
+        lastChannels = synth->pcm.channels;
+    }
+
+    return true;
+}
+
+bool AudioGeneratorMP3::loop()
+{
+  if (!running) goto done; // Nothing to do here!
+
+  // TW: Push out whole blocks instead of single samples
+  for(;;) {
+
+    // First, push out what is left of the current block. If the
+    // output can't take it all, punt and try later.
+    if (samplePtr < synth->pcm.length) {
+      uint16_t n = synth->pcm.length - samplePtr;
+      uint16_t w = output->ConsumeSamples(&synth->pcm.samples[0][samplePtr],
+                                          &synth->pcm.samples[1][samplePtr], 1, n);
+      samplePtr += w;
+      if (w < n) goto done;   // Can't send, but no error detected
+    }
+
+    // Decode next frame if we're beyond the existing generated data
+    if (nsCount >= nsCountMax) {
+retry:
+      if (Input() == MAD_FLOW_STOP) {
+        return false;
+      }
+
+      if (!DecodeNextFrame()) {
+        if (stream->error == MAD_ERROR_BUFLEN) {
+          // randomly seeking can lead to endless
+          // and unrecoverable "MAD_ERROR_BUFLEN" loop
+          if (++unrecoverable >= 3) {
+            #ifdef HAVE_AUDIO_LOGGER
+            audioLogger->printf_P(PSTR("MP3:ERROR_BUFLEN %d\n"), unrecoverable);
+            #endif
+            unrecoverable = 0;
+            stop();
+            return running;
+          }
+        } else {
+          unrecoverable = 0;
+        }
+        goto retry;
+      }
+      nsCount = 0;
+    }
+
+    if (!SynthNextBlock()) {
+      #ifdef HAVE_AUDIO_LOGGER
+      audioLogger->printf_P(PSTR("SNB failed\n"));
+      #endif
+      running = false;
+      goto done;
+    }
+  }
+
+done:
+  file->loop();
+  output->loop();
+
+  return running;
+}
+#else
 bool AudioGeneratorMP3::GetOneSample(int16_t& saL, int16_t& saR)
 {
   // If we're here, we have one decoded frame and sent 0 or more samples out
@@ -233,7 +322,6 @@ bool AudioGeneratorMP3::GetOneSample(int16_t& saL, int16_t& saR)
   return true;
 }
 
-
 bool AudioGeneratorMP3::loop()
 {
   if (!running) goto done; // Nothing to do here!
@@ -287,6 +375,7 @@ done:
 
   return running;
 }
+#endif // TWESP32
 
 bool AudioGeneratorMP3::begin(AudioFileSource *source, AudioOutput *output)
 {
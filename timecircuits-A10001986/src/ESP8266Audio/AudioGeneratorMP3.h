@@ -76,7 +76,11 @@ class AudioGeneratorMP3 : public AudioGenerator
     enum mad_flow ErrorToFlow();
     enum mad_flow Input();
     bool DecodeNextFrame();
+    #ifdef TWESP32
+    bool SynthNextBlock();
+    #else
     bool GetOneSample(int16_t& sL, int16_t& sR);
+    #endif
 
   private:
     int unrecoverable = 0;
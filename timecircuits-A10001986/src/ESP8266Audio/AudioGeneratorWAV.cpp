@@ -33,6 +33,7 @@ AudioGeneratorWAV::AudioGeneratorWAV()
   output = NULL;
   buffSize = 128;
   buff = NULL;
+  rdBuff = NULL;
   buffPtr = 0;
   buffLen = 0;
 }
@@ -56,27 +57,69 @@ bool AudioGeneratorWAV::isRunning()
   return running;
 }
 
+// TW: Sources in memory are read in place (if 16 bit aligned),
+// others through buff
+bool AudioGeneratorWAV::allocBuf()
+{
+    uint32_t n = 0;
+    const void *p = file->readPtr(&n);
+
+    buff = NULL;
+    if(!p || (reinterpret_cast<uintptr_t>(p) & 1)) {
+        if(!(buff = reinterpret_cast<uint8_t *>(malloc(buffSize))))
+            return false;
+    }
+    rdBuff = buff;
+    buffPtr = 0;
+    buffLen = 0;
+    return true;
+}
+
 bool AudioGeneratorWAV::freeBuf()
 {
     if(buff) free(buff);
     buff = NULL;
+    rdBuff = NULL;
     return false;
 }
 
-// Handle buffered reading, reload each time we run out of data
-bool AudioGeneratorWAV::GetBufferedData16x2(int16_t& destL, int16_t& destR)
+// TW: Reload buffer, or map next chunk of the source. A partial
+// frame left in the buffer (after a short read()) is kept, and 
+// completed by the new data; dropping it would swap L and R (or 
+// worse) from there on. In place, a chunk is only short at the 
+// end of the data, where a partial frame is dropped.
+bool AudioGeneratorWAV::FillBuffer()
 {
-    if(buffPtr >= buffLen) {
+    uint16_t keep = (buffPtr < buffLen) ? buffLen - buffPtr : 0;
+
+    if(!buff) {
+        uint32_t toRead = availBytes > 0x8000 ? 0x8000 : availBytes;   // buffLen is 16 bit
+        rdBuff = reinterpret_cast<const uint8_t *>(file->readPtr(&toRead));
         buffPtr = 0;
-        uint32_t toRead = availBytes > buffSize ? buffSize : availBytes;
-        buffLen = file->read( buff, toRead );
+        buffLen = toRead;
         availBytes -= buffLen;
-        if(buffPtr >= buffLen)
+        return (buffLen > 0);
+    }
+
+    if(keep) memmove(buff, buff + buffPtr, keep);
+    uint32_t toRead = availBytes > buffSize - keep ? buffSize - keep : availBytes;
+    uint32_t got = file->read( buff + keep, toRead );
+    buffPtr = 0;
+    buffLen = keep + got;
+    availBytes -= got;
+    return (got > 0);
+}
+
+// Handle buffered reading, reload each time we run out of data
+bool AudioGeneratorWAV::GetBufferedData16x2(int16_t& destL, int16_t& destR)
+{
+    while(buffLen - buffPtr < 4) {
+        if(!FillBuffer())
             return false; // No data left!
     }
-    destL = *(int16_t *)(buff+buffPtr);
+    destL = *(const int16_t *)(rdBuff+buffPtr);
     buffPtr += 2;
-    destR = *(int16_t *)(buff+buffPtr);
+    destR = *(const int16_t *)(rdBuff+buffPtr);
     buffPtr += 2;
     return true;
 }
@@ -84,15 +127,11 @@ bool AudioGeneratorWAV::GetBufferedData16x2(int16_t& destL, int16_t& destR)
 
 bool AudioGeneratorWAV::GetBufferedData16(int16_t& dest)
 {
-    if(buffPtr >= buffLen) {
-        buffPtr = 0;
-        uint32_t toRead = availBytes > buffSize ? buffSize : availBytes;
-        buffLen = file->read( buff, toRead );
-        availBytes -= buffLen;
-        if(buffPtr >= buffLen)
+    while(buffLen - buffPtr < 2) {
+        if(!FillBuffer())
             return false; // No data left!
     }
-    dest = *(int16_t *)(buff+buffPtr);
+    dest = *(const int16_t *)(rdBuff+buffPtr);
     buffPtr += 2;
     return true;
 }
@@ -100,14 +139,10 @@ bool AudioGeneratorWAV::GetBufferedData16(int16_t& dest)
 bool AudioGeneratorWAV::GetBufferedData8(uint8_t& dest)
 {
     if(buffPtr >= buffLen) {
-        buffPtr = 0;
-        uint32_t toRead = availBytes > buffSize ? buffSize : availBytes;
-        buffLen = file->read( buff, toRead );
-        availBytes -= buffLen;
-        if(buffPtr >= buffLen)
+        if(!FillBuffer())
             return false; // No data left!
     }
-    dest = (uint8_t)buff[buffPtr++];
+    dest = rdBuff[buffPtr++];
     return true;
 }
 
@@ -136,6 +171,35 @@ bool AudioGeneratorWAV::loop()
 {
   if (!running) goto done; // Nothing to do here!
 
+  #ifdef TWESP32
+  // TW: 16 bit: Push out what's in our buffer as a block
+  if(bitsPerSample == 16) {
+      int frameSize = channels * 2;
+      for(;;) {
+          if(buffPtr >= buffLen) {
+              if(!FillBuffer()) {
+                  stop();   // No data left!
+                  break;
+              }
+          }
+          uint16_t n = (buffLen - buffPtr) / frameSize;
+          if(!n) {
+              // Partial frame at end of buffer; complete it
+              if(!FillBuffer()) {
+                  stop();
+                  break;
+              }
+              continue;
+          }
+          const int16_t *p = (const int16_t *)(rdBuff + buffPtr);
+          uint16_t w = output->ConsumeSamples(p, p + (channels - 1), channels, n);
+          buffPtr += w * frameSize;
+          if(w < n) break;  // Can't send, but no error detected
+      }
+      goto done;
+  }
+  #endif
+
   // First, try and push in the stored sample.  If we can't, then punt and try later
   if (!output->ConsumeSample(sL, sR)) goto done; // Can't send, but no error detected
 
@@ -322,13 +386,10 @@ bool AudioGeneratorWAV::ReadWAVInfo()
   availBytes = u32;
 
   // Now set up the buffer or fail
-  buff = reinterpret_cast<uint8_t *>(malloc(buffSize));
-  if (!buff) {
+  if (!allocBuf()) {
     DBG(PSTR("AudioGeneratorWAV::ReadWAVInfo: cannot read WAV, failed to set up buffer \n"));
     return false;
   };
-  buffPtr = 0;
-  buffLen = 0;
 
   // loop starts by pushing out samples, clear them here
   sL = sR = 0;
@@ -40,6 +40,7 @@ class AudioGeneratorWAV : public AudioGenerator
     bool ReadU32(uint32_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 4); }
     bool ReadU16(uint16_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 2); }
     bool ReadU8(uint8_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 1); }
+    bool FillBuffer();
     bool GetBufferedData16x2(int16_t& destL, int16_t& destR);
     bool GetBufferedData16(int16_t& dest);
     bool GetBufferedData8(uint8_t& dest);
@@ -48,6 +49,7 @@ class AudioGeneratorWAV : public AudioGenerator
 
 
   protected:
+    bool allocBuf();
     bool freeBuf();
 
     // WAV info
@@ -60,6 +62,7 @@ class AudioGeneratorWAV : public AudioGenerator
     // We need to buffer some data in-RAM to avoid doing 1000s of small reads
     uint32_t buffSize;
     uint8_t *buff;
+    const uint8_t *rdBuff;  // TW: buff, or the source's data if it is in memory
     uint16_t buffPtr;
     uint16_t buffLen;
 };
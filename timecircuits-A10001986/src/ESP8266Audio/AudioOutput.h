@@ -62,6 +62,20 @@ class AudioOutput
     #else
     virtual bool ConsumeSample(int16_t sL, int16_t sR) { (void)sL;(void)sR; return false; }
     #endif
+    #ifdef TWESP32
+    // TW: Block version: Consume up to count frames; left and right
+    // samples are "stride" int16_t apart (1 = planar, 2 = interleaved).
+    // Returns number of frames consumed.
+    virtual uint16_t ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count)
+    {
+      for (uint16_t i=0; i<count; i++) {
+        if (!ConsumeSample(*sL, *sR)) return i;
+        sL += stride;
+        sR += stride;
+      }
+      return count;
+    }
+    #else
     /*
     virtual uint16_t ConsumeSamples(int16_t *samples, uint16_t count)
     {
@@ -72,9 +86,14 @@ class AudioOutput
       return count;
     }
     */
+    #endif
     virtual bool stop() { return false; }
     virtual void flush() { return; }
     virtual bool loop() { return true; }
+    #ifdef TWESP32
+    // TW: Drop what is queued and output silence, without stopping
+    virtual void silence() { return; }
+    #endif
 
   protected:
     #ifndef TWESP32
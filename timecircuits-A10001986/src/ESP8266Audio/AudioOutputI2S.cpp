@@ -329,6 +329,45 @@ size_t AudioOutputI2S::ConsumeSample(int16_t msL, int16_t msR)
     i2s_write((i2s_port_t)portNo, (const char*)&s32, sizeof(uint32_t), &i2s_bytes_written, 0);
     return i2s_bytes_written;
 }
+
+// TW: Block version: Gain and channel-mute for a whole block,
+// then a single i2s_write(). Returns number of frames written.
+#define I2S_MAX_BLOCK 64
+uint16_t AudioOutputI2S::ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count)
+{
+    uint32_t s32[I2S_MAX_BLOCK];
+    size_t i2s_bytes_written;
+
+    if(!i2sOn)
+        return 0;
+
+    if(count > I2S_MAX_BLOCK) count = I2S_MAX_BLOCK;
+
+    if(channels == 1) sR = sL;
+
+    for(int i = 0; i < count; i++, sL += stride, sR += stride) {
+        int16_t msL = *sL, msR = *sR;
+        #ifndef AUTO_MONO
+        if(channels == 2) {
+          #ifndef FORCE_MONO
+          if(this->mono) {
+            int32_t ttl = msL + msR;
+            msL = msR = ttl >> 1;
+          }
+          #else
+          msL >>= 1;
+          msR >>= 1;
+          msR = msL = msL + msR;
+          #endif // FORCE_MONO
+        }
+        #endif // AUTO_MONO
+        AmplifyL(msL);
+        s32[i] = ((uint32_t)AmplifyR(msR)) | (uint16_t)msL;
+    }
+
+    i2s_write((i2s_port_t)portNo, (const char*)s32, count * sizeof(uint32_t), &i2s_bytes_written, 0);
+    return i2s_bytes_written / sizeof(uint32_t);
+}
 #else
 bool AudioOutputI2S::ConsumeSample(int16_t sL, int16_t sR)
 {
@@ -389,6 +428,16 @@ void AudioOutputI2S::flush()
   #endif
 }
 
+#ifdef TWESP32
+// TW: The DMA keeps running and repeats what is in its buffers
+void AudioOutputI2S::silence()
+{
+  if (i2sOn) {
+    i2s_zero_dma_buffer((i2s_port_t)portNo);
+  }
+}
+#endif
+
 bool AudioOutputI2S::stop()
 {
   if (!i2sOn)
@@ -42,11 +42,15 @@ class AudioOutputI2S : public AudioOutput
     virtual bool begin() override { return begin(true); }
     #ifdef TWESP32
     virtual size_t ConsumeSample(int16_t sL, int16_t sR) override;
+    virtual uint16_t ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count) override;
     #else
     virtual bool ConsumeSample(int16_t sL, int16_t sR) override;
     #endif
     virtual void flush() override;
     virtual bool stop() override;
+    #ifdef TWESP32
+    virtual void silence() override;
+    #endif
 
     bool begin(bool txDAC);
     bool SetOutputModeMono(bool mono);  // Force mono output no matter the input
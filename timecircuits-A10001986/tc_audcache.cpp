@@ -0,0 +1,279 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Decoded Sound Cache
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tc_global.h"
+
+#ifdef TC_AUDIO_CACHE
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "tc_audcache.h"
+
+static AudCacheEntry  audc[AUDC_MAX_ENTRIES];
+static AudCacheStats  audcStats;
+static const AudCacheEntry *audcInUse[AUDC_MAX_INUSE] = { NULL };
+static uint32_t       audcTick = 0;
+static uint32_t       audcMaxSnd = AUDC_MAXSND_HEAP;
+static bool           audcPSRAM = false;
+
+static bool audc_isInUse(const AudCacheEntry *e);
+
+static void audc_drop(AudCacheEntry *e)
+{
+    audc_free(e->pcm);
+    audcStats.bytes -= e->bytes;
+    memset((void *)e, 0, sizeof(*e));
+}
+
+void audc_setup()
+{
+    audcPSRAM = psramFound();
+    audcStats.budget = audcPSRAM ? AUDC_BUDGET_PS : AUDC_BUDGET_HEAP;
+    audcMaxSnd = audcPSRAM ? AUDC_MAXSND_PS : AUDC_MAXSND_HEAP;
+
+    #ifdef TC_DBG_AUDIO
+    Serial.printf("Audio cache: %s, budget %d, max sound %d\n", 
+        audcPSRAM ? "PSRAM" : "heap", audcStats.budget, audcMaxSnd);
+    #endif
+}
+
+bool audc_havePSRAM()
+{
+    return audcPSRAM;
+}
+
+uint32_t audc_maxSound()
+{
+    return audcMaxSnd;
+}
+
+int16_t *audc_alloc(uint32_t bytes)
+{
+    if(audcPSRAM) {
+        return (int16_t *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+    }
+    return (int16_t *)malloc(bytes);
+}
+
+void audc_free(int16_t *pcm)
+{
+    // heap_caps_malloc'ed memory can be free()d
+    if(pcm) free((void *)pcm);
+}
+
+const AudCacheEntry *audc_find(const char *name)
+{
+    audcStats.lookups++;
+
+    for(int i = 0; i < AUDC_MAX_ENTRIES; i++) {
+        if(audc[i].pcm && !strcmp(audc[i].name, name)) {
+            audc[i].lastUse = ++audcTick;
+            audcStats.hits++;
+            return &audc[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Add a sound; the cache takes ownership of "pcm" (which must have 
+ * been allocated by audc_alloc()), also in case of failure. 
+ * Least recently used entries are evicted until the sound fits.
+ * Returns the new entry, or NULL if the sound was not added.
+ */
+const AudCacheEntry *audc_insert(const char *name, int16_t *pcm, uint32_t bytes, uint32_t rate, uint8_t channels)
+{
+    AudCacheEntry *e = NULL;
+    int16_t *t;
+
+    if(!pcm) return NULL;
+
+    if(!bytes || bytes > audcMaxSnd || !*name || strlen(name) >= AUDC_NAMELEN) {
+        audcStats.rejects++;
+        audc_free(pcm);
+        return NULL;
+    }
+
+    // Replace existing entry of same name
+    for(int i = 0; i < AUDC_MAX_ENTRIES; i++) {
+        if(audc[i].pcm && !strcmp(audc[i].name, name)) {
+            if(audc_isInUse(&audc[i])) {
+                audc_free(pcm);
+                return NULL;
+            }
+            audc_drop(&audc[i]);
+        }
+    }
+
+    for(;;) {
+        AudCacheEntry *lru = NULL;
+        e = NULL;
+        for(int i = 0; i < AUDC_MAX_ENTRIES; i++) {
+            if(!audc[i].pcm) {
+                if(!e) e = &audc[i];
+            } else if(!audc_isInUse(&audc[i])) {
+                if(!lru || audc[i].lastUse < lru->lastUse) lru = &audc[i];
+            }
+        }
+        if(e && audcStats.bytes + bytes <= audcStats.budget) 
+            break;
+        if(!lru) {
+            audcStats.rejects++;
+            audc_free(pcm);
+            return NULL;
+        }
+        #ifdef TC_DBG_AUDIO
+        Serial.printf("Audio cache: Evicting %s\n", lru->name);
+        #endif
+        audc_drop(lru);
+        audcStats.evictions++;
+    }
+
+    // Give back what the caller allocated in excess
+    if(audcPSRAM) {
+        t = (int16_t *)heap_caps_realloc((void *)pcm, bytes, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+    } else {
+        t = (int16_t *)realloc((void *)pcm, bytes);
+    }
+    if(t) pcm = t;
+
+    strcpy(e->name, name);
+    e->pcm = pcm;
+    e->bytes = bytes;
+    e->rate = rate;
+    e->channels = channels;
+    e->lastUse = ++audcTick;
+
+    audcStats.bytes += bytes;
+    audcStats.inserts++;
+
+    #ifdef TC_DBG_AUDIO
+    Serial.printf("Audio cache: Added %s (%d bytes, %dHz, %d ch), %d in use\n", 
+        name, bytes, rate, channels, audcStats.bytes);
+    #endif
+
+    return e;
+}
+
+// The entries currently being played; never evicted
+void audc_setInUse(int slot, const AudCacheEntry *e)
+{
+    audcInUse[slot] = e;
+}
+
+static bool audc_isInUse(const AudCacheEntry *e)
+{
+    for(int i = 0; i < AUDC_MAX_INUSE; i++) {
+        if(audcInUse[i] == e) return true;
+    }
+    return false;
+}
+
+// Entries being played are only unnamed, and evicted later
+void audc_flush()
+{
+    for(int i = 0; i < AUDC_MAX_ENTRIES; i++) {
+        if(!audc[i].pcm) continue;
+        if(audc_isInUse(&audc[i])) {
+            audc[i].name[0] = 0;
+            audc[i].lastUse = 0;
+        } else {
+            audc_drop(&audc[i]);
+        }
+    }
+}
+
+void audc_ttfs(bool hit, uint32_t us)
+{
+    int i = hit ? 1 : 0;
+    
+    audcStats.ttfsCount[i]++;
+    audcStats.ttfsTotal[i] += us;
+    if(us > audcStats.ttfsMax[i]) audcStats.ttfsMax[i] = us;
+}
+
+const AudCacheStats *audc_getStats()
+{
+    return &audcStats;
+}
+
+int audc_report(char *buf, int bufLen)
+{
+    const AudCacheStats *s = &audcStats;
+    int l, n = 0;
+
+    l = snprintf(buf, bufLen, 
+            "Audio cache (%s): %u/%u bytes, %u lookups, %u hits (%u%%), %u inserts, %u evictions, %u rejects\n",
+            audcPSRAM ? "PSRAM" : "heap", s->bytes, s->budget, 
+            s->lookups, s->hits, s->lookups ? (s->hits * 100) / s->lookups : 0, 
+            s->inserts, s->evictions, s->rejects);
+    if(l < 0 || l >= bufLen) return bufLen - 1;
+    n += l;
+
+    for(int i = 1; i >= 0; i--) {
+        l = snprintf(buf + n, bufLen - n, "  time to first sample, %s: n %u, avg %uus, max %uus\n",
+                i ? "hit " : "miss", s->ttfsCount[i], 
+                s->ttfsCount[i] ? s->ttfsTotal[i] / s->ttfsCount[i] : 0, 
+                s->ttfsMax[i]);
+        if(l < 0 || l >= bufLen - n) return bufLen - 1;
+        n += l;
+    }
+
+    return n;
+}
+
+#endif  // TC_AUDIO_CACHE
@@ -0,0 +1,121 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Decoded Sound Cache
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_AUDCACHE_H
+#define _TC_AUDCACHE_H
+
+/*
+ * LRU cache of decoded PCM for short sounds (keypad, enter, doors...)
+ * 
+ * Entries are 16 bit PCM as delivered by the decoder (mono or
+ * interleaved stereo), kept in PSRAM if present, in the normal heap
+ * otherwise (with a much smaller budget).
+ * 
+ * The cache is owned by the audio task; only the statistics may be
+ * read from elsewhere.
+ */
+
+#include <stdint.h>
+
+#define AUDC_MAX_ENTRIES  16
+#define AUDC_NAMELEN      32      // == AC_FNLEN
+#define AUDC_MAX_INUSE    2       // One per mixer voice
+
+// Budget and max size of a single sound, PSRAM and heap
+#define AUDC_BUDGET_PS    (1024*1024)
+#define AUDC_MAXSND_PS    (384*1024)
+#define AUDC_BUDGET_HEAP  (48*1024)
+#define AUDC_MAXSND_HEAP  (16*1024)
+
+struct AudCacheEntry {
+    char     name[AUDC_NAMELEN];
+    int16_t  *pcm;
+    uint32_t bytes;
+    uint32_t rate;
+    uint8_t  channels;
+    uint32_t lastUse;
+};
+
+struct AudCacheStats {
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t inserts;
+    uint32_t evictions;
+    uint32_t rejects;         // too large or out of memory
+    uint32_t bytes;           // currently in use
+    uint32_t budget;
+    uint32_t ttfsCount[2];    // time to first sample, [0] miss, [1] hit
+    uint32_t ttfsTotal[2];    // us
+    uint32_t ttfsMax[2];      // us
+};
+
+void     audc_setup();
+bool     audc_havePSRAM();
+uint32_t audc_maxSound();
+
+int16_t  *audc_alloc(uint32_t bytes);
+void     audc_free(int16_t *pcm);
+
+const AudCacheEntry *audc_find(const char *name);
+const AudCacheEntry *audc_insert(const char *name, int16_t *pcm, uint32_t bytes, uint32_t rate, uint8_t channels);
+void     audc_setInUse(int slot, const AudCacheEntry *e);
+void     audc_flush();
+
+void     audc_ttfs(bool hit, uint32_t us);
+
+const AudCacheStats *audc_getStats();
+int      audc_report(char *buf, int bufLen);
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Audio command queue
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_AUDCMD_H
+#define _TC_AUDCMD_H
+
+/*
+ * Commands from the main loop to the audio task, and the single-
+ * producer/single-consumer ring they travel through.
+ * 
+ * This header must not depend on anything Arduino/ESP32 specific,
+ * so that it can be compiled and stress-tested on a host.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#define AC_NONE     0
+#define AC_PLAY     1     // Play file (or TCC segments)
+#define AC_KEYPAD   2     // Play DTMF keypad sound
+#define AC_BEEP     3     // Play beep
+#define AC_STOP     4     // Stop whatever is playing
+#define AC_STOPMP3  5     // Stop mp3 (music player)
+#define AC_NOLOOP   6     // Let looped sound run out
+#define AC_GAIN     7     // Set gain
+#define AC_FLUSH    8     // Flush sound cache
+#define AC_NEXT     9     // Music track to switch to at end of current one
+
+#define AC_FNLEN    32    // Max length of file name incl 0
+
+struct AudCmd {
+    uint8_t  cmd;
+    int8_t   mute;        // mutechannels for SetGain()
+    uint8_t  key;
+    uint8_t  voice;       // 0 = main, 1 = effects (mixed over music)
+    uint32_t seq;
+    uint32_t flags;
+    uint32_t start;       // Music w/o PA_DOID3TS: where audio data begins
+    uint32_t size;        //                       expected file size
+    float    gain;
+    union {
+        char    fn[AC_FNLEN];
+        int16_t segs[AC_FNLEN / 2];
+    } u;
+};
+
+// Pack a play command. For PA_TCSEGS, "fn" points to a segment
+// list (count followed by as many segment numbers) instead of a
+// file name; "isSegs" tells us which one it is.
+// Returns false if the file name or segment list does not fit.
+static inline bool audcmd_pack_play(AudCmd &c, const char *fn, bool isSegs, uint32_t flags, float gain, int mute)
+{
+    memset((void *)&c, 0, sizeof(c));
+    c.cmd = AC_PLAY;
+    c.flags = flags;
+    c.gain = gain;
+    c.mute = mute;
+
+    if(isSegs) {
+        const int16_t *s = (const int16_t *)fn;
+        if(s[0] < 0 || s[0] >= (AC_FNLEN / 2)) return false;
+        memcpy((void *)c.u.segs, (const void *)s, (s[0] + 1) * sizeof(int16_t));
+    } else {
+        size_t l = strlen(fn);
+        if(l >= AC_FNLEN) return false;
+        memcpy(c.u.fn, fn, l + 1);
+    }
+
+    return true;
+}
+
+static inline void audcmd_pack(AudCmd &c, uint8_t cmd, float gain = 0.0f, int mute = 0, uint8_t key = 0)
+{
+    memset((void *)&c, 0, sizeof(c));
+    c.cmd = cmd;
+    c.gain = gain;
+    c.mute = mute;
+    c.key = key;
+}
+
+/*
+ * Lock-free ring for exactly one producer and one consumer.
+ * Head is only written by the producer, tail only by the 
+ * consumer; N must be a power of two.
+ */
+template <typename T, uint32_t N>
+class SPSCRing {
+
+    static_assert(N && !(N & (N - 1)), "SPSCRing size must be power of 2");
+
+    public:
+        bool push(const T &v)
+        {
+            uint32_t h = _head.load(std::memory_order_relaxed);
+            if(h - _tail.load(std::memory_order_acquire) >= N)
+                return false;
+            _buf[h & (N - 1)] = v;
+            _head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T &v)
+        {
+            uint32_t t = _tail.load(std::memory_order_relaxed);
+            if(_head.load(std::memory_order_acquire) == t)
+                return false;
+            v = _buf[t & (N - 1)];
+            _tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool isEmpty() const
+        {
+            return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        T _buf[N];
+        std::atomic<uint32_t> _head{0};
+        std::atomic<uint32_t> _tail{0};
+};
+
+#endif
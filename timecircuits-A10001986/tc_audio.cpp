@@ -62,8 +62,10 @@
 #include <Arduino.h>
 #include "src/SD/SD.h"
 #include <FS.h>
+#include <new>
 
 #include "AudioFileSourceLoop.h"
+#include "AudioOutputMixer.h"
 #include "src/ESP8266Audio/AudioFileSourcePROGMEM.h"
 
 #include "src/ESP8266Audio/AudioGeneratorMP3.h"
@@ -76,6 +78,13 @@
 #include "tc_audio.h"
 #include "tc_keypad.h"
 #include "tc_wifi.h"
+#include "tc_sched.h"
+#include "tc_audcmd.h"
+#include "tc_mpsort.h"
+#include "tc_id3.h"
+#ifdef TC_AUDIO_CACHE
+#include "tc_audcache.h"
+#endif
 
 class AudioGeneratorWAVP : public AudioGeneratorWAV
 {
@@ -92,13 +101,10 @@ class AudioGeneratorWAVP : public AudioGeneratorWAV
 
         file->seek(stPos, SEEK_SET);  // 12-13ms
       
-        // Now set up the buffer or fail
-        buff = reinterpret_cast<uint8_t *>(malloc(buffSize));
-        if(!buff) {
+        // Now set up the buffer (none for PROGMEM/cache) or fail
+        if(!allocBuf()) {
             return false;
         }
-        buffPtr = 0;
-        buffLen = 0;
 
         sL = sR = 0;
       
@@ -122,15 +128,215 @@ class AudioGeneratorWAVP : public AudioGeneratorWAV
     };
 };
 
+#ifdef TC_AUDIO_CACHE
+/*
+ * Output that passes everything on to "fwd" (if given) and keeps a 
+ * copy of what was consumed for the sound cache. Without "fwd", 
+ * it just collects (for decoding into the cache at boot).
+ */
+class AudioOutputCapture : public AudioOutput
+{
+  public:
+    bool start(AudioOutput *fwdOut, const char *sndName, uint32_t maxBytes)
+    {
+        if(strlen(sndName) >= AUDC_NAMELEN) return false;
+        if(!(buf = audc_alloc(maxBytes))) return false;
+        fwd = fwdOut;
+        strcpy(name, sndName);
+        maxLen = maxBytes / sizeof(int16_t);
+        len = 0;
+        return true;
+    }
+    // Add to cache if sound was played to the end
+    void end(bool complete)
+    {
+        if(!buf) return;
+        if(complete && len) {
+            audc_insert(name, buf, len * sizeof(int16_t), hertz, channels);
+        } else {
+            audc_free(buf);
+        }
+        buf = NULL;
+    }
+    bool isActive() { return !!buf; }
+
+    virtual bool SetRate(int hz) override
+    {
+        if(len && hz != hertz) discard();
+        hertz = hz;
+        return fwd ? fwd->SetRate(hz) : true;
+    }
+    virtual bool SetBitsPerSample(int bits) override
+    {
+        if(bits != 16) discard();
+        bps = bits;
+        return fwd ? fwd->SetBitsPerSample(bits) : true;
+    }
+    virtual bool SetChannels(int chan) override
+    {
+        if(len && chan != channels) discard();
+        channels = chan;
+        return fwd ? fwd->SetChannels(chan) : true;
+    }
+    virtual bool begin() override { return fwd ? fwd->begin() : true; }
+    virtual size_t ConsumeSample(int16_t sL, int16_t sR) override
+    {
+        size_t r = fwd ? fwd->ConsumeSample(sL, sR) : (buf ? 4 : 0);
+        if(r) capture(&sL, &sR, 1, 1);
+        return r;
+    }
+    virtual uint16_t ConsumeSamples(const int16_t *sL, const int16_t *sR, int stride, uint16_t count) override
+    {
+        uint16_t r = fwd ? fwd->ConsumeSamples(sL, sR, stride, count) : (buf ? count : 0);
+        capture(sL, sR, stride, r);
+        return r;
+    }
+    virtual bool stop() override { return fwd ? fwd->stop() : true; }
+    virtual void flush() override { if(fwd) fwd->flush(); }
+    virtual bool loop() override { return fwd ? fwd->loop() : true; }
+
+  private:
+    void discard()
+    {
+        if(buf) {
+            audc_free(buf);
+            buf = NULL;
+        }
+    }
+    void capture(const int16_t *sL, const int16_t *sR, int stride, uint16_t count)
+    {
+        if(!buf || !count) return;
+        if(len + count * channels > maxLen) {
+            // Too large for the cache; keep playing, but stop collecting
+            discard();
+            return;
+        }
+        if(channels == 1) {
+            for(int i = 0; i < count; i++, sL += stride) buf[len++] = *sL;
+        } else {
+            for(int i = 0; i < count; i++, sL += stride, sR += stride) {
+                buf[len++] = *sL;
+                buf[len++] = *sR;
+            }
+        }
+    }
+
+    AudioOutput *fwd = NULL;
+    int16_t     *buf = NULL;
+    uint32_t    len = 0;
+    uint32_t    maxLen = 0;
+    char        name[AUDC_NAMELEN];
+};
+#endif
+
 static AudioGeneratorMP3 *mp3;
 static AudioGeneratorWAVP *wav;
 
 static AudioFileSourceFSLoop *myFS0;
 static AudioFileSourceSDLoop *mySD0;
+static AudioFileSourceSDLoop *mySD1 = NULL;   // Next music track
 static AudioFileSourcePROGMEM *myPM;
 
 static AudioOutputI2S *out;
 
+// Music (and everything else) plays on the main voice; while the
+// music player is active, key sounds, beeps and signals are mixed
+// over it on the effects voice, with the music ducked. Not if the
+// music goes to line-out, the effects would go there, too.
+#define AUD_DUCK  0.3f
+
+#define AUD_DMA_BUFS  32    // I2S DMA buffers, 64 frames each
+
+static AudioOutputMixer       *mix;
+static AudioOutputMixerVoice  *mvMain;
+static AudioOutputMixerVoice  *mvFx;
+
+static AudioGeneratorMP3      *fxMp3;
+static AudioGeneratorWAVP     *fxWav;
+static AudioFileSourceFSLoop  *fxFS0;
+static AudioFileSourceSDLoop  *fxSD0 = NULL;
+static AudioFileSourcePROGMEM *fxPM;
+
+#ifdef TC_AUDIO_CACHE
+static AudioOutputCapture *cap;
+#endif
+
+// The audio task: Owns the generators and the output, and is fed
+// through audRing. It reports back through the atomics below.
+#define AUD_RING_SIZE   16
+#define AUD_TASK_STACK  8192
+#define AUD_TASK_PRIO   2
+
+#define AR_WAV    0x01    // audRunning
+#define AR_MP3    0x02
+#define AR_FX     0x04    // Effects voice
+
+#define AE_WAVEND 1       // audEnd reason
+#define AE_MP3END 2
+#define AE_FAILED 3
+#define AE_SEQ(s) ((s) & 0x3fffffff)
+
+static SPSCRing<AudCmd, AUD_RING_SIZE> audRing;
+static TaskHandle_t          audTask = NULL;
+
+static uint32_t              audPostSeq = 0;      // main: last cmd posted
+static uint32_t              audPlaySeq = 0;      // main: last sound posted
+static uint32_t              audEndSeen = 0;
+static uint32_t              audID3Seen = 0;
+static uint32_t              audFxPlaySeq = 0;    // main: last effect posted
+static uint32_t              audFxEndSeen = 0;
+static float                 audGain = 0.0f;      // main: last gain posted
+
+static std::atomic<uint32_t> audDoneSeq{0};       // task: last cmd executed
+static std::atomic<uint8_t>  audRunning{0};       // task: AR_xxx
+static std::atomic<uint32_t> audEnd{0};           // task: (seq << 2) | AE_xxx
+static std::atomic<uint32_t> audFxEnd{0};         // task: same for effects voice
+static std::atomic<uint32_t> audID3Seq{0};        // task: seq of id3 data
+static char                  audID3artist[16];
+static char                  audID3track[16];
+static std::atomic<bool>     audIdxStale{false};  // task: folder index entry did not match file
+static uint8_t               wavKind = AR_WAV;    // task: what wav plays
+static uint8_t               fxWavKind = AR_WAV;
+
+#ifdef TC_AUDIO_CACHE
+#define TTFS_MISS 1
+#define TTFS_HIT  2
+static uint8_t               ttfsKind = 0;        // task: measure time to 1st sample
+static uint32_t              ttfsStart = 0;
+#endif
+
+// Gapless music: The main loop tells the task which track comes
+// next (AC_NEXT); the task opens it shortly before the current
+// one ends, and switches decoding over without stopping the output.
+#define AUD_PREFETCH  32768     // Open next track when this many bytes are left
+#define NX_QUEUED     1         // nextState
+#define NX_READY      2
+
+static uint32_t              audNextSeq = 0;      // main: AC_NEXT posted, 0 = none
+static int                   mpNextIdx = 0;
+static int                   mpNextTrack = 0;     // playList might be reshuffled meanwhile
+static char                  mpNextArtist[16];    // from folder index
+static char                  mpNextTitle[16];
+static bool                  mpQueueNext = false;
+static std::atomic<uint32_t> audNextTaken{0};     // task: seq of AC_NEXT switched to
+static AudCmd                nextCmd;             // task: next music track
+static uint8_t               nextState = 0;
+static bool                  curMusic = false;    // task: mp3 is music player track
+
+// Gap between end of one music track and the first samples of
+// the next one; [0] reopened through main loop, [1] prefetched
+#define GAP_REOPEN    1
+#define GAP_PREFETCH  2
+#define AUD_GAP_MAX   5000000   // Longer pauses are not gaps between tracks (us)
+static uint8_t               gapKind = 0;         // task: measure gap at 1st sample
+static bool                  gapArmed = false;
+static uint32_t              gapStart = 0;
+static struct {
+    uint32_t count[2];
+    uint32_t total[2];          // us
+    uint32_t max[2];
+} audGap;
+
 bool audioInitDone = false;
 
 bool        muteBeep    = true;
@@ -139,7 +345,28 @@ static bool beepRunning = false;
 bool            mpActive = false;
 static uint16_t *playList = NULL;
 static int      mpCurrIdx = 0;
-#define         MAXID3LEN 2048
+#define         MP_PLAYFLAGS (PA_MUSIC|PA_LINEOUT|PA_DOID3TS|PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL)
+
+// Music folder index ("/musicX/TCD_IDX.BIN")
+#define MPIDX_MAGIC 0x58494d54    // "TMIX"
+#define MPIDX_VER   1
+
+struct MpIdxHdr {
+    uint32_t magic;
+    uint32_t ver;
+    uint32_t count;         // Number of tracks (000.mp3 - count-1)
+    uint32_t doneTime;      // Date of TCD_DONE.TXT when built
+};
+
+struct MpIdxEnt {
+    uint32_t size;          // File size
+    uint32_t start;         // Start of audio data (after ID3 tag)
+    char     artist[16];    // From ID3 tag, as in id3artist
+    char     title[16];     //               as in id3track
+};
+
+static const char *mpidxfn = "/TCD_IDX.BIN";
+static int         mpIdxCount = 0;      // Tracks in valid index, 0 = none
 
 Aud_State  aud_state  = { .state = 0, .curVolume = DEFAULT_VOLUME, .curTrack = 0, .maxMusic = 0, .mpShuffle = 0 };
 #ifdef TC_HAVEMQTT
@@ -206,6 +433,32 @@ static int      appendFile = 0;
 */
 
 static const char *tcdrdone = "/TCD_DONE.TXT";
+
+// Renamer: Name collection
+#define MPREN_MAXFILES  1000
+#define MPREN_MAXRUNS   8       // Sorted chunks on SD if out of heap
+
+static const unsigned long mprenBufSizes[8] = {
+    16384, 16384, 8192, 8192, 8192, 8192, 8192, 4096 
+};
+
+struct MpRenCtx {
+    MpSortEnt     *a;           // Names of current chunk
+    int           n;
+    char          *bufs[8];
+    int           bufIdx;       // Buffer being filled
+    char          *c;           //   free space in it
+    unsigned long bufSize;
+    int           runs;         // Chunks written to SD
+    int           fileNum;      // Names collected in total
+};
+
+struct MpRenRun {
+    File          f;
+    MpSortEnt     e;
+    char          name[256];
+    bool          valid;
+};
 bool          headLineShown = false;
 bool          blinker       = true;
 unsigned long renNow1, renNow2;
@@ -231,18 +484,49 @@ char id3artist[16] = { 0 };
 char id3track[16]  = { 0 };
 
 static float  getVolume();
+static bool   canMixFx();
+static float  getVolumeFact(float volFact, bool chkNM);
 static void   setLineOut(bool doLineOut);
 
 static void   clear_sig_playing(int ranOut = 0);
 
+static void   audio_task(void *param);
+static void   aud_post(AudCmd &c, bool isSound = false);
+static bool   aud_busy();
+static void   aud_waitDone();
+static void   aud_reap();
+static void   aud_play(const AudCmd &c);
+static void   aud_play_keypad(const AudCmd &c);
+static void   aud_play_beep(const AudCmd &c);
+static void   aud_play_fx(const AudCmd &c);
+static void   aud_stop_fx();
+static void   aud_next_cancel();
+static void   aud_next_prefetch();
+static bool   aud_next_begin();
+static void   aud_gap_record(int kind);
+#ifdef TC_AUDIO_CACHE
+static bool   aud_play_cached(const AudCacheEntry *e, int vc, uint8_t kind);
+static const AudCacheEntry *aud_cache_read(AudioFileSourceLoop *src, const char *name, uint32_t pos, uint32_t len, uint32_t rate);
+static void   aud_cache_prefill();
+#endif
+
 static int    mp_findMaxNum();
 static void   mp_nextprev(bool forcePlay, bool next);
 static bool   mp_play_int(bool force);
 static void   mp_buildFileName(char *fnbuf, int num);
+static void   mp_queueNext();
+static int    mp_idxLoad();
+static int    mp_idxBuild(bool isSetup, int maxNum);
+static bool   mp_idxRead(int num, MpIdxEnt *ent);
+static void   mp_idxDrop();
 static bool   mp_renameFilesInDir(bool isSetup);
-static void   mpren_insertionSort(char **a, int n);
+static void   mpren_looper(bool isSetup, bool checking, int fileNum);
+static bool   mpren_add(MpRenCtx *x, const char *name);
+static void   mpren_sort(MpRenCtx *x);
+static bool   mpren_writeRun(MpRenCtx *x);
+static void   mpren_mergeRuns(MpRenCtx *x, bool isSetup, char *fnbuf, char *fnbuf2, int count);
+static int    mpren_rename(char *fnbuf, char *fnbuf2, const char *name, int count);
 
-static void   decodeID3(char *artist, char *track, char *id3, int id3size);
 
 #include "tc_beep.h"
 
@@ -270,22 +554,43 @@ void audio_setup()
     analogReadResolution(POT_RESOLUTION);
     analogSetWidth(POT_RESOLUTION);
 
-    out = new AudioOutputI2S(0, AudioOutputI2S::EXTERNAL_I2S, 32, AudioOutputI2S::APLL_DISABLE);
+    out = new AudioOutputI2S(0, AudioOutputI2S::EXTERNAL_I2S, AUD_DMA_BUFS, AudioOutputI2S::APLL_DISABLE);
     // Hardware does auto-mono, no need to ever call this later
     // (Also, the mono code is commented out in the audio lib)
     out->SetOutputModeMono(false); 
     out->SetPinout(I2S_BCLK_PIN, I2S_LRCLK_PIN, I2S_DIN_PIN);
+    // Gain is applied per voice in the mixer
+    out->SetGain(1.0f);
+
+    mix = new AudioOutputMixer(out);
+    mix->SetDuck(AUD_DUCK);
+    mvMain = mix->getVoice(0);
+    mvFx = mix->getVoice(1);
+    #ifdef TC_AUD_KEEPI2S
+    mix->SetPersistent(AUD_DMA_BUFS * 64);
+    #endif
 
     mp3 = new AudioGeneratorMP3();
     wav = new AudioGeneratorWAVP();
+    fxMp3 = new AudioGeneratorMP3();
+    fxWav = new AudioGeneratorWAVP();
 
     myFS0 = new AudioFileSourceFSLoop();
+    fxFS0 = new AudioFileSourceFSLoop();
     
     if(haveSD) {
         mySD0 = new AudioFileSourceSDLoop();
+        mySD1 = new AudioFileSourceSDLoop();
+        fxSD0 = new AudioFileSourceSDLoop();
     }
 
     myPM = new AudioFileSourcePROGMEM();
+    fxPM = new AudioFileSourcePROGMEM();
+
+    #ifdef TC_AUDIO_CACHE
+    cap = new AudioOutputCapture();
+    audc_setup();
+    #endif
 
     loadCurVolume();
 
@@ -320,6 +625,27 @@ void audio_setup()
         if(check_file_SD(shsnd)) haveSpHrSnd |= (1 << i);
     }
 
+    #ifdef TC_AUDIO_CACHE
+    // Only with PSRAM; the heap budget is too small for more
+    // than a few keypad sounds, so we fill it on first use.
+    if(audc_havePSRAM()) {
+        aud_cache_prefill();
+    }
+    #endif
+
+    // Start audio task on the core loop() is not running on
+    #if CONFIG_FREERTOS_UNICORE
+    int core = 0;
+    #else
+    int core = xPortGetCoreID() ? 0 : 1;
+    #endif
+    xTaskCreatePinnedToCore(audio_task, "audio", AUD_TASK_STACK, NULL, AUD_TASK_PRIO, &audTask, core);
+
+    // SD read-ahead, on the same core; if it fails, SD is read directly
+    if(haveSD) {
+        AudioFileSourceLoop::startReader(AUD_TASK_PRIO, core);
+    }
+
     audioInitDone = true;
 
     #ifdef TC_DBG_AUDIO
@@ -340,34 +666,39 @@ static int checkAppend()
 
 /*
  * audio_loop()
- *
+ * 
+ * Decoding is done in the audio task; here we only pick up what
+ * the task reported (end of sound, ID3 tags), adjust the volume
+ * and advance the music player.
  */
 void audio_loop()
 {
-    if(wav->isRunning()) {
-        if(!wav->loop()) {
-            wav->stop();
-            beepRunning = false;
-            //checkAppend();
-        }
-    } else if(mp3->isRunning()) {
-        if(!mp3->loop()) {
-            mp3->stop();
-            key_playing = 0;
-            clear_sig_playing(alarmCanRunOut);
-            if(mpActive) {    //if(!checkAppend() && mpActive) {
-                mp_next(true);
-            }
-        } else if(dynVol) {
-            sampleCnt++;
-            if(sampleCnt > 1) {
-                out->SetGain(getVolume(), mutechannels);
-                sampleCnt = 0;
+    aud_reap();
+
+    if(dynVol && (audRunning.load(std::memory_order_relaxed) & AR_MP3)) {
+        sampleCnt++;
+        if(sampleCnt > 1) {
+            float g = getVolume();
+            if(g != audGain) {
+                AudCmd c;
+                audcmd_pack(c, AC_GAIN, g, mutechannels);
+                aud_post(c);
             }
+            sampleCnt = 0;
         }
-    } else if(mpActive) {    //if(!checkAppend() && mpActive) {
+    }
+
+    if(!aud_busy() && mpActive) {
         pwrNeedFullNow();
         mp_next(true);
+    } else if(mpQueueNext) {
+        mpQueueNext = false;
+        if(mpActive) mp_queueNext();
+    }
+
+    if(audIdxStale.load(std::memory_order_relaxed)) {
+        audIdxStale.store(false, std::memory_order_relaxed);
+        mp_idxDrop();
     }
 
     #ifdef TC_HAVEMQTT
@@ -377,40 +708,359 @@ void audio_loop()
 
 void audio_loop_quick()
 {
-    if(wav->isRunning()) {
-        if(!wav->loop()) {
-            wav->stop();
-            beepRunning = false;
-            //checkAppend();
-        }
-    } else if(mp3->isRunning()) {
-        if(!mp3->loop()) {
-            mp3->stop();
-            key_playing = 0;
-            clear_sig_playing(alarmCanRunOut);
-            //checkAppend();
+    aud_reap();
+}
+
+static void aud_reap()
+{
+    uint32_t e = audEnd.load(std::memory_order_acquire);
+    uint32_t i;
+
+    // Audio task switched to the next music track by itself
+    i = audNextTaken.load(std::memory_order_acquire);
+    if(audNextSeq && i == audNextSeq) {
+        audNextSeq = 0;
+        audPlaySeq = i;
+        mpCurrIdx = mpNextIdx;
+        aud_state.curTrack = mpNextTrack;
+        memcpy(id3artist, mpNextArtist, sizeof(mpNextArtist));
+        memcpy(id3track, mpNextTitle, sizeof(mpNextTitle));
+        mpQueueNext = true;
+        pwrNeedFullNow();
+        #ifdef TC_DBG_MP
+        Serial.printf("MusicPlayer: Switched to track %d\n", aud_state.curTrack);
+        #endif
+    }
+
+    i = audFxEnd.load(std::memory_order_acquire);
+    if(i != audFxEndSeen) {
+        audFxEndSeen = i;
+        if((i >> 2) == AE_SEQ(audFxPlaySeq)) {
+            if((i & 3) != AE_MP3END) beepRunning = false;
+            if((i & 3) != AE_WAVEND) clear_sig_playing();
+        }
+    }
+
+    if(e != audEndSeen) {
+        audEndSeen = e;
+        if((e >> 2) == AE_SEQ(audPlaySeq)) {
+            switch(e & 3) {
+            case AE_WAVEND:
+                beepRunning = false;
+                break;
+            case AE_MP3END:
+                key_playing = 0;
+                clear_sig_playing(alarmCanRunOut);
+                break;
+            case AE_FAILED:
+                key_playing = 0;
+                clear_sig_playing();
+                break;
+            }
+        }
+    }
+
+    // Seqlock: copy, then check the seq is still the same
+    i = audID3Seq.load(std::memory_order_acquire);
+    if(i && i != audID3Seen && i == audPlaySeq) {
+        memcpy(id3artist, audID3artist, sizeof(audID3artist));
+        memcpy(id3track, audID3track, sizeof(audID3track));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(audID3Seq.load(std::memory_order_relaxed) == i) {
+            audID3Seen = i;
+        } else {
+            *id3artist = *id3track = 0;
         }
     }
 }
 
-static int32_t skipID3(char *buf)
+/*
+ * Post command to audio task; waits if ring is full
+ */
+static void aud_post(AudCmd &c, bool isSound)
 {
-    if(buf[0] == 'I' && buf[1] == 'D' && buf[2] == '3' && 
-       buf[3] >= 0x02 && buf[3] <= 0x04 && buf[4] == 0 &&
-       (!(buf[5] & 0x80))) {
-        int32_t pos = ((buf[6] << (24-3)) |
-                       (buf[7] << (16-2)) |
-                       (buf[8] << (8-1))  |
-                       (buf[9])) + 10;
-        #ifdef TC_DBG_AUDIO
-        Serial.printf("Skipping ID3 tags, seeking to %d (0x%x)\n", pos, pos);
+    if(!audTask) return;
+
+    c.seq = ++audPostSeq;
+    if(isSound) {
+        if(c.voice) audFxPlaySeq = c.seq;
+        else        audPlaySeq = c.seq;
+    }
+    if((isSound && !c.voice) || c.cmd == AC_GAIN) audGain = c.gain;
+
+    while(!audRing.push(c)) {
+        vTaskDelay(1);
+    }
+    xTaskNotifyGive(audTask);
+}
+
+// Something is playing on the main voice or about to be played
+static bool aud_busy()
+{
+    if(audDoneSeq.load(std::memory_order_acquire) != audPostSeq) return true;
+    return !!(audRunning.load(std::memory_order_relaxed) & (AR_WAV|AR_MP3));
+}
+
+// Wait until the audio task has executed all commands posted
+static void aud_waitDone()
+{
+    if(!audTask) return;
+
+    while(audDoneSeq.load(std::memory_order_acquire) != audPostSeq) {
+        vTaskDelay(1);
+    }
+}
+
+/*
+ * The audio task
+ */
+
+static void aud_stop()
+{
+    if(mp3->isRunning()) {
+        mp3->stop();
+    } else if(wav->isRunning()) {
+        wav->stop();
+    }
+    mvMain->flush();
+    aud_next_cancel();
+    curMusic = false;
+    #ifdef TC_AUDIO_CACHE
+    cap->end(false);
+    audc_setInUse(0, NULL);
+    #endif
+}
+
+static uint8_t aud_running()
+{
+    uint8_t r = 0;
+
+    if(wav->isRunning())      r = wavKind;
+    else if(mp3->isRunning()) r = AR_MP3;
+
+    if(fxWav->isRunning() || fxMp3->isRunning()) r |= AR_FX;
+
+    return r;
+}
+
+static void audio_task(void *param)
+{
+    AudCmd   c;
+    uint32_t curSeq = 0, fxSeq = 0;
+    uint8_t  running;
+
+    for(;;) {
+
+        while(audRing.pop(c)) {
+            if(c.voice) {
+                fxSeq = c.seq;
+                aud_play_fx(c);
+            } else switch(c.cmd) {
+            case AC_PLAY:
+                aud_stop();
+                curSeq = c.seq;
+                aud_play(c);
+                break;
+            case AC_KEYPAD:
+                aud_stop();
+                gapArmed = false;
+                curSeq = c.seq;
+                aud_play_keypad(c);
+                break;
+            case AC_BEEP:
+                curSeq = c.seq;
+                aud_play_beep(c);
+                break;
+            case AC_STOP:
+                aud_stop();
+                aud_stop_fx();
+                break;
+            case AC_STOPMP3:
+                if(mp3->isRunning()) {
+                    mp3->stop();
+                    mvMain->flush();
+                }
+                aud_next_cancel();
+                gapArmed = false;
+                #ifdef TC_AUDIO_CACHE
+                cap->end(false);
+                #endif
+                break;
+            case AC_NOLOOP:
+                if(haveSD) mySD0->setPlayLoop(false);
+                if(haveFS) myFS0->setPlayLoop(false);
+                break;
+            case AC_GAIN:
+                mvMain->SetGain(c.gain, c.mute);
+                break;
+            #ifdef TC_AUDIO_CACHE
+            case AC_FLUSH:
+                audc_flush();
+                AudioFileSourceLoop::flushTOC();
+                break;
+            #endif
+            case AC_NEXT:
+                if(haveSD) {
+                    aud_next_cancel();
+                    nextCmd = c;
+                    nextState = NX_QUEUED;
+                }
+                break;
+            }
+            audRunning.store(aud_running(), std::memory_order_relaxed);
+            audDoneSeq.store(c.seq, std::memory_order_release);
+        }
+
+        sched_audioServiced(!!(running = aud_running()));
+
+        if(wav->isRunning()) {
+            if(!wav->loop()) {
+                wav->stop();
+                #ifdef TC_AUDIO_CACHE
+                cap->end(true);
+                audc_setInUse(0, NULL);
+                #endif
+                audRunning.store(running = aud_running(), std::memory_order_relaxed);
+                audEnd.store((AE_SEQ(curSeq) << 2) | 
+                    ((wavKind == AR_MP3) ? AE_MP3END : AE_WAVEND), std::memory_order_release);
+            }
+        } else if(mp3->isRunning()) {
+            if(curMusic && nextState == NX_QUEUED && 
+               mySD0->getSize() - mySD0->getPos() <= AUD_PREFETCH) {
+                aud_next_prefetch();
+            }
+            if(mp3->loop()) {
+                // First samples of a music track handed to the mixer
+                if(gapKind) aud_gap_record(gapKind - 1);
+                gapKind = 0;
+            } else {
+                mp3->stop();
+                gapKind = 0;
+                if(curMusic) {
+                    gapStart = micros();
+                    gapArmed = true;
+                }
+                if(curMusic && nextState == NX_READY && aud_next_begin()) {
+                    curSeq = nextCmd.seq;
+                    gapKind = GAP_PREFETCH;
+                    audNextTaken.store(curSeq, std::memory_order_release);
+                } else {
+                    #ifdef TC_AUDIO_CACHE
+                    cap->end(true);
+                    #endif
+                    audEnd.store((AE_SEQ(curSeq) << 2) | AE_MP3END, std::memory_order_release);
+                }
+                audRunning.store(running = aud_running(), std::memory_order_relaxed);
+            }
+        }
+
+        if(fxWav->isRunning()) {
+            if(!fxWav->loop()) {
+                fxWav->stop();
+                #ifdef TC_AUDIO_CACHE
+                audc_setInUse(1, NULL);
+                #endif
+                audRunning.store(running = aud_running(), std::memory_order_relaxed);
+                audFxEnd.store((AE_SEQ(fxSeq) << 2) | 
+                    ((fxWavKind == AR_MP3) ? AE_MP3END : AE_WAVEND), std::memory_order_release);
+            }
+        } else if(fxMp3->isRunning()) {
+            if(!fxMp3->loop()) {
+                fxMp3->stop();
+                audRunning.store(running = aud_running(), std::memory_order_relaxed);
+                audFxEnd.store((AE_SEQ(fxSeq) << 2) | AE_MP3END, std::memory_order_release);
+            }
+        }
+
+        // A voice nobody feeds (anymore) must not hold up the mixer
+        if(!(running & (AR_WAV|AR_MP3))) mvMain->stop();
+        if(!(running & AR_FX))           mvFx->stop();
+
+        mix->loop();
+
+        #ifdef TC_AUDIO_CACHE
+        // First loop() after start has put the first samples into
+        // the DMA buffers (or failed)
+        if(ttfsKind) {
+            audc_ttfs(ttfsKind == TTFS_HIT, micros() - ttfsStart);
+            ttfsKind = 0;
+        }
         #endif
+
+        // Output has ~46ms of DMA buffers; while playing, poll every 
+        // tick, otherwise sleep until the next command arrives.
+        if(running || mix->isBusy()) {
+            vTaskDelay(1);
+        } else {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+}
+
+static int32_t skipID3(char *buf)
+{
+    int32_t pos = id3_tagSize((const uint8_t *)buf);
+
+    #ifdef TC_DBG_AUDIO
+    if(pos) Serial.printf("Skipping ID3 tags, seeking to %d (0x%x)\n", pos, pos);
+    #endif
+
+    return pos;
+}
+
+// Sources for id3_parse()
+struct ID3SrcLoop {
+    AudioFileSourceLoop *src;
+    uint32_t read(void *data, uint32_t len) { return src->read(data, len); }
+    bool     skip(uint32_t len)             { return src->seek(len, SEEK_CUR); }
+};
+
+struct ID3SrcFile {
+    File     *f;
+    uint32_t read(void *data, uint32_t len) { return f->read((uint8_t *)data, len); }
+    bool     skip(uint32_t len)             { return f->seek(f->position() + len); }
+};
+
+// Skip ID3 tag, decode artist and track name for main loop;
+// returns start of audio data, to which the file is positioned
+static int32_t aud_readID3(AudioFileSourceLoop *src, uint32_t seq)
+{
+    ID3SrcLoop s = { src };
+    int32_t    pos;
+
+    // Invalidate before writing the strings: the fence keeps the
+    // writes below from becoming visible before the 0
+    audID3Seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if((pos = id3_parse(s, audID3artist, audID3track))) {
+        audID3Seq.store(seq, std::memory_order_release);
+    }
+    src->seek(pos, SEEK_SET);
+
+    return pos;
+}
+
+// Position music file at start of audio data. Without PA_DOID3TS,
+// the folder index told us where that is - unless the file was
+// replaced after the index was built.
+static int32_t aud_musicStart(AudioFileSourceLoop *src, const AudCmd &c)
+{
+    if(!(c.flags & PA_DOID3TS)) {
+        if(src->getSize() == c.size) {
+            src->seek(c.start, SEEK_SET);
+            return c.start;
+        }
+        audIdxStale.store(true, std::memory_order_relaxed);
+        int32_t pos = aud_readID3(src, c.seq);
+        // Replace artist/title from index even if there is no tag
+        audID3Seq.store(c.seq, std::memory_order_release);
         return pos;
     }
-    return 0;
+
+    return aud_readID3(src, c.seq);
 }
 
-static void setupLoopAndBegin(AudioFileSourceLoop *src, uint32_t flags)
+static void setupLoopAndBegin(AudioFileSourceLoop *src, AudioOutput *dst, uint32_t flags)
 {
     int32_t pos = 0;
     char    buf[10];
@@ -419,23 +1069,22 @@ static void setupLoopAndBegin(AudioFileSourceLoop *src, uint32_t flags)
 
     if(flags & PA_ISWAV) {
         src->setPlayLoop(false);
-        wav->begin(src, out);
+        wav->begin(src, dst);
     } else {
-        src->setPlayLoop(!!(flags & PA_LOOP));
         if(flags & PA_DOID3TS) {
             src->read((void *)buf, 10);
             pos = skipID3(buf);
             src->seek(pos, SEEK_SET);
         }
         src->setStartPos(pos);
-        mp3->begin(src, out);
+        src->setPlayLoop(!!(flags & PA_LOOP));
+        mp3->begin(src, dst);
     }
 }
 
-void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
+void play_file(const char *audio_file, uint32_t flags, float volumeFactor, uint32_t startPos, uint32_t fileSize)
 {
-    char    *id3;
-    int32_t pos = 0;
+    AudCmd  c;
     #ifdef TC_HAVEMQTT
     bool    mpWasActive = false;
     #endif
@@ -447,6 +1096,21 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
         if(!(flags & PA_SIGNAL)) return;
     }
 
+    // While the music player is active, (non-alarm) signals
+    // are mixed over the music instead of stopping it
+    if(canMixFx() && (flags & PA_SIGNAL) && !(flags & (PA_ALARM|PA_LOOP|PA_TCSEGS))) {
+        pwrNeedFullNow();
+        beepRunning = false;
+        sig_playing = flags & PA_SIGMASK;
+        if(audcmd_pack_play(c, audio_file, false, flags, getVolumeFact(volumeFactor, !!(flags & PA_CHECKNM)), 0)) {
+            c.voice = 1;
+            aud_post(c, true);
+        } else {
+            clear_sig_playing();
+        }
+        return;
+    }
+
     if(!(flags & PA_MUSIC)) {
         if(flags & PA_INTRMUS) {
             #ifdef TC_HAVEMQTT
@@ -502,14 +1166,59 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
 
     *id3artist = *id3track = 0;
 
-    out->SetGain(getVolume(), mutechannels);
+    if(audcmd_pack_play(c, audio_file, !!(flags & PA_TCSEGS), flags, getVolume(), mutechannels)) {
+        c.start = startPos;
+        c.size = fileSize;
+        aud_post(c, true);
+    } else {
+        key_playing = 0;
+        clear_sig_playing();
+        #ifdef TC_DBG_AUDIO
+        Serial.println("Audio file name too long");
+        #endif
+    }
+
+    #ifdef TC_HAVEMQTT
+    if(mpWasActive) mp_sendStatus();
+    #endif
+}
+
+// Runs in audio task
+static void aud_play(const AudCmd &c)
+{
+    uint32_t    flags = c.flags;
+    int32_t     pos = 0;
+    AudioOutput *dst = mvMain;
+
+    mvMain->SetGain(c.gain, c.mute);
+    wavKind = AR_WAV;
+
+    if(!(curMusic = !!(flags & PA_MUSIC))) {
+        gapArmed = false;
+    }
+
+    #ifdef TC_AUDIO_CACHE
+    // Looped sounds, music and TCC segments are never cached
+    if(!(flags & (PA_TCSEGS|PA_LOOP|PA_MUSIC|PA_DOID3TS))) {
+        const AudCacheEntry *e = audc_find(c.u.fn);
+        ttfsKind = e ? TTFS_HIT : TTFS_MISS;
+        ttfsStart = micros();
+        if(e && aud_play_cached(e, 0, AR_MP3)) {
+            return;
+        }
+        // Collect the samples while playing
+        if(cap->start(mvMain, c.u.fn, audc_maxSound())) {
+            dst = cap;
+        }
+    }
+    #endif
 
     if(flags & PA_TCSEGS) {
-        if(haveTCC && (mySD0->c = t) && mySD0->open_c(tcc_fn, (const int16_t *)audio_file)) {
+        if(haveTCC && (mySD0->c = t) && mySD0->open_c(tcc_fn, c.u.segs)) {
             if(flags & PA_ISWAV) {
-                wav->begin(mySD0, out);
+                wav->begin(mySD0, mvMain);
             } else {
-                mp3->begin(mySD0, out);
+                mp3->begin(mySD0, mvMain);
             }
         /*
          * Should we ever play signals or key sounds through segments, enable this. Not likely.
@@ -518,44 +1227,122 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
             clear_sig_playing();
         */
         }
-    } else if(haveSD && ((flags & PA_ALLOWSD) || FlashROMode) && mySD0->open(audio_file)) {
-        if((flags & PA_DOID3TS) && ((id3 = (char *)malloc(MAXID3LEN)))) {
-            id3[0] = 0;
-            mySD0->read((void *)id3, 10);
-            if((pos = skipID3(id3))) {
-                int Id3Size = pos <= MAXID3LEN ? pos : MAXID3LEN;
-                mySD0->read((void *)((char *)id3 + 10), Id3Size - 10);
-                decodeID3(id3artist, id3track, id3, Id3Size);
-            }
-            free(id3);
-            mySD0->setPlayLoop(!!(flags & PA_LOOP));
+    } else if(haveSD && ((flags & PA_ALLOWSD) || FlashROMode) && mySD0->open(c.u.fn)) {
+        if(flags & (PA_DOID3TS|PA_MUSIC)) {
+            pos = aud_musicStart(mySD0, c);
             mySD0->setStartPos(pos);
-            mySD0->seek(pos, SEEK_SET);
-            mp3->begin(mySD0, out);
+            mySD0->setPlayLoop(!!(flags & PA_LOOP));
+            if(mp3->begin(mySD0, dst) && curMusic && gapArmed) {
+                if(micros() - gapStart < AUD_GAP_MAX) gapKind = GAP_REOPEN;
+            }
+            gapArmed = false;
         } else {
-            setupLoopAndBegin(mySD0, flags|PA_DOID3TS);
+            setupLoopAndBegin(mySD0, dst, flags|PA_DOID3TS);
         }
         #ifdef TC_DBG_AUDIO
         Serial.println("Playing from SD");
         #endif
-    } else if(haveFS && myFS0->open(audio_file)) {
-        setupLoopAndBegin(myFS0, flags);
+    } else if(haveFS && myFS0->open(c.u.fn)) {
+        setupLoopAndBegin(myFS0, dst, flags);
         #ifdef TC_DBG_AUDIO
         Serial.println("Playing from flash FS");
         #endif
     } else {
-        key_playing = 0;
-        clear_sig_playing();
+        #ifdef TC_AUDIO_CACHE
+        cap->end(false);
+        ttfsKind = 0;
+        #endif
+        audEnd.store((AE_SEQ(c.seq) << 2) | AE_FAILED, std::memory_order_release);
         #ifdef TC_DBG_AUDIO
         Serial.println("Audio file not found");
         #endif
     }
+}
 
-    #ifdef TC_HAVEMQTT
-    if(mpWasActive) mp_sendStatus();
+/*
+ * Gapless music
+ */
+
+// Runs in audio task
+static void aud_next_cancel()
+{
+    if(nextState == NX_READY) mySD1->close();
+    nextState = 0;
+}
+
+// Runs in audio task: Current track is about to end; open the
+// next one and parse its ID3 tag now, not when the output needs
+// the next samples
+static void aud_next_prefetch()
+{
+    int32_t pos;
+
+    if(!mySD1->open(nextCmd.u.fn)) {
+        nextState = 0;
+        return;
+    }
+
+    pos = aud_musicStart(mySD1, nextCmd);
+    mySD1->setPlayLoop(false);
+    mySD1->setStartPos(pos);
+    nextState = NX_READY;
+
+    #ifdef TC_DBG_AUDIO
+    Serial.printf("Audio: Prefetched %s\n", nextCmd.u.fn);
     #endif
 }
 
+// Runs in audio task: Current track ended; continue with the 
+// prefetched one on the same voice. The voice was only told 
+// the sound ended, so what it buffered (and the output's DMA
+// buffers) keeps playing meanwhile.
+static bool aud_next_begin()
+{
+    AudioFileSourceSDLoop *sw = mySD0;
+
+    mySD0 = mySD1;
+    mySD1 = sw;
+    nextState = 0;
+
+    if(!mp3->begin(mySD0, mvMain)) {
+        mySD0->close();
+        return false;
+    }
+
+    return true;
+}
+
+// Runs in audio task
+static void aud_gap_record(int kind)
+{
+    uint32_t us = micros() - gapStart;
+
+    audGap.count[kind]++;
+    audGap.total[kind] += us;
+    if(us > audGap.max[kind]) audGap.max[kind] = us;
+
+    #ifdef TC_DBG_AUDIO
+    Serial.printf("Audio: Gap between tracks %u.%03ums (%s)\n", us / 1000, us % 1000, kind ? "prefetched" : "reopened");
+    #endif
+}
+
+int audio_report(char *buf, int bufLen)
+{
+    int l, n = 0;
+
+    for(int i = 1; i >= 0; i--) {
+        l = snprintf(buf + n, bufLen - n, "Music gap between tracks, %s: n %u, avg %u.%03ums, max %u.%03ums\n",
+                i ? "prefetched" : "reopened  ", audGap.count[i],
+                (audGap.count[i] ? audGap.total[i] / audGap.count[i] : 0) / 1000,
+                (audGap.count[i] ? audGap.total[i] / audGap.count[i] : 0) % 1000,
+                audGap.max[i] / 1000, audGap.max[i] % 1000);
+        if(l < 0 || l >= bufLen - n) return bufLen - 1;
+        n += l;
+    }
+
+    return n + AudioFileSourceLoop::raReport(buf + n, bufLen - n);
+}
+
 /*
  * Play specific sounds
  * 
@@ -564,12 +1351,24 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
 uint32_t play_keypad_sound(char key)
 {
     uint32_t kp = key_playing;
-    AudioFileSourceLoop *src = NULL;
+    AudCmd   c;
 
-    if(mpActive || sig_playing) return kp;
+    if(sig_playing) return kp;
+
+    // Muted with music on line-out
+    if(mpActive && !canMixFx()) return kp;
 
     pwrNeedFullNow();
 
+    // Mix over music
+    if(mpActive) {
+        beepRunning = false;
+        audcmd_pack(c, AC_KEYPAD, getVolumeFact(0.6f, true), 0, key - '0');
+        c.voice = 1;
+        aud_post(c, true);
+        return kp;
+    }
+
     stopAudio();    // Clears key_playing, sig_playing, id3
     beepRunning = playLineOut = false;
     setLineOut(playLineOut);
@@ -580,7 +1379,33 @@ uint32_t play_keypad_sound(char key)
     anaReadCount = 0;
     //appendFile = 0;
 
-    out->SetGain(getVolume(), 0);
+    audcmd_pack(c, AC_KEYPAD, getVolume(), 0, key - '0');
+    aud_post(c, true);
+
+    return kp;
+}
+
+// Runs in audio task
+static void aud_play_keypad(const AudCmd &c)
+{
+    AudioFileSourceLoop *src = NULL;
+    uint32_t stPos = (uint32_t)koffs[c.key] << 1;
+    uint32_t len = klens[c.key];
+
+    mvMain->SetGain(c.gain, 0);
+    wavKind = AR_WAV;
+
+    #ifdef TC_AUDIO_CACHE
+    const AudCacheEntry *e;
+    char kn[] = "#dtmf0";
+    kn[5] += c.key;
+    e = audc_find(kn);
+    ttfsKind = e ? TTFS_HIT : TTFS_MISS;
+    ttfsStart = micros();
+    if(e && aud_play_cached(e, 0, AR_WAV)) {
+        return;
+    }
+    #endif
 
     // open: 26ms
     if(FlashROMode && mySD0->open(dtmfFn)) src = mySD0;
@@ -588,9 +1413,14 @@ uint32_t play_keypad_sound(char key)
 
     if(src) {
         src->setPlayLoop(false);
-        wav->beginQuick(src, out, 1, 32000, (uint32_t)koffs[key-'0'] << 1, (uint32_t)klens[key-'0']);
+        #ifdef TC_AUDIO_CACHE
+        if((e = aud_cache_read(src, kn, stPos, len, 32000)) && aud_play_cached(e, 0, AR_WAV)) {
+            src->close();
+            return;
+        }
+        #endif
+        wav->beginQuick(src, mvMain, 1, 32000, stPos, len);
     }
-    return kp;
 }
 
 void play_hour_sound(int hour)
@@ -611,23 +1441,34 @@ void play_hour_sound(int hour)
 
 void play_beep()
 {
-    bool wavRunning = wav->isRunning();
+    bool busy = aud_busy();
+    AudCmd c;
     
-    if(muteBeep                               ||
-       mp3->isRunning()                       ||
-       (csf & (CSF_NM|CSF_OFF|CSF_AL|CSF_AE)) ||
-       mpActive                               ||
-       //appendFile                           ||
-       (wavRunning && !beepRunning)) {
+    if(muteBeep || (csf & (CSF_NM|CSF_OFF|CSF_AL|CSF_AE))) {
         return;
     }
 
-    pwrNeedFullNow();
+    // Mix over music, unless another effect is playing;
+    // muted with music on line-out
+    if(mpActive) {
+        if(!canMixFx()) return;
+        if((audRunning.load() & AR_FX) && !beepRunning) return;
+        pwrNeedFullNow();
+        audcmd_pack(c, AC_BEEP, getVolumeFact(beepLevel, false));
+        c.voice = 1;
+        aud_post(c, true);
+        beepRunning = true;
+        return;
+    }
 
-    if(wavRunning) {
-        wav->stop();
+    if((audRunning.load() & AR_MP3)           ||
+       //appendFile                           ||
+       (busy && !beepRunning)) {
+        return;
     }
 
+    pwrNeedFullNow();
+
     setLineOut(false);
     playLineOut = false;
 
@@ -637,16 +1478,187 @@ void play_beep()
     // (user might have turned the pot while no sound was played)
     rawVolIdx = 0;
     anaReadCount = 0;
-    out->SetGain(getVolume());
 
     key_playing = 0;
     clear_sig_playing();
     *id3artist = *id3track = 0;
 
-    myPM->open(data_beep_wav, data_beep_wav_len);
-    wav->beginQuick(myPM, out, 1, 32000, 44, data_beep_wav_len - 44);
-    beepRunning = true;
+    audcmd_pack(c, AC_BEEP, getVolume());
+    aud_post(c, true);
+    beepRunning = true;
+}
+
+// Runs in audio task
+static void aud_play_beep(const AudCmd &c)
+{
+    if(wav->isRunning()) {
+        wav->stop();
+    }
+
+    mvMain->SetGain(c.gain);
+
+    wavKind = AR_WAV;
+
+    myPM->open(data_beep_wav, data_beep_wav_len);
+    wav->beginQuick(myPM, mvMain, 1, 32000, 44, data_beep_wav_len - 44);
+}
+
+/*
+ * Effects voice: Sounds mixed over music
+ */
+
+// Runs in audio task
+static void aud_stop_fx()
+{
+    if(fxMp3->isRunning()) fxMp3->stop();
+    if(fxWav->isRunning()) fxWav->stop();
+    mvFx->flush();
+    #ifdef TC_AUDIO_CACHE
+    audc_setInUse(1, NULL);
+    #endif
+}
+
+// Runs in audio task
+static void aud_play_fx(const AudCmd &c)
+{
+    AudioFileSourceLoop *src = NULL;
+    #ifdef TC_AUDIO_CACHE
+    const AudCacheEntry *e;
+    char kn[] = "#dtmf0";
+    #endif
+
+    aud_stop_fx();
+
+    mvFx->SetGain(c.gain, 0);
+    fxWavKind = AR_WAV;
+
+    switch(c.cmd) {
+    case AC_BEEP:
+        fxPM->open(data_beep_wav, data_beep_wav_len);
+        if(fxWav->beginQuick(fxPM, mvFx, 1, 32000, 44, data_beep_wav_len - 44)) return;
+        break;
+    case AC_KEYPAD:
+        #ifdef TC_AUDIO_CACHE
+        kn[5] += c.key;
+        if((e = audc_find(kn)) && aud_play_cached(e, 1, AR_WAV)) return;
+        #endif
+        if(FlashROMode && fxSD0 && fxSD0->open(dtmfFn)) src = fxSD0;
+        else if(haveFS && fxFS0->open(dtmfFn)) src = fxFS0;
+        if(src) {
+            src->setPlayLoop(false);
+            if(fxWav->beginQuick(src, mvFx, 1, 32000, (uint32_t)koffs[c.key] << 1, (uint32_t)klens[c.key])) return;
+        }
+        break;
+    case AC_PLAY:
+        #ifdef TC_AUDIO_CACHE
+        if((e = audc_find(c.u.fn)) && aud_play_cached(e, 1, AR_MP3)) return;
+        #endif
+        if(fxSD0 && ((c.flags & PA_ALLOWSD) || FlashROMode) && fxSD0->open(c.u.fn)) src = fxSD0;
+        else if(haveFS && fxFS0->open(c.u.fn)) src = fxFS0;
+        if(src) {
+            char    buf[10];
+            int32_t pos;
+            buf[0] = 0;
+            src->setPlayLoop(false);
+            src->read((void *)buf, 10);
+            pos = skipID3(buf);
+            src->seek(pos, SEEK_SET);
+            src->setStartPos(pos);
+            if(fxMp3->begin(src, mvFx)) return;
+        }
+        break;
+    }
+
+    mvFx->flush();
+    audFxEnd.store((AE_SEQ(c.seq) << 2) | AE_FAILED, std::memory_order_release);
+}
+
+#ifdef TC_AUDIO_CACHE
+/*
+ * Sound cache
+ */
+
+// Play sound from cache on voice "vc"; "kind" is what we report
+// as running (AR_MP3 for cached mp3s, to keep the end-of-sound logic)
+static bool aud_play_cached(const AudCacheEntry *e, int vc, uint8_t kind)
+{
+    AudioGeneratorWAVP     *w  = vc ? fxWav : wav;
+    AudioFileSourcePROGMEM *pm = vc ? fxPM : myPM;
+
+    audc_setInUse(vc, e);
+    pm->open((const void *)e->pcm, e->bytes);
+    if(!w->beginQuick(pm, vc ? mvFx : mvMain, e->channels, e->rate, 0, e->bytes)) {
+        audc_setInUse(vc, NULL);
+        return false;
+    }
+    if(vc) fxWavKind = kind;
+    else   wavKind = kind;
+
+    #ifdef TC_DBG_AUDIO
+    Serial.printf("Playing %s from cache\n", e->name);
+    #endif
+
+    return true;
+}
+
+// Read raw 16 bit mono PCM into cache
+static const AudCacheEntry *aud_cache_read(AudioFileSourceLoop *src, const char *name, uint32_t pos, uint32_t len, uint32_t rate)
+{
+    int16_t *pcm;
+
+    if(len > audc_maxSound() || !(pcm = audc_alloc(len))) 
+        return NULL;
+
+    src->seek(pos, SEEK_SET);
+    if(src->read((void *)pcm, len) != len) {
+        audc_free(pcm);
+        return NULL;
+    }
+
+    return audc_insert(name, pcm, len, rate, 1);
+}
+
+// Decode frequently used sounds at boot. Must be called
+// before the audio task is started.
+static void aud_cache_prefill()
+{
+    static const char *pfs[] = {
+        "/enter.mp3", "/dooropen.mp3", "/doorclose.mp3", NULL
+    };
+    AudioFileSourceLoop *src = NULL;
+    char kn[] = "#dtmf0";
+
+    if(FlashROMode && mySD0->open(dtmfFn)) src = mySD0;
+    else if(haveFS && myFS0->open(dtmfFn)) src = myFS0;
+
+    if(src) {
+        src->setPlayLoop(false);
+        for(int i = 0; i < 10; i++) {
+            kn[5] = '0' + i;
+            aud_cache_read(src, kn, (uint32_t)koffs[i] << 1, klens[i], 32000);
+        }
+        src->close();
+    }
+
+    for(int i = 0; pfs[i]; i++) {
+        if(haveSD && mySD0->open(pfs[i])) src = mySD0;
+        else if(haveFS && myFS0->open(pfs[i])) src = myFS0;
+        else continue;
+        if(cap->start(NULL, pfs[i], audc_maxSound())) {
+            setupLoopAndBegin(src, cap, PA_DOID3TS);
+            while(mp3->isRunning() && cap->isActive()) {
+                if(!mp3->loop()) {
+                    mp3->stop();
+                    cap->end(true);
+                }
+            }
+            if(mp3->isRunning()) mp3->stop();
+            cap->end(false);
+        }
+        src->close();
+    }
 }
+#endif
 
 void play_key(int k, uint32_t preDTMFkp)
 {
@@ -808,6 +1820,11 @@ static float getRawVolume()
 }
 
 static float getVolume()
+{
+    return getVolumeFact(curVolFact, curChkNM);
+}
+
+static float getVolumeFact(float volFact, bool chkNM)
 {
     float vol_val = 1.0f;
 
@@ -822,10 +1839,10 @@ static float getVolume()
         if(vol_val == 0.0f) return vol_val;
     }
 
-    vol_val *= curVolFact;
+    vol_val *= volFact;
 
     // Reduce volume in night mode, if requested
-    if(curChkNM && (csf & CSF_NM)) {
+    if(chkNM && (csf & CSF_NM)) {
         vol_val *= 0.3f;
     }
 
@@ -859,6 +1876,13 @@ static void setLineOut(bool doLineOut)
     }
 }
 
+// Effects are mixed over music only if it plays through the
+// internal speaker; line-out switches the speaker amp off
+static bool canMixFx()
+{
+    return mpActive && !playLineOut;
+}
+
 /*
  * Helpers
  */
@@ -912,20 +1936,19 @@ int getSWVolFromHWVol()
 // Audio is really done (beep included)
 bool checkAudioDone()
 {
-    if(mp3->isRunning() || wav->isRunning()) return false;
-    return true;
+    return !aud_busy();
 }
 
 // Audio is free for use; beep is low prio and ignored
 bool checkAudioFree()
 {
-    if(mp3->isRunning() || (wav->isRunning() && !beepRunning)) return false;
+    if((audRunning.load() & AR_MP3) || (aud_busy() && !beepRunning)) return false;
     return true;
 }
 
 bool checkMP3Running()
 {
-    return mp3->isRunning();
+    return !!(audRunning.load() & AR_MP3);
 }
 
 uint32_t isSignalPlaying()
@@ -938,19 +1961,34 @@ bool isUISignalPlaying()
     return !!(sig_playing & PA_SIGNAL);
 }
 
-void stopAudio()
+// wait: Return only once the audio task has stopped, ie closed its
+// files on SD (see AudioFileSourceLoop.cpp)
+void stopAudio(bool wait)
 {
-    if(mp3->isRunning()) {
-        mp3->stop();
-    } else if(wav->isRunning()) {
-        wav->stop();
-    }
+    AudCmd c;
+
+    audcmd_pack(c, AC_STOP);
+    aud_post(c);
+    audNextSeq = 0;
+    if(wait) aud_waitDone();
+
     key_playing = 0;    
     clear_sig_playing();
     *id3artist = *id3track = 0;
     //appendFile = 0;   // Clear appended, stop means stop.
 }
 
+#ifdef TC_AUDIO_CACHE
+// Drop all cached sounds, after new sound files were installed
+void audio_cache_flush()
+{
+    AudCmd c;
+
+    audcmd_pack(c, AC_FLUSH);
+    aud_post(c);
+}
+#endif
+
 void stop_key()
 {
     if(key_playing) {
@@ -962,8 +2000,9 @@ void stopAlarm(bool force)
 {
     if(sig_playing & PA_ALARM) {
         if(!force && (sig_playing & PA_LOOP)) {
-            if(haveSD) mySD0->setPlayLoop(false);
-            if(haveFS) myFS0->setPlayLoop(false);
+            AudCmd c;
+            audcmd_pack(c, AC_NOLOOP);
+            aud_post(c);
         } else {
             stopAudio();
         }
@@ -995,164 +2034,6 @@ static void clear_sig_playing(int ranOut)
     sig_playing = 0;
 }
 
-/*
- * ID3 handling
- */
-
-static void copyId3String(char *src, char *dst, int tagSz, int maxChrs)
-{
-    uint16_t chr;
-    char c;
-    char *send = src + tagSz;
-    char *tend = dst + maxChrs;
-    char enc = *src++;
-
-    dst[0] = 0;
-
-    if(enc == 1) {
-        uint16_t be = *src++ << 8;
-        be |= *src++;
-        if(be == 0xfeff) enc = 2;
-        else if(be != 0xfffe) src -= 2;
-    }
-
-    switch(enc) {
-    case 0:        // ISO-8859-1
-        while(dst < tend && src < send) {
-            if(!*src) return;
-            c = *src++;
-            if(c >= ' ' && c <= 126)  {
-                if(c >= 'a' && c <= 'z') c &= ~0x20;
-                else if(c == 126) c = '-';  // 126 = ~ but displayed as °, so make it '-'
-                *dst++ = c;
-                *dst = 0;
-            }
-        }
-        break;
-    case 1:        // UTF-16LE
-    case 2:        // UTF-16BE
-        while(dst < tend && src < send) {
-            if(enc == 1) { chr = *src++; chr |= (*src++ << 8); }
-            else         { chr = *src++ << 8; chr |= *src++;   }
-            if(!chr) return;
-            if(chr >= 0xd800 && chr <= 0xdbff) {
-                src += 2;
-            } else if(chr >= ' ' && chr <= 126) {   
-                if(chr >= 'a' && chr <= 'z') chr &= ~0x20;
-                else if(chr == 126) chr = '-';  // 126 = ~ but displayed as °, so make it '-'
-                *dst++ = chr & 0xff;
-                *dst = 0;
-            }
-        }
-        break;
-    case 3:        // UTF-8
-        filterOutUTF8(src, dst, tagSz, maxChrs);
-        break;
-    }
-}
-
-static void decodeID3(char *artist, char *track, char *id3, int Id3Size)
-{
-    uint8_t rev = id3[3];
-    char *ptr  = id3 + 10;
-    char *eptr = id3 + Id3Size;
-    int  stopLoop = 0;
-    uint8_t tag0, tag1, tag2, tag3;
-    uint8_t badFlags = 0;
-    unsigned long tagSz, offSet;
-    char tFlags[2] = { 0, 0 };
-
-    *artist = *track = 0;
-
-    // Unsynchronizing not supported
-    if(id3[5] & 0x80) return;
-    
-    // Skip extended header
-    if(rev >= 3 && id3[5] & 0x40) {
-        if(Id3Size < 16) return;
-        if(rev == 3) {
-            ptr += 4;
-            ptr += ((id3[10] << 24) |
-                    (id3[11] << 16) |
-                    (id3[12] <<  8) |
-                    (id3[13]));
-        } else {
-            ptr += ((id3[10] << (24-3)) |
-                    (id3[11] << (16-2)) |
-                    (id3[12] << (8-1))  |
-                    (id3[13]));
-        }
-        if(ptr >= eptr) return;
-    }
-
-    while((stopLoop != 3) && ptr < (eptr - 4)) {
-        tag0 = *ptr++;
-        tag1 = *ptr++;
-        tag2 = *ptr++;
-        tag3 = (rev == 2) ? 0 : *ptr++;
-    
-        // Quit when we are in padding
-        if(!(tag0 | tag1 | tag2 | tag3)) return;
-        
-        if(rev == 2) {
-
-            if(ptr > eptr - 3) return;
-
-            tagSz = ((ptr[0] << 16) |
-                     (ptr[1] <<  8) |
-                     (ptr[2]));
-
-            ptr += 3;
-          
-        } else {
-            
-            if(ptr > eptr - 6) return;
-
-            if(rev == 3) {
-                tagSz = ((ptr[0] << 24) |
-                         (ptr[1] << 16) |
-                         (ptr[2] <<  8) |
-                         (ptr[3]));
-                badFlags = 0x80 + 0x40;         // Compression/Encryption
-            } else {
-                tagSz = ((ptr[0] << (24-3)) |
-                         (ptr[1] << (16-2)) |
-                         (ptr[2] << (8-1))  |
-                         (ptr[3]));
-                badFlags = 0x08 + 0x04 + 0x02;  // Compression/Encryption/Unsync
-            }
-            
-            tFlags[0] = ptr[4];
-            tFlags[1] = ptr[5];
-
-            ptr += 6;
-
-        }
-
-        if(ptr + tagSz > eptr) return;
-
-        // Compression & unsynchronization not supported
-        if(!(tFlags[1] & badFlags) && (tag0 == 'T')) {
-            // Check for data length indicator despite no other flags
-            // Should not happen; we ignore it if it is there
-            offSet = (rev == 4 && tFlags[1] & 0x01) ? 4 : 0;
-            if((rev == 2 && tag1 == 'T' && tag2 == '2') ||
-               (rev != 2 && tag1 == 'I' && tag2 == 'T' && tag3 == '2')) {
-                // Copy song title
-                copyId3String(ptr+offSet, track, tagSz-offSet, 15);
-                stopLoop |= 1;
-            } else if((rev == 2 && tag1 == 'P' && tag2 == '1') ||
-                      (rev != 2 && tag1 == 'P' && tag2 == 'E' && tag3 == '1')) {
-                // Copy artist
-                copyId3String(ptr+offSet, artist, tagSz-offSet, 15);
-                stopLoop |= 2;
-            }
-        }
-
-        ptr += tagSz;
-    }
-}
-
 /*
  * The Music Player
  */
@@ -1169,6 +2050,12 @@ void mp_init(bool isSetup)
     }
 
     mpCurrIdx = aud_state.curTrack = aud_state.maxMusic = 0;
+    audNextSeq = 0;
+    mpIdxCount = 0;
+
+    // The caller stopped the music; the renamer must not touch a
+    // track the audio task still has open (or prefetched)
+    aud_waitDone();
     
     if(haveSD) {
         #ifdef TC_DBG_MP
@@ -1180,8 +2067,13 @@ void mp_init(bool isSetup)
         mp_buildFileName(fnbuf, 0);
         if(SD.exists(fnbuf)) {
             csf &= ~CSF_NOMUSIC;
-            
-            aud_state.maxMusic = mp_findMaxNum();
+
+            if((mpIdxCount = mp_idxLoad())) {
+                aud_state.maxMusic = mpIdxCount - 1;
+            } else {
+                aud_state.maxMusic = mp_findMaxNum();
+                mpIdxCount = mp_idxBuild(isSetup, aud_state.maxMusic);
+            }
             #ifdef TC_DBG_MP
             Serial.printf("MusicPlayer: last file num %d\n", aud_state.maxMusic);
             #endif
@@ -1250,6 +2142,170 @@ static int mp_findMaxNum()
     return i;
 }
 
+/*
+ * Music folder index
+ * 
+ * Lists the tracks of the current folder with their size, where
+ * the audio data starts, and artist/title from the ID3 tag; this
+ * saves probing for the number of tracks, and reading/parsing the
+ * ID3 tags while playing.
+ * 
+ * FAT keeps no usable date or size for folders. The index is
+ * therefore tied to the DONE file, which the renamer (re)writes
+ * after it changed the folder (and it removes the index before
+ * doing so). The track count is double-checked by probing for the
+ * last track and the one after it. The audio task compares each
+ * file's size with its entry, and ignores the entry (and has the
+ * index dropped) if they differ.
+ */
+
+static void mp_idxFileName(char *fnbuf)
+{
+    sprintf(fnbuf, "/music%1d%s", musFolderNum, mpidxfn);
+}
+
+static uint32_t mp_idxDoneTime()
+{
+    char     fnbuf[32];
+    uint32_t dt = 0;
+
+    sprintf(fnbuf, "/music%1d%s", musFolderNum, tcdrdone);
+    File f = SD.open(fnbuf);
+    if(f) {
+        dt = (uint32_t)f.getLastWrite();
+        f.close();
+    }
+    return dt;
+}
+
+// Returns number of tracks, or 0 if there is no valid index
+static int mp_idxLoad()
+{
+    char     fnbuf[32];
+    MpIdxHdr hdr;
+    bool     ok;
+
+    mp_idxFileName(fnbuf);
+    File f = SD.open(fnbuf);
+    if(!f) return 0;
+
+    ok = (f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr)) &&
+         hdr.magic == MPIDX_MAGIC && hdr.ver == MPIDX_VER &&
+         hdr.count >= 1 && hdr.count <= 1000 &&
+         f.size() == sizeof(hdr) + hdr.count * sizeof(MpIdxEnt);
+    f.close();
+
+    if(!ok || hdr.doneTime != mp_idxDoneTime() ||
+       !mp_checkForFile(hdr.count - 1) || mp_checkForFile(hdr.count)) {
+        #ifdef TC_DBG_MP
+        Serial.printf("MusicPlayer: %s invalid\n", fnbuf);
+        #endif
+        return 0;
+    }
+
+    #ifdef TC_DBG_MP
+    Serial.printf("MusicPlayer: Using %s, %d tracks\n", fnbuf, hdr.count);
+    #endif
+
+    return hdr.count;
+}
+
+// Read ID3 tag of all tracks 0-maxNum and write index; 
+// returns number of tracks, or 0 if index could not be written
+static int mp_idxBuild(bool isSetup, int maxNum)
+{
+    char     fnbuf[32];
+    MpIdxHdr hdr;
+    MpIdxEnt ent;
+    bool     ok = true;
+
+    if(maxNum < 0) return 0;
+
+    mp_idxFileName(fnbuf);
+    File f = SD.open(fnbuf, FILE_WRITE);
+    if(!f) return 0;
+
+    headLineShown = false;
+    blinker = true;
+    renNow1 = renNow2 = millis();
+
+    hdr.magic = MPIDX_MAGIC;
+    hdr.ver = MPIDX_VER;
+    hdr.count = maxNum + 1;
+    hdr.doneTime = mp_idxDoneTime();
+    ok = (f.write((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr));
+
+    for(int i = 0; ok && i <= maxNum; i++) {
+
+        mpren_looper(isSetup, true, maxNum - i + 1);
+
+        memset((void *)&ent, 0, sizeof(ent));
+        mp_buildFileName(fnbuf, i);
+        File mf = SD.open(fnbuf);
+        if(mf) {
+            ID3SrcFile src = { &mf };
+            ent.size = mf.size();
+            ent.start = id3_parse(src, ent.artist, ent.title);
+            mf.close();
+        }
+        ok = (f.write((uint8_t *)&ent, sizeof(ent)) == sizeof(ent));
+    }
+
+    f.close();
+
+    if(headLineShown) {
+        destinationTime.showTextDirect("");
+        presentTime.showTextDirect("");
+        departedTime.showTextDirect("");
+    }
+
+    if(!ok) {
+        mp_idxFileName(fnbuf);
+        SD.remove(fnbuf);
+        return 0;
+    }
+
+    #ifdef TC_DBG_MP
+    Serial.printf("MusicPlayer: Built folder index, %d tracks\n", maxNum + 1);
+    #endif
+
+    return maxNum + 1;
+}
+
+static bool mp_idxRead(int num, MpIdxEnt *ent)
+{
+    char fnbuf[32];
+    bool ok;
+
+    if(num >= mpIdxCount) return false;
+
+    mp_idxFileName(fnbuf);
+    File f = SD.open(fnbuf);
+    if(!f) return false;
+    ok = f.seek(sizeof(MpIdxHdr) + num * sizeof(MpIdxEnt)) &&
+         (f.read((uint8_t *)ent, sizeof(*ent)) == sizeof(*ent));
+    f.close();
+
+    return ok;
+}
+
+// A track was replaced after the index was built: Stop using
+// the index, and remove it so it is rebuilt on next mp_init()
+static void mp_idxDrop()
+{
+    char fnbuf[32];
+
+    if(!mpIdxCount) return;
+
+    mpIdxCount = 0;
+    mp_idxFileName(fnbuf);
+    SD.remove(fnbuf);
+
+    #ifdef TC_DBG_MP
+    Serial.printf("MusicPlayer: %s stale, removed\n", fnbuf);
+    #endif
+}
+
 void mp_makeShuffle(bool enable)
 {
     int numMsx = aud_state.maxMusic + 1;
@@ -1307,7 +2363,10 @@ bool mp_stop(bool forceStatus)
     bool ret = mpActive;
     
     if(mpActive) {
-        mp3->stop();
+        AudCmd c;
+        audcmd_pack(c, AC_STOPMP3);
+        aud_post(c);
+        audNextSeq = 0;
         mpActive = false;
         *id3artist = *id3track = 0;
         #ifdef TC_HAVEMQTT
@@ -1376,13 +2435,29 @@ int mp_gotonum(int num, bool forcePlay)
 
 static bool mp_play_int(bool force)
 {
-    char fnbuf[20];
+    char     fnbuf[20];
+    uint32_t ps = audPlaySeq;
+    MpIdxEnt ent;
+    bool     haveEnt;
 
     mp_buildFileName(fnbuf, playList[mpCurrIdx]);
-    if(SD.exists(fnbuf)) {
-        if(force) play_file(fnbuf, PA_MUSIC|PA_LINEOUT|PA_DOID3TS|PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL);
+    if((haveEnt = mp_idxRead(playList[mpCurrIdx], &ent)) || SD.exists(fnbuf)) {
+        if(force) {
+            if(haveEnt) {
+                play_file(fnbuf, MP_PLAYFLAGS & ~PA_DOID3TS, 1.0f, ent.start, ent.size);
+                if(audPlaySeq != ps) {
+                    memcpy(id3artist, ent.artist, sizeof(ent.artist));
+                    memcpy(id3track, ent.title, sizeof(ent.title));
+                }
+            } else {
+                play_file(fnbuf, MP_PLAYFLAGS);
+            }
+        }
         mpActive = force;
         aud_state.curTrack = playList[mpCurrIdx];
+        if(force && audPlaySeq != ps) {
+            mp_queueNext();
+        }
         #ifdef TC_HAVEMQTT
         mp_sendStatus();
         #endif
@@ -1391,6 +2466,42 @@ static bool mp_play_int(bool force)
     return false;
 }
 
+// Tell the audio task which track follows the current one
+static void mp_queueNext()
+{
+    char     fnbuf[20];
+    int      idx = mpCurrIdx;
+    AudCmd   c;
+    MpIdxEnt ent;
+    bool     haveEnt;
+
+    audNextSeq = 0;
+
+    do {
+        idx++;
+        if(idx > aud_state.maxMusic) idx = 0;
+        mp_buildFileName(fnbuf, playList[idx]);
+        if((haveEnt = mp_idxRead(playList[idx], &ent)) || SD.exists(fnbuf)) {
+            if(audcmd_pack_play(c, fnbuf, false, MP_PLAYFLAGS & ~(haveEnt ? PA_DOID3TS : 0), 0.0f, 0)) {
+                c.cmd = AC_NEXT;
+                if(haveEnt) {
+                    c.start = ent.start;
+                    c.size = ent.size;
+                    memcpy(mpNextArtist, ent.artist, sizeof(ent.artist));
+                    memcpy(mpNextTitle, ent.title, sizeof(ent.title));
+                } else {
+                    *mpNextArtist = *mpNextTitle = 0;
+                }
+                aud_post(c);
+                audNextSeq = c.seq;
+                mpNextIdx = idx;
+                mpNextTrack = playList[idx];
+            }
+            return;
+        }
+    } while(idx != mpCurrIdx);
+}
+
 int mp_get_currently_playing()
 {
     if((csf & CSF_NOMUSIC) || !mpActive)
@@ -1581,18 +2692,9 @@ static bool mp_renameFilesInDir(bool isSetup)
 {
     char fnbuf[20];
     char fnbuf3[32];
-    char **a, **d;
-    char *c;
+    MpRenCtx x;
     int count = 0;
-    int fileNum = 0;
-    int strLength;
     int nameOffs = 8;
-    int allocBufIdx = 0;
-    const unsigned long bufSizes[8] = {
-        16384, 16384, 8192, 8192, 8192, 8192, 8192, 4096 
-    };
-    char *bufs[8] = { NULL };
-    unsigned long sz, bufSize;
     bool stopLoop = false;
     bool hls = false;
 #ifdef HAVE_GETNEXTFILENAME
@@ -1624,6 +2726,11 @@ static bool mp_renameFilesInDir(bool isSetup)
         return false;
     }
 
+    // Folder index is outdated from here on
+    strcpy(fnbuf3 + 7, mpidxfn);
+    if(SD.exists(fnbuf3)) SD.remove(fnbuf3);
+    strcpy(fnbuf3 + 7, tcdrdone);
+
     // Open folder and check if it is actually a folder
     File origin = SD.open(fnbuf);
     if(!origin) {
@@ -1633,23 +2740,19 @@ static bool mp_renameFilesInDir(bool isSetup)
         origin.close();
         return false;
     }
-        
-    // Allocate pointer array
-    if(!(a = (char **)malloc(1000*sizeof(char *)))) {
-        origin.close();
-        return false;
-    }
 
-    // Allocate (first) buffer for file names
-    if(!(bufs[0] = (char *)malloc(bufSizes[0]))) {
+    memset((void *)&x, 0, sizeof(x));
+        
+    // Allocate entry array and (first) buffer for file names
+    if(!(x.a = (MpSortEnt *)malloc(MPREN_MAXFILES * sizeof(MpSortEnt))) ||
+       !(x.bufs[0] = (char *)malloc(mprenBufSizes[0]))) {
         origin.close();
-        free(a);
+        if(x.a) free(x.a);
         return false;
     }
 
-    c = bufs[0];
-    bufSize = bufSizes[0];
-    d = a;
+    x.c = x.bufs[0];
+    x.bufSize = mprenBufSizes[0];
 
     // Loop through all files in folder
 
@@ -1669,86 +2772,29 @@ static bool mp_renameFilesInDir(bool isSetup)
         mpren_looper(isSetup, true, 0);
 
 #ifdef HAVE_GETNEXTFILENAME
+        const char *fn = isDir ? NULL : fileName.c_str();
+#else
+        const char *fn = file.isDirectory() ? NULL : file.name();
+#endif
 
-        if(!isDir) {
-            const char *fn = fileName.c_str();
-            strLength = strlen(fn);
-            sz = strLength - nameOffs + 1;
-            if((sz > bufSize) && (allocBufIdx < 7)) {
-                allocBufIdx++;
-                if(!(bufs[allocBufIdx] = (char *)malloc(bufSizes[allocBufIdx]))) {
-                    #ifdef TC_DBG_MP
-                    Serial.printf("%sFailed to allocate additional sort buffer\n", funcName);
-                    #endif
-                } else {
-                    #ifdef TC_DBG_MP
-                    Serial.printf("%sAllocated additional sort buffer\n", funcName);
-                    #endif
-                    c = bufs[allocBufIdx];
-                    bufSize = bufSizes[allocBufIdx];
-                }
-            }
-            if((strLength < 256) && (sz <= bufSize)) {
-                if(!mpren_checkFN(fn + nameOffs)) {
-                    *d++ = c;
-                    strcpy(c, fn + nameOffs);
-                    #ifdef TC_DBG_MP
-                    Serial.printf("%sAdding '%s'\n", funcName, c);
-                    #endif
-                    c += sz;
-                    bufSize -= sz;
-                    fileNum++;
-                }
-            } else if(sz > bufSize) {
-                stopLoop = true;
+        if(fn && (strlen(fn) < 256) && !mpren_checkFN(fn + nameOffs)) {
+            if(mpren_add(&x, fn + nameOffs)) {
                 #ifdef TC_DBG_MP
-                Serial.printf("%sSort buffer(s) exhausted, remaining files ignored\n", funcName);
+                Serial.printf("%sAdding '%s'\n", funcName, fn + nameOffs);
                 #endif
-            }
-        }
-        
-#else // --------------
-
-        if(!file.isDirectory()) {
-            strLength = strlen(file.name());
-            sz = strLength - nameOffs + 1;
-            if((sz > bufSize) && (allocBufIdx < 7)) {
-                allocBufIdx++;
-                if(!(bufs[allocBufIdx] = (char *)malloc(bufSizes[allocBufIdx]))) {
-                    #ifdef TC_DBG_MP
-                    Serial.printf("%sFailed to allocate additional sort buffer\n", funcName);
-                    #endif
-                } else {
-                    #ifdef TC_DBG_MP
-                    Serial.printf("%sAllocated additional sort buffer\n", funcName);
-                    #endif
-                    c = bufs[allocBufIdx];
-                    bufSize = bufSizes[allocBufIdx];
-                }
-            }
-            if((strLength < 256) && (sz <= bufSize)) {
-                if(!mpren_checkFN(file.name() + nameOffs)) {
-                    *d++ = c;
-                    strcpy(c, file.name() + nameOffs);
-                    #ifdef TC_DBG_MP
-                    Serial.printf("%sAdding '%s'\n", funcName, c);
-                    #endif
-                    c += sz;
-                    bufSize -= sz;
-                    fileNum++;
-                }
-            } else if(sz > bufSize) {
+            } else {
                 stopLoop = true;
                 #ifdef TC_DBG_MP
                 Serial.printf("%sSort buffer(s) exhausted, remaining files ignored\n", funcName);
                 #endif
             }
         }
+
+#ifndef HAVE_GETNEXTFILENAME
         file.close();
-        
 #endif
         
-        if(fileNum >= 1000) stopLoop = true;
+        if(x.fileNum >= MPREN_MAXFILES) stopLoop = true;
 
         if(!stopLoop) {
             #ifdef HAVE_GETNEXTFILENAME
@@ -1762,18 +2808,15 @@ static bool mp_renameFilesInDir(bool isSetup)
     origin.close();
 
     #ifdef TC_DBG_MP
-    Serial.printf("%s%d files to process\n", funcName, fileNum);
+    Serial.printf("%s%d files to process, %d runs on SD\n", funcName, x.fileNum, x.runs);
     #endif
 
     // Sort file names, and rename
 
-    if(fileNum) {
+    if(x.fileNum) {
 
         char fnbuf2[256];
         
-        // Sort file names
-        mpren_insertionSort(a, fileNum);
-    
         sprintf(fnbuf2, "/music%1d/", musFolderNum);
         strcpy(fnbuf, fnbuf2);
 
@@ -1790,36 +2833,30 @@ static bool mp_renameFilesInDir(bool isSetup)
             headLineShown = false;
         }
 
-        for(int i = 0; i < fileNum && count <= 999; i++) {
-            
-            mpren_looper(isSetup, false, fileNum - i);
-
-            sprintf(fnbuf + 8, "%03d.mp3", count);
-            strcpy(fnbuf2 + 8, a[i]);
-            if(!SD.rename(fnbuf2, fnbuf)) {
-                bool done = false;
-                while(!done) {
-                    count++;
-                    if(count <= 999) {
-                        sprintf(fnbuf + 8, "%03d.mp3", count);
-                        done = SD.rename(fnbuf2, fnbuf);
-                    } else {
-                        done = true;
-                    }
-                }
+        if(!x.runs) {
+
+            mpren_sort(&x);
+
+            for(int i = 0; i < x.n && count <= 999; i++) {
+                mpren_looper(isSetup, false, x.n - i);
+                count = mpren_rename(fnbuf, fnbuf2, x.a[i].name, count);
             }
-            #ifdef TC_DBG_MP
-            Serial.printf("%sRenamed '%s' to '%s'\n", funcName, fnbuf2, fnbuf);
-            #endif
-            
-            count++;
+
+        } else {
+
+            // Names did not fit in memory: Sort the last chunk
+            // to SD, too, and merge the sorted runs from there
+            if(x.n && mpren_writeRun(&x)) x.runs++;
+
+            mpren_mergeRuns(&x, isSetup, fnbuf, fnbuf2, count);
+
         }
     }
 
-    for(int i = 0; i <= allocBufIdx; i++) {
-        if(bufs[i]) free(bufs[i]);
+    for(int i = 0; i < 8; i++) {
+        if(x.bufs[i]) free(x.bufs[i]);
     }
-    free(a);
+    free(x.a);
 
     // Write "DONE" file
     if((origin = SD.open(fnbuf3, FILE_WRITE))) {
@@ -1841,43 +2878,164 @@ static bool mp_renameFilesInDir(bool isSetup)
 }
 
 /*
- * Insertion Sort for file names
+ * Name collection and sorting for the renamer
+ * 
+ * Names are collected in a few buffers, allocated as needed. If
+ * heap runs out before all names are collected, what we have is 
+ * sorted and written to a "run" file on the SD, and the buffers
+ * are reused; in the end, the runs are merged while renaming.
  */
 
-static unsigned char mpren_toUpper(char a)
+// Add name; returns false if there is no space left
+static bool mpren_add(MpRenCtx *x, const char *name)
+{
+    unsigned long sz = strlen(name) + 1;
+
+    while(sz > x->bufSize) {
+        int i = x->bufIdx + 1;
+        if(i < 8 && (x->bufs[i] || (x->bufs[i] = (char *)malloc(mprenBufSizes[i])))) {
+            x->bufIdx = i;
+        } else if(x->n && x->runs < MPREN_MAXRUNS && mpren_writeRun(x)) {
+            x->runs++;
+            x->n = 0;
+            x->bufIdx = 0;
+        } else {
+            return false;
+        }
+        x->c = x->bufs[x->bufIdx];
+        x->bufSize = mprenBufSizes[x->bufIdx];
+    }
+
+    strcpy(x->c, name);
+    mpsort_setEnt(&x->a[x->n++], x->c);
+    x->c += sz;
+    x->bufSize -= sz;
+    x->fileNum++;
+
+    return true;
+}
+
+static void mpren_sort(MpRenCtx *x)
 {
-    if(a >= 'a' && a <= 'z')
-        a &= ~0x20;
+    MpSortEnt *tmp = (MpSortEnt *)malloc(x->n * sizeof(MpSortEnt));
+
+    mpsort_sort(x->a, tmp, x->n);
 
-    return (unsigned char)a;
+    if(tmp) free(tmp);
 }
 
-static bool mpren_strGT(const char *a, const char *b)
+static void mpren_runFileName(char *fnbuf, int run)
 {
-    int aa = strlen(a);
-    int bb = strlen(b);
-    int cc = aa < bb ? aa : bb;
+    sprintf(fnbuf, "/_tcdsrt%d.tmp", run);
+}
+
+// Sort current chunk and write it to run file x->runs
+static bool mpren_writeRun(MpRenCtx *x)
+{
+    char fnbuf[20];
+    bool ok = true;
 
-    for(int i = 0; i < cc; i++) {
-        unsigned char aaa = mpren_toUpper(*a);
-        unsigned char bbb = mpren_toUpper(*b);
-        if(aaa < bbb) return false;
-        if(aaa > bbb) return true;
-        a++; b++;
+    mpren_sort(x);
+
+    mpren_runFileName(fnbuf, x->runs);
+    File f = SD.open(fnbuf, FILE_WRITE);
+    if(!f) return false;
+
+    for(int i = 0; ok && i < x->n; i++) {
+        uint8_t l = strlen(x->a[i].name);
+        ok = (f.write(&l, 1) == 1) && (f.write((uint8_t *)x->a[i].name, l) == l);
     }
+    f.close();
 
-    return false;
+    if(!ok) SD.remove(fnbuf);
+
+    return ok;
 }
 
-static void mpren_insertionSort(char **a, int n)
+static bool mpren_readRun(MpRenRun *r)
 {
-    for(int i = 1; i < n; i++) {
-        char *k = a[i];
-        int j = i - 1;
-        while(j >= 0 && mpren_strGT(a[j], k)) {
-            a[j+1] = a[j];
-            j--;
+    uint8_t l;
+
+    if(r->f.read(&l, 1) != 1 || r->f.read((uint8_t *)r->name, l) != l) {
+        r->f.close();
+        return false;
+    }
+    r->name[l] = 0;
+    mpsort_setEnt(&r->e, r->name);
+
+    return true;
+}
+
+static void mpren_mergeRuns(MpRenCtx *x, bool isSetup, char *fnbuf, char *fnbuf2, int count)
+{
+    char    fnbuf4[20];
+    MpRenRun *r = new (std::nothrow) MpRenRun[x->runs];
+    int     left = x->fileNum;
+
+    if(!r) {
+        // Out of memory: Leave the files unnumbered, but
+        // do not leave the run files behind
+        for(int i = 0; i < x->runs; i++) {
+            mpren_runFileName(fnbuf4, i);
+            SD.remove(fnbuf4);
+        }
+        #ifdef TC_DBG_MP
+        Serial.println("MusicPlayer/Renamer: Failed to allocate runs");
+        #endif
+        return;
+    }
+
+    for(int i = 0; i < x->runs; i++) {
+        mpren_runFileName(fnbuf4, i);
+        r[i].f = SD.open(fnbuf4);
+        r[i].valid = r[i].f && mpren_readRun(&r[i]);
+    }
+
+    while(count <= 999) {
+        int m = -1;
+        // Lowest name; on equal names, the earlier run (keeps 
+        // order of directory)
+        for(int i = 0; i < x->runs; i++) {
+            if(r[i].valid && (m < 0 || mpsort_cmp(&r[i].e, &r[m].e) < 0)) m = i;
+        }
+        if(m < 0) break;
+
+        mpren_looper(isSetup, false, left > 0 ? left-- : 0);
+        count = mpren_rename(fnbuf, fnbuf2, r[m].name, count);
+
+        r[m].valid = mpren_readRun(&r[m]);
+    }
+
+    for(int i = 0; i < x->runs; i++) {
+        if(r[i].f) r[i].f.close();
+        mpren_runFileName(fnbuf4, i);
+        SD.remove(fnbuf4);
+    }
+
+    delete [] r;
+}
+
+// Rename "name" in the music folder to number count, or the
+// next free number after it; returns the number after that.
+static int mpren_rename(char *fnbuf, char *fnbuf2, const char *name, int count)
+{
+    sprintf(fnbuf + 8, "%03d.mp3", count);
+    strcpy(fnbuf2 + 8, name);
+    if(!SD.rename(fnbuf2, fnbuf)) {
+        bool done = false;
+        while(!done) {
+            count++;
+            if(count <= 999) {
+                sprintf(fnbuf + 8, "%03d.mp3", count);
+                done = SD.rename(fnbuf2, fnbuf);
+            } else {
+                done = true;
+            }
         }
-        a[j + 1] = k;
     }
+    #ifdef TC_DBG_MP
+    Serial.printf("MusicPlayer/Renamer: Renamed '%s' to '%s'\n", fnbuf2, fnbuf);
+    #endif
+    
+    return count + 1;
 }
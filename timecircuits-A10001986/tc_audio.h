@@ -88,7 +88,7 @@ void  audio_loop_quick();
 
 //void     append_file(const char *audio_file, uint32_t flags, float volumeFactor = 1.0f);
 
-void     play_file(const char *audio_file, uint32_t flags, float volumeFactor = 1.0f);
+void     play_file(const char *audio_file, uint32_t flags, float volumeFactor = 1.0f, uint32_t startPos = 0, uint32_t fileSize = 0);
 uint32_t play_keypad_sound(char key);
 void     play_hour_sound(int hour);
 void     play_beep();
@@ -111,10 +111,15 @@ bool     checkMP3Running();
 uint32_t isSignalPlaying();
 bool     isUISignalPlaying();
 
-void  stopAudio();
+void  stopAudio(bool wait = false);
 void  stop_key();
 void  stopAlarm(bool force);
 
+#ifdef TC_AUDIO_CACHE
+void  audio_cache_flush();
+#endif
+int   audio_report(char *buf, int bufLen);
+
 void  mp_init(bool isSetup = false);
 void  mp_play(bool forcePlay = true);
 bool  mp_stop(bool forceStatus = false);
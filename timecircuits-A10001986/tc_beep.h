@@ -54,8 +54,9 @@
 
 // Copying this from flash to sram takes 1ms
 // Copying this from sram to sram takes 0.1ms
+// Hence it is played in place; needs 16 bit alignment for that.
 
-const unsigned char data_beep_wav[] = {
+const unsigned char data_beep_wav[] __attribute__((aligned(4))) = {
   0x52, 0x49, 0x46, 0x46, 0xa8, 0x90, 0x00, 0x00, 0x57, 0x41, 0x56, 0x45,
   0x66, 0x6d, 0x74, 0x20, 0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00,
   0x00, 0x7d, 0x00, 0x00, 0x00, 0xfa, 0x00, 0x00, 0x02, 0x00, 0x10, 0x00,
@@ -90,6 +90,26 @@
 // Uncomment for HomeAssistant MQTT protocol support
 #define TC_HAVEMQTT
 
+// Uncomment to keep short sounds (keypad, "enter", doors, etc) decoded in
+// memory after first use, instead of re-reading and re-decoding them every
+// time. Uses PSRAM if present; without PSRAM, the cache is small.
+#define TC_AUDIO_CACHE
+
+// Uncomment to keep the I2S output running between sounds (feeding it
+// silence), instead of setting it up anew for every sound
+#define TC_AUD_KEEPI2S
+
+// Uncomment to clock the i2c bus at 400kHz for transactions with the
+// displays, the RTC and the GPS receiver. The keypad, the rotary 
+// encoders, the speedo and the sensors stay at 100kHz; a device that
+// keeps failing at 400kHz is switched back to 100kHz.
+#define TC_I2C_FASTCLK
+
+// Uncomment if the keypad's PCF8574 has its INT output connected to 
+// KEYPAD_INT_PIN (not the case on stock boards). The keypad matrix is 
+// then only scanned after a key was touched, instead of every 20ms.
+//#define TC_KEYPAD_INT
+
 // Uncomment to allow "persistent time travels" only if an SD card is
 // present and option "Save secondary setting to SD" is checked. 
 // Saving clock data to ESP32 Flash memory can cause delays of up to 
@@ -150,8 +170,13 @@
 //#define TC_DBG_TT             // Time travel
 //#define TC_DBG_GPS            // GPS-related
 //#define TC_DBG_GEN            // Generic
+//#define TC_DBG_SCHED          // Scheduler statistics
 #endif
 
+// Loop profiler; reports on Serial, at /prof in the Config Portal
+// and through MQTT (command PROF_REPORT)
+//#define TC_PROFILER
+
 /*************************************************************************
  ***                             Sanitation                            ***
  *************************************************************************/
@@ -228,6 +253,8 @@
 #define EXTERNAL_TIMETRAVEL_IN_PIN  27  // Externally triggered TT (input)
 #define EXTERNAL_TIMETRAVEL_OUT_PIN 14  // TT trigger output
 
+#define KEYPAD_INT_PIN      4      // PCF8574 INT (optional, see TC_KEYPAD_INT)
+
 /*************************************************************************
  ***             Display IDs (Do not change, used as index)            ***
  *************************************************************************/
@@ -0,0 +1,373 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * I2C bus manager
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * All I2C traffic after boot goes through here: Callers post 
+ * transactions to a queue (tc_i2cq.h), which is worked off by 
+ * the I2C task in order of device priority.
+ * 
+ * Wire itself is blocking; the I2C task runs on loop()'s core 
+ * at a higher priority, and while it waits for the hardware, 
+ * loop() runs on. Writes to the displays are therefore posted
+ * and forgotten (i2c_write); everything that needs a result, or
+ * whose timing matters, waits for its transaction (i2c_xfer).
+ * 
+ * Device probing at boot uses Wire directly; the ESP32 core's
+ * bus lock keeps that apart from the I2C task. The bus runs at
+ * 100kHz until i2c_fastClock() switches the devices that can do
+ * more to their own clock, which is set before each transaction.
+ */
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "tc_i2cq.h"
+#include "tc_i2c.h"
+#include "tc_prof.h"
+
+#define I2C_TASK_STACK  3072
+#define I2C_TASK_PRIO   2
+
+// Keypad first, then what is visible, then the rest
+static const uint8_t i2cPrio[I2CD_NUM] = {
+    1, 1, 1, 1,     // Displays, speedo
+    0,              // Keypad
+    2, 2,           // Rotary encoders
+    2,              // RTC
+    3, 3, 3         // GPS, sensors
+};
+
+#ifdef TC_I2C_FASTCLK
+// Max clock (kHz). The PCF8574 (keypad) only supports 100kHz; the 
+// speedo, the rotary encoders and the sensors can be on long cables
+// of unknown quality, for little traffic. The GPS receiver moves the
+// most data; on a bad cable, it falls back to 100kHz.
+static const uint16_t i2cClock[I2CD_NUM] = {
+    400, 400, 400,  // HT16K33
+    100,            // Speedo
+    100,            // Keypad
+    100, 100,       // Rotary encoders
+    400,            // DS3231, PCF2129
+    400,            // GPS
+    100, 100        // Sensors
+};
+#endif
+
+static I2CQueue          i2cq;
+static SemaphoreHandle_t i2cMutex = NULL;
+static TaskHandle_t      i2cTask = NULL;
+
+static uint32_t          i2cDirect = 0;
+static uint8_t           i2cMaxPend = 0;
+
+static TaskHandle_t      i2cBatch = NULL;       // Task holding back the wakeup
+static bool              i2cBatchPend = false;
+
+// The bus for i2cq_exec
+struct I2CWire {
+    int xfer(uint8_t addr, const uint8_t *w, int wlen, uint8_t *r, int rlen, bool rstart)
+    {
+        int n = 0;
+
+        if(wlen) {
+            Wire.beginTransmission(addr);
+            Wire.write(w, wlen);
+            if(Wire.endTransmission(!(rlen && rstart)))
+                return I2CE_NAK;
+        }
+        if(rlen) {
+            n = Wire.requestFrom(addr, (uint8_t)rlen);
+            for(int i = 0; i < rlen; i++) {
+                r[i] = Wire.read();     // 0xff past what was received
+            }
+            if(!n) return I2CE_NAK;
+        }
+
+        return n;
+    }
+    void setClock(uint16_t khz) { Wire.setClock((uint32_t)khz * 1000); }
+    uint32_t micros() { return ::micros(); }
+};
+
+static void i2c_run(I2CTxn *t)
+{
+    I2CWire bus;
+
+    PROF_START(pc);
+    i2cq_exec(&i2cq, t, bus);
+    PROF_END(PROF_I2C, pc);
+}
+
+static void i2c_task(void *param)
+{
+    I2CTxn *t;
+    void   *w;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for(;;) {
+            xSemaphoreTake(i2cMutex, portMAX_DELAY);
+            t = i2cq_pop(&i2cq, micros());
+            xSemaphoreGive(i2cMutex);
+            if(!t) break;
+            // Waiter frees t as soon as it sees I2CT_DONE
+            w = t->waiter;
+            i2c_run(t);
+            if(w) {
+                xTaskNotifyGive((TaskHandle_t)w);
+            } else {
+                xSemaphoreTake(i2cMutex, portMAX_DELAY);
+                i2cq_free(&i2cq, t);
+                xSemaphoreGive(i2cMutex);
+            }
+        }
+    }
+}
+
+void i2c_setup()
+{
+    i2cq_init(&i2cq);
+    for(int i = 0; i < I2CD_NUM; i++) {
+        i2cq_setPrio(&i2cq, i, i2cPrio[i]);
+    }
+
+    if(!(i2cMutex = xSemaphoreCreateMutex()))
+        return;
+
+    xTaskCreatePinnedToCore(i2c_task, "i2c", I2C_TASK_STACK, NULL, I2C_TASK_PRIO, &i2cTask, xPortGetCoreID());
+
+    #ifdef TC_DBG_BOOT
+    Serial.printf("I2C task %s\n", i2cTask ? "started" : "failed");
+    #endif
+}
+
+// Called after boot (ie after device probing)
+void i2c_fastClock()
+{
+    #ifdef TC_I2C_FASTCLK
+    if(!i2cMutex) return;
+    xSemaphoreTake(i2cMutex, portMAX_DELAY);
+    for(int i = 0; i < I2CD_NUM; i++) {
+        i2cq_setClock(&i2cq, i, i2cClock[i]);
+    }
+    xSemaphoreGive(i2cMutex);
+    #endif
+}
+
+static I2CTxn *i2c_alloc()
+{
+    I2CTxn *t;
+
+    for(;;) {
+        xSemaphoreTake(i2cMutex, portMAX_DELAY);
+        t = i2cq_alloc(&i2cq);
+        xSemaphoreGive(i2cMutex);
+        if(t) return t;
+        // Pool might be full of writes held back by i2c_batchBegin()
+        xTaskNotifyGive(i2cTask);
+        vTaskDelay(1);
+    }
+}
+
+static void i2c_post(I2CTxn *t)
+{
+    xSemaphoreTake(i2cMutex, portMAX_DELAY);
+    i2cq_push(&i2cq, t, micros());
+    if(i2cq.pending > i2cMaxPend) i2cMaxPend = i2cq.pending;
+    xSemaphoreGive(i2cMutex);
+    if(!t->waiter && i2cBatch == xTaskGetCurrentTaskHandle()) {
+        i2cBatchPend = true;
+    } else {
+        xTaskNotifyGive(i2cTask);
+    }
+}
+
+/*
+ * Writes queued by the calling task between i2c_batchBegin() and
+ * i2c_batchEnd() do not wake the I2C task one by one (which, at its
+ * higher priority, would preempt the caller after each); they are
+ * done back to back after i2c_batchEnd(). A waiting i2c_xfer() in
+ * between does them right away.
+ */
+void i2c_batchBegin()
+{
+    if(i2cTask) i2cBatch = xTaskGetCurrentTaskHandle();
+}
+
+void i2c_batchEnd()
+{
+    i2cBatch = NULL;
+    if(i2cBatchPend) {
+        i2cBatchPend = false;
+        xTaskNotifyGive(i2cTask);
+    }
+}
+
+/*
+ * Queue a write and return. The data is copied; writes longer
+ * than I2CQ_DATAMAX bytes are done through i2c_xfer().
+ * Returns false if the write could not be queued.
+ */
+bool i2c_write(uint8_t dev, uint8_t addr, const uint8_t *buf, int len)
+{
+    I2CTxn *t;
+
+    if(!i2cTask || len > I2CQ_DATAMAX) {
+        return (i2c_xfer(dev, addr, buf, len) >= 0);
+    }
+
+    t = i2c_alloc();
+    t->dev = dev;
+    t->addr = addr;
+    t->wlen = len;
+    t->wbuf = t->data;
+    memcpy(t->data, buf, len);
+
+    i2c_post(t);
+
+    return true;
+}
+
+/*
+ * Write wlen bytes, then read rlen bytes (with a repeated start in
+ * between if rstart is set); either length may be 0. Waits until
+ * done, and returns the number of bytes read (which may be less
+ * than rlen; the rest of rbuf is then 0xff), or I2CE_xxx.
+ * Transactions queued before for the same device are done first.
+ */
+int i2c_xfer(uint8_t dev, uint8_t addr, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen, bool rstart)
+{
+    I2CTxn *t;
+    int    res;
+
+    if(i2cTask) {
+        t = i2c_alloc();
+    } else if(i2cMutex) {
+        // No task: Run it right here, one caller at a time
+        xSemaphoreTake(i2cMutex, portMAX_DELAY);
+        t = i2cq_alloc(&i2cq);
+    } else {
+        return I2CE_NOBUS;
+    }
+
+    t->dev = dev;
+    t->addr = addr;
+    t->wlen = wlen;
+    t->wbuf = wbuf;
+    t->rlen = rlen;
+    t->rbuf = rbuf;
+    if(rstart) t->flags |= I2CT_RSTART;
+
+    if(!i2cTask) {
+        i2cDirect++;
+        i2c_run(t);
+        res = t->result;
+        i2cq_free(&i2cq, t);
+        xSemaphoreGive(i2cMutex);
+        return res;
+    }
+
+    t->waiter = (void *)xTaskGetCurrentTaskHandle();
+    i2c_post(t);
+
+    while(!(t->flags & I2CT_DONE)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    res = t->result;
+
+    xSemaphoreTake(i2cMutex, portMAX_DELAY);
+    i2cq_free(&i2cq, t);
+    xSemaphoreGive(i2cMutex);
+
+    return res;
+}
+
+// Number of failed transactions; for callers that need to know 
+// whether a posted write went through
+uint32_t i2c_errors(uint8_t dev)
+{
+    return i2cq.stats[dev].naks;
+}
+
+#ifdef TC_PROFILER
+static const char *i2cNames[I2CD_NUM] = {
+    "Dest", "Pres", "Dept", "Speedo", "Keypad", "RotEnc", "RotEncV",
+    "RTC", "GPS", "Temp", "Light"
+};
+
+int i2c_report(char *buf, int bufLen)
+{
+    int l;
+
+    l = snprintf(buf, bufLen, "I2C device    txns    bytes   bus ms  us/byte  naks  max wait us  kHz\n");
+
+    for(int i = 0; i < I2CD_NUM && l < bufLen; i++) {
+        I2CDevStats *s = &i2cq.stats[i];
+        if(!s->txns) continue;
+        l += snprintf(buf + l, bufLen - l, "%-8s %9u %8u %8u %8u %5u %12u %4u\n", i2cNames[i],
+                  s->txns, s->bytes, s->us / 1000, s->bytes ? s->us / s->bytes : 0, 
+                  s->naks, s->maxWait, i2cq_getClock(&i2cq, i));
+    }
+    if(l < bufLen) {
+        l += snprintf(buf + l, bufLen - l, "I2C queue: max %u pending, %u direct\n", 
+                  i2cMaxPend, i2cDirect);
+    }
+
+    return (l < 0) ? 0 : ((l < bufLen) ? l : bufLen - 1);
+}
+#endif
@@ -0,0 +1,91 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * I2C bus manager
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_I2C_H
+#define _TC_I2C_H
+
+#include <stdint.h>
+
+// Devices, for priorities and statistics
+#define I2CD_DEST     0     // tcdDisplay: I2CD_DEST + DISP_xxx
+#define I2CD_PRES     1
+#define I2CD_DEPT     2
+#define I2CD_SPEED    3
+#define I2CD_KEYPAD   4
+#define I2CD_ROTENC   5     // Speed
+#define I2CD_ROTENCV  6     // Volume
+#define I2CD_RTC      7
+#define I2CD_GPS      8
+#define I2CD_TEMP     9
+#define I2CD_LIGHT    10
+#define I2CD_NUM      11
+
+void i2c_setup();
+void i2c_fastClock();
+
+bool i2c_write(uint8_t dev, uint8_t addr, const uint8_t *buf, int len);
+int  i2c_xfer(uint8_t dev, uint8_t addr, const uint8_t *wbuf, int wlen, 
+              uint8_t *rbuf = NULL, int rlen = 0, bool rstart = false);
+
+void i2c_batchBegin();
+void i2c_batchEnd();
+
+uint32_t i2c_errors(uint8_t dev);
+
+#ifdef TC_PROFILER
+int  i2c_report(char *buf, int bufLen);
+#endif
+
+#endif
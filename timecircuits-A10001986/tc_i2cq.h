@@ -0,0 +1,253 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * I2C bus manager: Transaction queue
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_I2CQ_H
+#define _TC_I2CQ_H
+
+/*
+ * Queue of I2C transactions, and the scheduler picking the next one
+ * to run: Strictly by the priority of the device (lower number runs 
+ * first), in order of posting within a priority. As every device has 
+ * one fixed priority, a device's transactions run in order.
+ * 
+ * Every device has a bus clock (kHz, 0 = I2CQ_SLOWCLK); the bus is
+ * switched before a transaction if needed. A device failing 
+ * I2CQ_FASTERR times in a row at a faster clock is put back to
+ * I2CQ_SLOWCLK for good.
+ * 
+ * Also keeps per-device statistics. Not thread-safe; the caller 
+ * does the locking.
+ * 
+ * This header must not depend on anything Arduino/ESP32 specific,
+ * so that it can be compiled and tested on a host.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#define I2CQ_SIZE     16    // Transactions pending or running
+#define I2CQ_DATAMAX  20    // Bytes of a queued write kept in the transaction
+#define I2CQ_PRIOS    4
+#define I2CQ_DEVMAX   16
+
+#define I2CQ_SLOWCLK  100   // kHz
+#define I2CQ_FASTERR  4
+
+#define I2CT_RSTART   0x01  // Repeated start between write and read
+#define I2CT_DONE     0x80  // Finished (result is valid)
+
+// result < 0
+#define I2CE_NAK      -1    // Address or data not acknowledged
+#define I2CE_NOBUS    -2    // Bus manager not set up
+
+struct I2CTxn {
+    uint8_t        dev;
+    uint8_t        addr;
+    uint8_t        wlen;
+    uint8_t        rlen;
+    volatile uint8_t flags;
+    int8_t         next;
+    int16_t        result;      // bytes read, or I2CE_xxx
+    const uint8_t  *wbuf;       // data[], or a waiting caller's buffer
+    uint8_t        *rbuf;
+    void           *waiter;     // For the platform layer
+    uint8_t        data[I2CQ_DATAMAX];
+};
+
+struct I2CDevStats {
+    uint32_t txns;
+    uint32_t bytes;             // data bytes, both directions
+    uint32_t us;                // bus time
+    uint32_t naks;              // failed transactions
+    uint32_t maxWait;           // us from posting to start
+};
+
+struct I2CQueue {
+    I2CTxn      txn[I2CQ_SIZE];
+    uint32_t    posted[I2CQ_SIZE];
+    int8_t      head[I2CQ_PRIOS];
+    int8_t      tail[I2CQ_PRIOS];
+    int8_t      freeList;
+    uint8_t     pending;
+    uint8_t     prio[I2CQ_DEVMAX];
+    uint16_t    clock[I2CQ_DEVMAX];
+    uint8_t     fastErr[I2CQ_DEVMAX];
+    uint16_t    curClock;
+    I2CDevStats stats[I2CQ_DEVMAX];
+};
+
+static inline void i2cq_init(I2CQueue *q)
+{
+    memset((void *)q, 0, sizeof(*q));
+    for(int i = 0; i < I2CQ_PRIOS; i++) {
+        q->head[i] = q->tail[i] = -1;
+    }
+    for(int i = 0; i < I2CQ_SIZE; i++) {
+        q->txn[i].next = (i < I2CQ_SIZE - 1) ? i + 1 : -1;
+    }
+    q->freeList = 0;
+    q->curClock = I2CQ_SLOWCLK;
+}
+
+static inline void i2cq_setPrio(I2CQueue *q, int dev, int prio)
+{
+    q->prio[dev] = (prio < I2CQ_PRIOS) ? prio : I2CQ_PRIOS - 1;
+}
+
+static inline void i2cq_setClock(I2CQueue *q, int dev, uint16_t khz)
+{
+    q->clock[dev] = khz;
+    q->fastErr[dev] = 0;
+}
+
+static inline uint16_t i2cq_getClock(I2CQueue *q, int dev)
+{
+    return q->clock[dev] ? q->clock[dev] : I2CQ_SLOWCLK;
+}
+
+// Get a free transaction, or NULL if all are in use
+static inline I2CTxn *i2cq_alloc(I2CQueue *q)
+{
+    I2CTxn *t;
+
+    if(q->freeList < 0) return NULL;
+
+    t = &q->txn[q->freeList];
+    q->freeList = t->next;
+    memset((void *)t, 0, sizeof(*t));
+    t->next = -1;
+
+    return t;
+}
+
+static inline void i2cq_free(I2CQueue *q, I2CTxn *t)
+{
+    t->next = q->freeList;
+    q->freeList = t - q->txn;
+}
+
+// Queue transaction; "now" (us) is for the wait statistics
+static inline void i2cq_push(I2CQueue *q, I2CTxn *t, uint32_t now)
+{
+    int p = q->prio[t->dev];
+    int8_t idx = t - q->txn;
+
+    q->posted[idx] = now;
+    t->next = -1;
+    if(q->tail[p] < 0) q->head[p] = idx;
+    else               q->txn[q->tail[p]].next = idx;
+    q->tail[p] = idx;
+    q->pending++;
+}
+
+// Take the next transaction to run off the queue, or NULL
+static inline I2CTxn *i2cq_pop(I2CQueue *q, uint32_t now)
+{
+    for(int p = 0; p < I2CQ_PRIOS; p++) {
+        int8_t idx = q->head[p];
+        if(idx < 0) continue;
+        I2CTxn *t = &q->txn[idx];
+        if((q->head[p] = t->next) < 0) q->tail[p] = -1;
+        t->next = -1;
+        q->pending--;
+        uint32_t w = now - q->posted[idx];
+        if(w > q->stats[t->dev].maxWait) q->stats[t->dev].maxWait = w;
+        return t;
+    }
+
+    return NULL;
+}
+
+/*
+ * Run transaction on the bus. The bus must provide
+ *    int      xfer(uint8_t addr, const uint8_t *w, int wlen, 
+ *                  uint8_t *r, int rlen, bool rstart);
+ *                  // returns bytes read (may be < rlen), or I2CE_NAK
+ *    void     setClock(uint16_t khz);
+ *    uint32_t micros();
+ */
+template <class B>
+static void i2cq_exec(I2CQueue *q, I2CTxn *t, B &bus)
+{
+    I2CDevStats *s = &q->stats[t->dev];
+    uint16_t clk = i2cq_getClock(q, t->dev);
+    uint32_t start;
+
+    if(clk != q->curClock) {
+        bus.setClock(clk);
+        q->curClock = clk;
+    }
+
+    start = bus.micros();
+
+    t->result = bus.xfer(t->addr, t->wbuf, t->wlen, t->rbuf, t->rlen, !!(t->flags & I2CT_RSTART));
+
+    s->us += bus.micros() - start;
+    s->txns++;
+    s->bytes += t->wlen + ((t->result > 0) ? t->result : 0);
+    if(t->result < 0) s->naks++;
+
+    if(clk > I2CQ_SLOWCLK) {
+        if(t->result >= 0) {
+            q->fastErr[t->dev] = 0;
+        } else if(++q->fastErr[t->dev] >= I2CQ_FASTERR) {
+            q->clock[t->dev] = I2CQ_SLOWCLK;
+        }
+    }
+
+    t->flags |= I2CT_DONE;
+}
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * ID3 tag parser
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_ID3_H
+#define _TC_ID3_H
+
+/*
+ * Streaming ID3v2 (2.2, 2.3, 2.4) parser
+ * 
+ * Reads the tag frame by frame through the source; of the title
+ * (TIT2/TT2) and artist (TPE1/TP1) frames, only the first 
+ * ID3_TXTMAX bytes are read, all other frames (pictures...) are
+ * skipped. Needs no heap, and finds frames anywhere in the tag.
+ * 
+ * The source must provide
+ *    uint32_t read(void *data, uint32_t len);
+ *    bool     skip(uint32_t len);     // forward, relative
+ * 
+ * This header must not depend on anything Arduino/ESP32 specific,
+ * so that it can be compiled and fuzzed on a host.
+ */
+
+#include <stdint.h>
+
+#define ID3_TXTMAX  80      // Bytes of a text frame looked at
+#define ID3_MAXCHRS 15      // Chars stored, buffers need one more
+
+static inline uint32_t id3_num(const uint8_t *p, int n, int bits)
+{
+    uint32_t v = 0;
+
+    for(int i = 0; i < n; i++) {
+        v = (v << bits) | (p[i] & ((1 << bits) - 1));
+    }
+
+    return v;
+}
+
+// Check 10-byte header; returns size of tag incl. header (= start
+// of audio data), or 0 if there is no (usable) tag
+static inline uint32_t id3_tagSize(const uint8_t *hd)
+{
+    if(hd[0] == 'I' && hd[1] == 'D' && hd[2] == '3' &&
+       hd[3] >= 0x02 && hd[3] <= 0x04 && hd[4] == 0 &&
+       (!(hd[5] & 0x80))) {
+        return id3_num(hd + 6, 4, 7) + 10;
+    }
+
+    return 0;
+}
+
+static inline void id3_putc(char **dst, unsigned int c)
+{
+    if(c >= ' ' && c <= 126) {
+        if(c >= 'a' && c <= 'z') c &= ~0x20;
+        else if(c == 126) c = '-';  // 126 = ~ but displayed as °, so make it '-'
+        *(*dst)++ = c;
+        **dst = 0;
+    }
+}
+
+// Convert text frame content (encoding byte, string) to upper 
+// case ASCII; other characters are dropped
+static inline void id3_copyText(const uint8_t *s, uint32_t len, char *dst, int maxChrs)
+{
+    const uint8_t *send = s + len;
+    char    *dend = dst + maxChrs;
+    uint8_t enc;
+    unsigned int c;
+
+    dst[0] = 0;
+
+    if(!len) return;
+
+    enc = *s++;
+
+    if(enc == 1 && send - s >= 2) {
+        c = (s[0] << 8) | s[1];
+        if(c == 0xfeff)      { enc = 2; s += 2; }
+        else if(c == 0xfffe) { s += 2; }
+    }
+
+    switch(enc) {
+    case 0:        // ISO-8859-1
+        while(dst < dend && s < send) {
+            if(!(c = *s++)) return;
+            id3_putc(&dst, c);
+        }
+        break;
+    case 1:        // UTF-16LE
+    case 2:        // UTF-16BE
+        while(dst < dend && send - s >= 2) {
+            c = (enc == 1) ? (s[0] | (s[1] << 8)) : ((s[0] << 8) | s[1]);
+            s += 2;
+            if(!c) return;
+            if(c >= 0xd800 && c <= 0xdbff) {
+                if(send - s < 2) return;
+                s += 2;
+            } else {
+                id3_putc(&dst, c);
+            }
+        }
+        break;
+    case 3:        // UTF-8
+        while(dst < dend && s < send) {
+            int x = 0;
+            c = *s++;
+            if     (c >= 192 && c < 224) x = 1;
+            else if(c >= 224 && c < 240) x = 2;
+            else if(c >= 240 && c < 245) x = 3;
+            if(x) {
+                if(send - s < x) return;
+                s += x;
+            } else {
+                id3_putc(&dst, c);
+            }
+        }
+        break;
+    }
+}
+
+/*
+ * Parse tag at current position of src; artist and track get
+ * the TPE1 and TIT2 texts (or are emptied). Returns the size of
+ * the tag (= start of audio data if the tag is at the start of
+ * the file), or 0 if there is none. The source is left somewhere
+ * inside the tag; the caller needs to seek to the audio data.
+ */
+template <class S>
+static int32_t id3_parse(S &src, char *artist, char *track)
+{
+    uint8_t  hd[10];
+    uint8_t  txt[ID3_TXTMAX];
+    uint32_t size, left, fsz, n, off;
+    uint8_t  rev, hl, fl, bad;
+    int      found = 0, which;
+
+    *artist = *track = 0;
+
+    if(src.read(hd, 10) != 10 || !(size = id3_tagSize(hd)))
+        return 0;
+
+    rev  = hd[3];
+    left = size - 10;
+    hl   = (rev == 2) ? 6 : 10;
+    bad  = (rev == 3) ? (0x80 | 0x40) :         // Compression/Encryption
+           ((rev == 4) ? (0x08 | 0x04 | 0x02)   // Compression/Encryption/Unsync
+                       : 0);
+
+    // Skip extended header
+    if(rev >= 3 && (hd[5] & 0x40)) {
+        if(left < 4 || src.read(hd, 4) != 4) return size;
+        n = (rev == 3) ? id3_num(hd, 4, 8) + 4 : id3_num(hd, 4, 7);
+        if(n < 4 || n > left) return size;
+        left -= n;
+        if(n > 4 && !src.skip(n - 4)) return size;
+    }
+
+    while(found != 3 && left >= hl) {
+
+        if(src.read(hd, hl) != hl) break;
+        left -= hl;
+
+        // Quit when we are in padding
+        if(!(hd[0] | hd[1] | hd[2] | ((rev == 2) ? 0 : hd[3]))) break;
+
+        if(rev == 2) {
+            fsz = id3_num(hd + 3, 3, 8);
+            fl = 0;
+        } else {
+            fsz = id3_num(hd + 4, 4, (rev == 3) ? 8 : 7);
+            fl = hd[9];
+        }
+
+        if(fsz > left) break;
+        left -= fsz;
+
+        which = 0;
+        if(!(fl & bad) && hd[0] == 'T') {
+            if((rev == 2) ? (hd[1] == 'T' && hd[2] == '2') : (hd[1] == 'I' && hd[2] == 'T' && hd[3] == '2')) {
+                which = 1;
+            } else if((rev == 2) ? (hd[1] == 'P' && hd[2] == '1') : (hd[1] == 'P' && hd[2] == 'E' && hd[3] == '1')) {
+                which = 2;
+            }
+        }
+
+        if(which) {
+            // Data length indicator despite no other flags: Ignore
+            off = (rev == 4 && (fl & 0x01)) ? 4 : 0;
+            n = (fsz < ID3_TXTMAX) ? fsz : ID3_TXTMAX;
+            if(src.read(txt, n) != n) break;
+            if(n > off) {
+                id3_copyText(txt + off, n - off, (which == 1) ? track : artist, ID3_MAXCHRS);
+            }
+            found |= which;
+            fsz -= n;
+        }
+
+        if(fsz && !src.skip(fsz)) break;
+    }
+
+    return size;
+}
+
+#endif
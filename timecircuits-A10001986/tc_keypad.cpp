@@ -339,7 +339,11 @@ void keypad_setup()
     enterKey.attachPressStart(enterKeyPushedDown);
     
     // Set up the keypad
+    #ifdef TC_KEYPAD_INT
+    keypad.begin(20, ENTER_HOLD_TIME, myCustomDelay_KP, KEYPAD_INT_PIN);
+    #else
     keypad.begin(20, ENTER_HOLD_TIME, myCustomDelay_KP);
+    #endif
 
     keypad.addEventListener(keypadEvent);
 
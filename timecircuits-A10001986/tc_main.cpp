@@ -71,6 +71,8 @@
 #endif
 
 #include "tc_main.h"
+#include "tc_i2c.h"
+#include "tc_prof.h"
 
 // i2c slave addresses
 
@@ -313,6 +315,7 @@ static unsigned long tempReadNow = 0;
 static unsigned long tempDispNow = 0;
 static unsigned long tempUpdInt = TEMP_UPD_INT_L;
 static bool          tempLastNan = true;
+static bool          tempDispPend = false;
 #endif
 
 static unsigned long volChangedNow = 0;
@@ -404,15 +407,40 @@ bool        timeDiffUp = false;  // true = add difference, false = subtract diff
 
 // TZ/DST status & data
 static int  tzForYear[3]    = { 0, 0, 0 };               // Parsing done for this very year
-static char *tzDSTpart[3]   = { NULL, NULL, NULL };
-static int  tzDiffGMT[3]    = { 0, 0, 0 };               // Difference to UTC in nonDST time
-static int  tzDiffGMTDST[3] = { 0, 0, 0 };               // Difference to UTC in DST time
-static int  tzDiff[3]       = { 0, 0, 0 };               // difference between DST and non-DST in minutes
+#define DSTR_MWD 0                                       // DST rule types: Mm.w.d
+#define DSTR_JUL 1                                       //                 Jn
+#define DSTR_DAY 2                                       //                 n
+typedef struct {
+    uint8_t type;
+    uint8_t month;                                       // Mm.w.d: Month (1-12)
+    uint8_t week;                                        // Mm.w.d: Week (1-4 = nth, 5 = last)
+    uint8_t wday;                                        // Mm.w.d: Weekday (0 = Sunday)
+    int16_t yday;                                        // Jn: 1-365; n: 0-365
+    int16_t hour;                                        // Time of change (-167-167)
+    int8_t  minute;
+} DSTRule;
+typedef struct {
+    int     diffGMT;                                     // Difference to UTC in nonDST time
+    int     diffGMTDST;                                  // Difference to UTC in DST time
+    int     diff;                                        // difference between DST and non-DST in minutes
+    int8_t  hasDST;                                      // 1 = valid DST rules, 0 = no DST, -1 = bad DST definition
+    DSTRule DSTon;
+    DSTRule DSToff;
+} TzRule;
+static TzRule tzRule[3];                                 // Compiled TZ strings
 static int  DSTonMins[3]    = { -1, -1, -1 };            // DST-on date/time in minutes since 1/1 00:00 (in non-DST time)
 static int  DSToffMins[3]   = { 600000, 600000, 600000}; // DST-off date/time in minutes since 1/1 00:00 (in DST time)
 bool        couldDST[3]     = { false, false, false };   // Could use own DST management (and DST is defined in TZ)
 static int8_t tzIsValid[3]  = { -1, -1, -1 };
 static int8_t tzHasDST[3]   = { -1, -1, -1 };
+#define TZ_DSTCACHE_SIZE 4                                // Number of years cached per time zone
+static struct {
+    int  year;
+    int  onMins;
+    int  offMins;
+    bool couldDST;
+} DSTCache[3][TZ_DSTCACHE_SIZE];                          // DST data of recently parsed years
+static uint8_t DSTCacheNext[3] = { 0, 0, 0 };             // Next cache slot to (re)use
 #ifdef TC_DBG_BOOT
 static const char *badTZ = "Failed to parse TZ\n";
 #endif
@@ -698,162 +726,117 @@ static unsigned long tsSndNow = 0;
 static int16_t       tsSndSeg[3] = { 0 };
 
 // Date & time stuff
-static const uint8_t monthDays[] =
+static constexpr uint8_t monthDays[] =
 {
     31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
 };
-static const unsigned int mon_yday[2][13] =
-{
-    { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 },
-    { 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366 }
-};
-static const unsigned int mon_ydayt24t60[2][13] =
+
+// Accumulated days per month (generated from monthDays)
+static constexpr unsigned int monYDay(int leap, int m)
 {
-    { 0, 31*24*60,  59*24*60,  90*24*60, 120*24*60, 151*24*60, 181*24*60, 
-        212*24*60, 243*24*60, 273*24*60, 304*24*60, 334*24*60, 365*24*60 },
-    { 0, 31*24*60,  60*24*60,  91*24*60, 121*24*60, 152*24*60, 182*24*60, 
-        213*24*60, 244*24*60, 274*24*60, 305*24*60, 335*24*60, 366*24*60 }
-};
-static const uint64_t mins1kYears[] =
-{
-#ifndef TC_JULIAN_CAL  
-             0,  262975680,  525949920,  788924160, 1051898400,
-    1314874080, 1577848320, 1840822560, 2103796800, 2366772480,
-    2629746720, 2892720960, 3155695200, 3418670880, 3681645120,
-    3944619360, 4207593600, 4470569280, 4733543520, 4996517760,
-    5259492000, 5522467680
-#elif !defined(JSWITCH_1582)
-             0,   52596000,  105192000,  157788000,  210384000, 
-     262980000,  315576000,  368172000,  420768000,  473364000, 
-     525960000,  578556000,  631152000,  683748000,  736344000, 
-     788940000,  841536000,  894132000,  946712160,  999306720, 
-    1051901280, 1104497280, 1157091840, 1209686400, 1262280960, 
-    1314876960, 1367471520, 1420066080, 1472660640, 1525256640, 
-    1577851200, 1630445760, 1683040320, 1735636320, 1788230880, 
-    1840825440, 1893420000, 1946016000, 1998610560, 2051205120, 
-    2103799680, 2156395680, 2208990240, 2261584800, 2314179360, 
-    2366775360, 2419369920, 2471964480, 2524559040, 2577155040, 
-    2629749600, 2682344160, 2734938720, 2787534720, 2840129280, 
-    2892723840, 2945318400, 2997914400, 3050508960, 3103103520, 
-    3155698080, 3208294080, 3260888640, 3313483200, 3366077760, 
-    3418673760, 3471268320, 3523862880, 3576457440, 3629053440, 
-    3681648000, 3734242560, 3786837120, 3839433120, 3892027680, 
-    3944622240, 3997216800, 4049812800, 4102407360, 4155001920, 
-    4207596480, 4260192480, 4312787040, 4365381600, 4417976160, 
-    4470572160, 4523166720, 4575761280, 4628355840, 4680951840, 
-    4733546400, 4786140960, 4838735520, 4891331520, 4943926080, 
-    4996520640, 5049115200, 5101711200, 5154305760, 5206900320,
-    5259494880, 5312090880, 5364685440, 5417280000, 5469874560, 
-    5522470560, 5575065120, 5627659680, 5680254240, 5732850240   
-#else
-             0,   52596000,  105192000,  157788000,  210384000, 
-     262980000,  315576000,  368172000,  420768000,  473364000, 
-     525960000,  578556000,  631152000,  683748000,  736344000, 
-     788940000,  841521600,  894117600,  946712160,  999306720, 
-    1051901280, 1104497280, 1157091840, 1209686400, 1262280960, 
-    1314876960, 1367471520, 1420066080, 1472660640, 1525256640, 
-    1577851200, 1630445760, 1683040320, 1735636320, 1788230880, 
-    1840825440, 1893420000, 1946016000, 1998610560, 2051205120, 
-    2103799680, 2156395680, 2208990240, 2261584800, 2314179360, 
-    2366775360, 2419369920, 2471964480, 2524559040, 2577155040, 
-    2629749600, 2682344160, 2734938720, 2787534720, 2840129280, 
-    2892723840, 2945318400, 2997914400, 3050508960, 3103103520, 
-    3155698080, 3208294080, 3260888640, 3313483200, 3366077760, 
-    3418673760, 3471268320, 3523862880, 3576457440, 3629053440, 
-    3681648000, 3734242560, 3786837120, 3839433120, 3892027680, 
-    3944622240, 3997216800, 4049812800, 4102407360, 4155001920, 
-    4207596480, 4260192480, 4312787040, 4365381600, 4417976160, 
-    4470572160, 4523166720, 4575761280, 4628355840, 4680951840, 
-    4733546400, 4786140960, 4838735520, 4891331520, 4943926080, 
-    4996520640, 5049115200, 5101711200, 5154305760, 5206900320,
-    5259494880, 5312090880, 5364685440, 5417280000, 5469874560, 
-    5522470560, 5575065120, 5627659680, 5680254240, 5732850240
-#endif    
-};
+    return m ? monYDay(leap, m - 1) + monthDays[m - 1] + ((leap && m == 2) ? 1 : 0) : 0;
+}
+#define MON_YDAY(l) { monYDay(l, 0), monYDay(l, 1), monYDay(l, 2), monYDay(l, 3),    \
+                      monYDay(l, 4), monYDay(l, 5), monYDay(l, 6), monYDay(l, 7),    \
+                      monYDay(l, 8), monYDay(l, 9), monYDay(l, 10), monYDay(l, 11),  \
+                      monYDay(l, 12) }
+static constexpr unsigned int mon_yday[2][13] = { MON_YDAY(0), MON_YDAY(1) };
 uint32_t (*t)(uint8_t *, uint32_t, uint32_t);
-static const uint32_t hours1kYears[] =
+
+/*
+ *  Closed-form day counting: Days since 1/1/0 for a given date.
+ *  Years are counted from March 1, so that the leap day is the last 
+ *  day of the year; dates are shifted by one full cycle (400 resp 4 
+ *  years) in order to stay positive for year 0.
+ *  (C++11-constexpr, ie single return statements only)
+ */
+static constexpr int32_t marchYDay(int month, int day)
 {
-#ifndef TC_JULIAN_CAL
-                0,  262975680/60,  525949920/60,  788924160/60, 1051898400/60,
-    1314874080/60, 1577848320/60, 1840822560/60, 2103796800/60, 2366772480/60, 
-    2629746720/60, 2892720960/60, 3155695200/60, 3418670880/60, 3681645120/60, 
-    3944619360/60, 4207593600/60, 4470569280/60, 4733543520/60, 4996517760/60,
-    5259492000/60, 5522467680/60 
-#elif !defined(JSWITCH_1582)
-                0,   52596000/60,  105192000/60,  157788000/60,  210384000/60, 
-     262980000/60,  315576000/60,  368172000/60,  420768000/60,  473364000/60, 
-     525960000/60,  578556000/60,  631152000/60,  683748000/60,  736344000/60, 
-     788940000/60,  841536000/60,  894132000/60,  946712160/60,  999306720/60, 
-    1051901280/60, 1104497280/60, 1157091840/60, 1209686400/60, 1262280960/60, 
-    1314876960/60, 1367471520/60, 1420066080/60, 1472660640/60, 1525256640/60, 
-    1577851200/60, 1630445760/60, 1683040320/60, 1735636320/60, 1788230880/60, 
-    1840825440/60, 1893420000/60, 1946016000/60, 1998610560/60, 2051205120/60, 
-    2103799680/60, 2156395680/60, 2208990240/60, 2261584800/60, 2314179360/60, 
-    2366775360/60, 2419369920/60, 2471964480/60, 2524559040/60, 2577155040/60, 
-    2629749600/60, 2682344160/60, 2734938720/60, 2787534720/60, 2840129280/60, 
-    2892723840/60, 2945318400/60, 2997914400/60, 3050508960/60, 3103103520/60, 
-    3155698080/60, 3208294080/60, 3260888640/60, 3313483200/60, 3366077760/60, 
-    3418673760/60, 3471268320/60, 3523862880/60, 3576457440/60, 3629053440/60, 
-    3681648000/60, 3734242560/60, 3786837120/60, 3839433120/60, 3892027680/60, 
-    3944622240/60, 3997216800/60, 4049812800/60, 4102407360/60, 4155001920/60, 
-    4207596480/60, 4260192480/60, 4312787040/60, 4365381600/60, 4417976160/60, 
-    4470572160/60, 4523166720/60, 4575761280/60, 4628355840/60, 4680951840/60, 
-    4733546400/60, 4786140960/60, 4838735520/60, 4891331520/60, 4943926080/60, 
-    4996520640/60, 5049115200/60, 5101711200/60, 5154305760/60, 5206900320/60,
-    5259494880/60, 5312090880/60, 5364685440/60, 5417280000/60, 5469874560/60, 
-    5522470560/60, 5575065120/60, 5627659680/60, 5680254240/60, 5732850240/60
-#else
-             0/60,   52596000/60,  105192000/60,  157788000/60,  210384000/60, 
-     262980000/60,  315576000/60,  368172000/60,  420768000/60,  473364000/60, 
-     525960000/60,  578556000/60,  631152000/60,  683748000/60,  736344000/60, 
-     788940000/60,  841521600/60,  894117600/60,  946712160/60,  999306720/60, 
-    1051901280/60, 1104497280/60, 1157091840/60, 1209686400/60, 1262280960/60, 
-    1314876960/60, 1367471520/60, 1420066080/60, 1472660640/60, 1525256640/60, 
-    1577851200/60, 1630445760/60, 1683040320/60, 1735636320/60, 1788230880/60, 
-    1840825440/60, 1893420000/60, 1946016000/60, 1998610560/60, 2051205120/60, 
-    2103799680/60, 2156395680/60, 2208990240/60, 2261584800/60, 2314179360/60, 
-    2366775360/60, 2419369920/60, 2471964480/60, 2524559040/60, 2577155040/60, 
-    2629749600/60, 2682344160/60, 2734938720/60, 2787534720/60, 2840129280/60, 
-    2892723840/60, 2945318400/60, 2997914400/60, 3050508960/60, 3103103520/60, 
-    3155698080/60, 3208294080/60, 3260888640/60, 3313483200/60, 3366077760/60, 
-    3418673760/60, 3471268320/60, 3523862880/60, 3576457440/60, 3629053440/60, 
-    3681648000/60, 3734242560/60, 3786837120/60, 3839433120/60, 3892027680/60, 
-    3944622240/60, 3997216800/60, 4049812800/60, 4102407360/60, 4155001920/60, 
-    4207596480/60, 4260192480/60, 4312787040/60, 4365381600/60, 4417976160/60, 
-    4470572160/60, 4523166720/60, 4575761280/60, 4628355840/60, 4680951840/60, 
-    4733546400/60, 4786140960/60, 4838735520/60, 4891331520/60, 4943926080/60, 
-    4996520640/60, 5049115200/60, 5101711200/60, 5154305760/60, 5206900320/60,
-    5259494880/60, 5312090880/60, 5364685440/60, 5417280000/60, 5469874560/60, 
-    5522470560/60, 5575065120/60, 5627659680/60, 5680254240/60, 5732850240/60
-#endif    
-};
+    return (((153 * ((month > 2) ? month - 3 : month + 9)) + 2) / 5) + day - 1;
+}
+static constexpr int32_t gregYToDays(int32_t y, int32_t doy)
+{
+    return ((y / 400) * 146097) + ((y % 400) * 365) + ((y % 400) / 4) - ((y % 400) / 100) + doy - (146097 - 60);
+}
+static constexpr int32_t gregToDays(int year, int month, int day)
+{
+    return gregYToDays(year + 400 - (month <= 2), marchYDay(month, day));
+}
 
 #ifdef TC_JULIAN_CAL
-static const uint64_t tdro = 5258967840;
+static constexpr int32_t julYToDays(int32_t y, int32_t doy)
+{
+    return ((y / 4) * 1461) + ((y % 4) * 365) + doy - (1461 - 60);
+}
+static constexpr int32_t julToDays(int year, int month, int day)
+{
+    return julYToDays(year + 4 - (month <= 2), marchYDay(month, day));
+}
+
 #ifndef JSWITCH_1582
-static const int jCentStart   = 1700;      // Start of century when switch took place
-static const int jCentEnd     = 1799;      // Last year of century when switch took place
-static const int jSwitchYear  = 1752;      // Year in which switch to Gregorian Cal took place
-static const int jSwitchMon   = 9;         // Month in which switch to Gregorian Cal took place
-static const int jSwitchDay   = 2;         // Last day of Julian Cal
-static const int jSwitchSkipD = 11;        // Number of days skipped
-static const int jSwitchSkipH = 11 * 24;   // Num hours skipped
+static constexpr int jSwitchYear  = 1752;      // Year in which switch to Gregorian Cal took place
+static constexpr int jSwitchMon   = 9;         // Month in which switch to Gregorian Cal took place
+static constexpr int jSwitchDay   = 2;         // Last day of Julian Cal
+static constexpr int jSwitchSkipD = 11;        // Number of days skipped
+#else
+static constexpr int jSwitchYear  = 1582;      // Year in which switch to Gregorian Cal took place
+static constexpr int jSwitchMon   = 10;        // Month in which switch to Gregorian Cal took place
+static constexpr int jSwitchDay   = 4;         // Last day of Julian Cal
+static constexpr int jSwitchSkipD = 10;        // Number of days skipped
+#endif
+// Day number (since 1/1/0) of first Gregorian day
+static constexpr int32_t  jSwitchDNum  = julToDays(jSwitchYear, jSwitchMon, jSwitchDay) + 1;
+// Offset from Gregorian day number to continuous count
+static constexpr int32_t  jSwitchDOffs = jSwitchDNum - gregToDays(jSwitchYear, jSwitchMon, jSwitchDay + jSwitchSkipD + 1);
+static constexpr uint32_t jSwitchHash  = (jSwitchYear << 16) | (jSwitchMon << 8) | jSwitchDay;
+
+static constexpr int32_t calToDays(int year, int month, int day)
+{
+    return ((uint32_t)((year << 16) | (month << 8) | day) <= jSwitchHash) ? 
+                julToDays(year, month, day) : gregToDays(year, month, day) + jSwitchDOffs;
+}
+static constexpr int hrs1KYrsStride = 200;
 #else
-static const int jCentStart   = 1500;      // Start of century when switch took place
-static const int jCentEnd     = 1599;      // Last year of century when switch took place
-static const int jSwitchYear  = 1582;      // Year in which switch to Gregorian Cal took place
-static const int jSwitchMon   = 10;        // Month in which switch to Gregorian Cal took place
-static const int jSwitchDay   = 4;         // Last day of Julian Cal
-static const int jSwitchSkipD = 10;        // Number of days skipped
-static const int jSwitchSkipH = 10 * 24;   // Num hours skipped
+static constexpr int32_t calToDays(int year, int month, int day)
+{
+    return gregToDays(year, month, day);
+}
+static constexpr int hrs1KYrsStride = 1000;
 #endif
-static int mon_yday_jSwitch[13];     // Accumulated days per month in year of Switch
-static int mon_ydayt24t60J[13];      // Accumulated mins per month in year of Switch
-static int jSwitchYrHrs;
-static uint32_t jSwitchHash = 0;
+
+// Day numbers of 1/1/1 and 1/1/10000; we wrap from 9999 to 1 and vice versa
+static constexpr int32_t  yr1Days   = calToDays(1, 1, 1);
+static constexpr int32_t  yr10kDays = calToDays(10000, 1, 1);
+static constexpr uint64_t yr10kMins = (uint64_t)yr10kDays * (24*60);
+static constexpr uint64_t tdro      = (uint64_t)(yr10kDays - yr1Days) * (24*60);
+
+static constexpr uint32_t hrs1KYrs(int index)
+{
+    return calToDays(index * hrs1KYrsStride, 1, 1) * 24;
+}
+
+// Self-check
+static_assert(mon_yday[0][2] == 59 && mon_yday[1][2] == 60 && 
+              mon_yday[0][12] == 365 && mon_yday[1][12] == 366, "mon_yday broken");
+static_assert(yr1Days == 366, "Day count broken");
+#ifndef TC_JULIAN_CAL
+static_assert(yr10kMins == 5259492000ULL && tdro == 5258964960ULL, "Day count broken");
+static_assert(calToDays(2000, 1, 1) * (24*60) == 1051898400, "Day count broken");
+static_assert(hrs1KYrs(6) == 52594920 && hrs1KYrs(7) == 61360752 && hrs1KYrs(8) == 70126560, "hrs1KYrs broken");
 #else
-static const uint64_t tdro = 5258964960;
+static_assert(yr10kMins == 5259494880ULL && tdro == 5258967840ULL, "Day count broken");
+static_assert(calToDays(1500, 1, 1) * (24*60) == 788940000 && 
+              calToDays(1800, 1, 1) * (24*60) == 946712160, "Day count broken");
+static_assert(hrs1KYrs(6) == 10519200 && hrs1KYrs(7) == 12272400, "hrs1KYrs broken");
+static_assert(calToDays(jSwitchYear, jSwitchMon, jSwitchDay + jSwitchSkipD + 1) == 
+              calToDays(jSwitchYear, jSwitchMon, jSwitchDay) + 1, "jSwitch broken");
+#ifndef JSWITCH_1582
+static_assert(hrs1KYrs(8) == 14025600, "hrs1KYrs broken");
+#else
+static_assert(hrs1KYrs(8) == 14025360, "hrs1KYrs broken");
+#endif
 #endif
+
 #define a(f, j) (f << (*monthDays - j))
 uint8_t* e(uint8_t *d, uint32_t m, int y) { return (*r)(d, m, y); }
 
@@ -1072,10 +1055,9 @@ static void sendNetWorkMsg(const char *pl, unsigned int len, uint8_t bttfnMsg, u
 // Time calculations
 static uint64_t  dateToMins(int year, int month, int day, int hour, int minute);
 static void      minsToDate(uint64_t total, int& year, int& month, int& day, int& hour, int& minute);
-#ifdef TC_JULIAN_CAL
-static void      calcJulianData();
-#endif
-static void      convTime(int diff, int& y, int& m, int& d, int& h, int& mm);
+static void      convTime(int diff, int& y, int& m, int& d, int& h, int& mm, int32_t *dayNum = NULL);
+static void      UTCtoLocalInt(const DateTime &dtu, DateTime& dtl, int index, int32_t *utcDayNum);
+static void      setDatesTimesWCInt(const DateTime& dtu, int32_t *utcDayNum);
 
 /// Native NTP
 static bool NTPHaveCurrentTime();
@@ -1201,11 +1183,6 @@ void main_setup()
     // Turn on the RTC's 1Hz clock output
     rtc.clockOutEnable();
 
-    // Calculate data for Julian Calendar
-    #ifdef TC_JULIAN_CAL
-    calcJulianData();
-    #endif
-
     // Swap red and yellow displays if so configured
     #ifdef IS_ACAR_DISPLAY
     if(evalBool(settings.swapDL)) {
@@ -1282,13 +1259,7 @@ void main_setup()
         } else {
             oldTime -= timeDifference;
         }
-        if(oldTime >= 
-        #ifndef TC_JULIAN_CAL
-                      mins1kYears[(10000 / 500)]
-        #else
-                      mins1kYears[(10000 / 100)]
-        #endif
-                                                ) {
+        if(oldTime >= yr10kMins) {
             timeDifference = 0;
         }
     } else {
@@ -1876,7 +1847,9 @@ void main_setup()
         tempOffNM = evalBool(settings.tempOffNM);
         if(sgf & SGF_DispTemp) {
             if(!(csf & CSF_OFF)) {
-                updateTemperature(true);
+                // Wait for first measurement
+                tempSens.readTemp();
+                tempReadNow = millis();
                 dispTemperature(true);
             }
         }
@@ -3258,8 +3231,10 @@ void main_loop()
             // Update "lastYear" (UTC) (saved to NVM in next loop iteration)
             lastYear = gdtu.year();
 
-            // Convert UTC to local (parses TZ in the process)
-            UTCtoLocal(gdtu, gdtl, 0);
+            // Convert UTC to local (parses TZ in the process), 
+            // and in WC mode, load dates/times for dest/dep display
+            // (Restoring not needed, done elsewhere)
+            updateAllTimes(gdtu);
 
             bttfnDateBuf[0] = (uint8_t)(gdtl.year() & 0xff);
             bttfnDateBuf[1] = (uint8_t)(gdtl.year() >> 8); 
@@ -3283,13 +3258,8 @@ void main_loop()
                 minNext = presentTime.getMinute();
             }
             
-            // Handle WC mode (load dates/times for dest/dep display)
-            // (Restoring not needed, done elsewhere)
+            // Handle WC mode (dates/times loaded above)
             if(isWcMode()) {
-                if((gdtu.minute() != wcLastMin) || (wcf & WCF_Trigger)) {
-                    wcLastMin = gdtu.minute();
-                    setDatesTimesWC(gdtu);
-                }
                 int a = (gdtu.second() % 10) - 3;
                 if((wcf & WCF_showName1) || (!a)) destShowAlt = destShowAltPreset;
                 if((wcf & WCF_showName2) || (!a)) depShowAlt  = depShowAltPreset;
@@ -3473,6 +3443,11 @@ void main_loop()
 
         } else if(!(csf & (CSF_ST|CSF_RE|CSF_OFF))) {
 
+            // Have the changed parts of all three displays
+            // written in one go
+            PROF_START(pdisp);
+            i2c_batchBegin();
+
             #ifdef TC_HAVEMQTT
             if(mqttDisp) {
                 displayMQTTmessage(MQ_DISP_D, 0, &destinationTime);
@@ -3527,6 +3502,9 @@ void main_loop()
             else if(specDisp == 31) displayTmrString();
             else if(specDisp == 2) s2(destinationTime.getColon());
 
+            i2c_batchEnd();
+            PROF_END(PROF_DISP, pdisp);
+
         }
 
         if(destShowAlt > 0) destShowAlt--;
@@ -4738,6 +4716,7 @@ void mydelay(unsigned long mydel)
 {
     unsigned long elap = 0;
     unsigned long startNow = millis();
+    PROF_SCOPE(PROF_DELAY);
 
     if(mydel <= 10) {
         while(millis() - startNow < mydel) {
@@ -4906,15 +4885,22 @@ bool isWcMode()
  * configured, it does not touch that display.
  */
 void setDatesTimesWC(DateTime& dtu)
+{
+    int32_t utcDayNum = -1;
+
+    setDatesTimesWCInt(dtu, &utcDayNum);
+}
+
+static void setDatesTimesWCInt(const DateTime& dtu, int32_t *utcDayNum)
 {
     DateTime dtl;
 
     if(wcf & WCF_HaveTZ1) {
-        UTCtoLocal(dtu, dtl, 1);
+        UTCtoLocalInt(dtu, dtl, 1, utcDayNum);
         destinationTime.setDateTime(dtl);
     }
     if(wcf & WCF_HaveTZ2) {
-        UTCtoLocal(dtu, dtl, 2);
+        UTCtoLocalInt(dtu, dtl, 2, utcDayNum);
         departedTime.setDateTime(dtl);
     }
 }
@@ -5004,9 +4990,18 @@ static void updateTemperature(bool force)
         tui = 5 * 1000;
     }
         
+    // Collect a pending measurement, does not wait. If the
+    // measurement was forced, show it right away, not only
+    // after the next periodic re-display.
+    if(tempSens.loop() && tempDispPend) {
+        tempDispPend = false;
+        tempDispNow = now - 2*60*1000;
+    }
+
     if(force || (now - tempReadNow >= tui)) {
-        tempSens.readTemp();
+        tempSens.requestTemp();
         tempReadNow = now;
+        if(force) tempDispPend = true;
     }
 }
 
@@ -6144,235 +6139,107 @@ bool isLeapYear(int year)
 #endif
 
 /*
- *  Convert a date into "minutes since 1/1/0 0:0"
+ *  Closed-form day counting: Date for given days since 1/1/0
+ *  (see gregToDays(), julToDays())
  */
-#ifndef TC_JULIAN_CAL 
-uint64_t dateToMins(int year, int month, int day, int hour, int minute)
+static void daysToGreg(int32_t days, int& year, int& month, int& day)
 {
-    uint64_t total64 = 0;
-    uint32_t total32 = 0;
-    int c = year, d = 0;        // ny0: d=1
+    int32_t z   = days + (146097 - 60);
+    int32_t era = z / 146097;
+    int32_t doe = z - (era * 146097);
+    int32_t yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+    int32_t doy = doe - ((yoe * 365) + (yoe / 4) - (yoe / 100));
+    int32_t mp  = ((5 * doy) + 2) / 153;
 
-    if(year < 11000) {
-        total32 = hours1kYears[year / 500];
-        if(total32) d = (year / 500) * 500;
-    } else {
-        total32 = hours1kYears[(sizeof(hours1kYears)/sizeof(hours1kYears[0]))-1];
-        d = ((sizeof(hours1kYears)/sizeof(hours1kYears[0]))-1) * 500;
-    }
-
-    while(c-- > d) {
-        total32 += (isLeapYear(c) ? (8760+24) : 8760);
-    }
-    total32 += (mon_yday[isLeapYear(year) ? 1 : 0][month - 1] * 24);
-    total32 += (day - 1) * 24;
-    total32 += hour;
-    total64 = (uint64_t)total32 * 60;
-    total64 += minute;
-    return total64;
+    day   = doy - (((153 * mp) + 2) / 5) + 1;
+    month = (mp < 10) ? mp + 3 : mp - 9;
+    year  = (era * 400) + yoe + (month <= 2) - 400;
 }
-#else
-uint64_t dateToMins(int year, int month, int day, int hour, int minute)
-{
-    uint64_t total64 = 0;
-    uint32_t total32 = 0;
-    int c = year, d = 0;        // ny0: d=1
-
-    if(year < 11000) {
-        total32 = hours1kYears[year / 100];
-        if(total32) d = (year / 100) * 100;
-    } else {
-        total32 = hours1kYears[(sizeof(hours1kYears)/sizeof(hours1kYears[0]))-1];
-        d = ((sizeof(hours1kYears)/sizeof(hours1kYears[0]))-1) * 100;
-    }
 
-    if(c < jCentStart || c > jCentEnd) {
-        while(c-- > d) {
-            total32 += (isLeapYear(c) ? (8760+24) : 8760);
-        }
-        total32 += (mon_yday[isLeapYear(year) ? 1 : 0][month - 1] * 24);
-        total32 += (day - 1) * 24;
-    } else {
-        while(c-- > d) {
-            total32 += ((c == jSwitchYear) ? jSwitchYrHrs : (isLeapYear(c) ? (8760+24) : 8760));
-        }
-        if(year == jSwitchYear) {
-            total32 += (mon_yday_jSwitch[month - 1] * 24);
-            if(month == jSwitchMon) {
-                if(day <= jSwitchDay) {
-                    total32 += (day - 1) * 24;
-                } else if(day > jSwitchDay + jSwitchSkipD) {
-                    total32 += (day - jSwitchSkipD - 1) * 24;
-                } else {
-                    Serial.printf("Bad date!\n");
-                }
-            } else {
-                total32 += (day - 1) * 24;
-            }
-        } else {
-            total32 += (mon_yday[isLeapYear(year) ? 1 : 0][month - 1] * 24);
-            total32 += (day - 1) * 24;
-        }
-    }
+#ifdef TC_JULIAN_CAL
+static void daysToJul(int32_t days, int& year, int& month, int& day)
+{
+    int32_t z   = days + (1461 - 60);
+    int32_t cyc = z / 1461;
+    int32_t doc = z - (cyc * 1461);
+    int32_t yoc = (doc - (doc / 1460)) / 365;
+    int32_t doy = doc - (yoc * 365);
+    int32_t mp  = ((5 * doy) + 2) / 153;
 
-    total32 += hour;
-    total64 = (uint64_t)total32 * 60;
-    total64 += minute;
-    return total64;
+    day   = doy - (((153 * mp) + 2) / 5) + 1;
+    month = (mp < 10) ? mp + 3 : mp - 9;
+    year  = (cyc * 4) + yoc + (month <= 2) - 4;
 }
 #endif
 
 /*
- *  Convert "minutes since 1/1/0 0:0" into date
+ *  Convert a date into "days since 1/1/0" and vice versa
  */
-#ifndef TC_JULIAN_CAL
-void minsToDate(uint64_t total64, int& year, int& month, int& day, int& hour, int& minute)
+#ifndef TC_JULIAN_CAL 
+static int32_t dateToDays(int year, int month, int day)
 {
-    int c = 0, d = (sizeof(mins1kYears)/sizeof(mins1kYears[0]))-1;  // ny0: c=1
-    int temp;
-    uint32_t total32;
-
-    year = 0;             // ny0: 1
-    month = day = 1;
-    hour = minute = 0;
-
-    while(d >= 0) {
-        if(total64 > mins1kYears[d]) break;
-        d--;
-    }
-    if(d > 0) {
-        total64 -= mins1kYears[d];
-        c = year = d * 500;
-    }
-
-    total32 = total64;
-
-    while(1) {
-        temp = isLeapYear(c++) ? ((8760+24)*60) : (8760*60);
-        if(total32 < temp) break;
-        year++;
-        total32 -= temp;
-    }
-
-    c = 1;
-    temp = isLeapYear(year) ? 1 : 0;
-    while(c < 12) {
-        if(total32 < (mon_ydayt24t60[temp][c])) break;
-        c++;
-    }
-    month = c;
-    total32 -= (mon_ydayt24t60[temp][c-1]);
-
-    temp = total32 / (24*60);
-    day = temp + 1;
-    total32 -= (temp * (24*60));
-
-    temp = total32 / 60;
-    hour = temp;
+    return gregToDays(year, month, day);
+}
 
-    minute = total32 - (temp * 60);
+static void daysToDate(int32_t days, int& year, int& month, int& day)
+{
+    daysToGreg(days, year, month, day);
 }
 #else
-void minsToDate(uint64_t total64, int& year, int& month, int& day, int& hour, int& minute)
+static int32_t dateToDays(int year, int month, int day)
 {
-    int c = 0, d = (sizeof(mins1kYears)/sizeof(mins1kYears[0]));    // ny0: c=1
-    int temp;
-    uint32_t total32;
-    
-    year = 0;             // ny0: 1
-    month = day = 1;
-    hour = minute = 0;
-  
-    d = (total64 < mins1kYears[d/2]) ? d / 2 : d - 1;
+    uint32_t hash = (year << 16) | (month << 8) | day;
 
-    while(d >= 0) {
-        if(total64 > mins1kYears[d]) break;
-        d--;
-    }
-    if(d > 0) {
-        total64 -= mins1kYears[d];
-        c = year = d * 100;
+    if(hash <= jSwitchHash) {
+        return julToDays(year, month, day);
+    } else if(hash <= jSwitchHash + jSwitchSkipD) {
+        Serial.printf("Bad date!\n");
+        return julToDays(year, month, 1);
     }
-    
-    total32 = total64;
+    return gregToDays(year, month, day) + jSwitchDOffs;
+}
 
-    if(c < jCentStart || c > jCentEnd) {
-        while(1) {
-            temp = isLeapYear(c++) ? ((8760+24)*60) : (8760*60);
-            if(total32 < temp) break;
-            year++;
-            total32 -= temp;
-        }
+static void daysToDate(int32_t days, int& year, int& month, int& day)
+{
+    if(days < jSwitchDNum) {
+        daysToJul(days, year, month, day);
     } else {
-        while(1) {
-            temp = ((c == jSwitchYear) ? jSwitchYrHrs : (isLeapYear(c) ? (8760+24) : 8760)) * 60;
-            if(total32 < temp) break;
-            c++;
-            year++;
-            total32 -= temp;
-        }
+        daysToGreg(days - jSwitchDOffs, year, month, day);
     }
+}
+#endif
 
-    c = 1;
-    if(year == jSwitchYear) {
-        while(c < 12) {
-            if(total32 < (mon_ydayt24t60J[c])) break;
-            c++;
-        }
-        month = c;
-        total32 -= (mon_ydayt24t60J[c-1]);
-  
-        temp = total32 / (24*60);
-        day = temp + 1;
-        if(month == jSwitchMon && day > jSwitchDay) {
-            day += jSwitchSkipD;
-        }
-    } else {      
-        temp = isLeapYear(year) ? 1 : 0;
-        while(c < 12) {
-            if(total32 < (mon_ydayt24t60[temp][c])) break;
-            c++;
-        }
-        month = c;
-        total32 -= (mon_ydayt24t60[temp][c-1]);
-
-        temp = total32 / (24*60);
-        day = temp + 1;
-    }
-    total32 -= (temp * (24*60));
+/*
+ *  Convert a date into "minutes since 1/1/0 0:0"
+ */
+uint64_t dateToMins(int year, int month, int day, int hour, int minute)
+{
+    uint64_t total64 = (uint64_t)dateToDays(year, month, day) * (24*60);
     
-    temp = total32 / 60;
-    hour = temp;
+    total64 += (hour * 60) + minute;
+    return total64;
+}
+
+/*
+ *  Convert "minutes since 1/1/0 0:0" into date
+ */
+void minsToDate(uint64_t total64, int& year, int& month, int& day, int& hour, int& minute)
+{
+    int32_t days = total64 / (24*60);
+    int32_t total32 = total64 - ((uint64_t)days * (24*60));
+
+    daysToDate(days, year, month, day);
 
-    minute = total32 - (temp * 60);
+    hour = total32 / 60;
+    minute = total32 - (hour * 60);
 }
-#endif
 
 uint32_t getHrs1KYrs(int index)
 {
-    return hours1kYears[index*2];
+    return hrs1KYrs(index);
 }
 
 #ifdef TC_JULIAN_CAL
-static void calcJulianData()
-{
-    int l = isLeapYear(jSwitchYear) ? 1 : 0;
-  
-    for(int i = 0; i < 13; i++) {
-        mon_yday_jSwitch[i] = mon_yday[l][i];
-    }
-    for(int i = jSwitchMon; i < 13; i++) {
-        mon_yday_jSwitch[i] -= jSwitchSkipD;
-    }
-    for(int i = 0; i < 13; i++) {
-        mon_ydayt24t60J[i] = mon_yday_jSwitch[i] * 24 * 60;
-    }
-    
-    jSwitchYrHrs = (l ? (8760+24) : 8760) - jSwitchSkipH;
-
-    jSwitchHash = (jSwitchYear << 16) | (jSwitchMon << 8) | jSwitchDay;
-} 
-
 void correctNonExistingDate(int year, int month, int& day)
 {
   if(year == jSwitchYear && month == jSwitchMon) {
@@ -6409,7 +6276,7 @@ void correctYr4RTC(uint16_t& year, int16_t& offs)
 /*
  * Parse integer
  */
-static char *parseInt(char *t, int& it)
+static const char *parseInt(const char *t, int& it)
 {
     bool isNeg = false;
     it = 0;
@@ -6433,22 +6300,22 @@ static char *parseInt(char *t, int& it)
 }
 
 /*
- * Parse DST parts of TZ string
+ * Compile DST start/end part of TZ string into rule
  */
-static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DSThour, int& DSTmin, int currYear, int correction)
+static const char *parseDSTRule(const char *t, DSTRule& rule)
 {
-    char *u;
-    int it, tw, dow;
+    const char *u;
+    int it;
 
-    DSTyear = currYear;
-    DSTmin = 0;
+    rule.hour = 2;
+    rule.minute = 0;
     
     if(*t == 'M') {
         t++;
         u = parseInt(t, it);
         if(!u) return NULL;
-        if(it >= 1 && it <= 12) DSTmonth = it;
-        else                    return NULL;
+        if(it < 1 || it > 12) return NULL;
+        rule.month = it;
             
         t = u;
         if(*t++ != '.') return NULL;
@@ -6456,7 +6323,7 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
         u = parseInt(t, it);
         if(!u) return NULL;
         if(it < 1 || it > 5) return NULL;
-        tw = it;
+        rule.week = it;
         
         t = u;        
         if(*t++ != '.') return NULL;
@@ -6464,19 +6331,12 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
         u = parseInt(t, it);
         if(!u) return NULL;
         if(it < 0 || it > 6) return NULL;
+        rule.wday = it;
 
         t = u;
-        
-        // it = weekday (0=Su), tw = week (1,2,3,4=nth week; 5=last)
-        dow = dayOfWeek(1, DSTmonth, currYear);
-        if(dow == 0) dow = 7;
-        DSTday = (it+1) - dow;
-        if(DSTday < 1) DSTday += 7;
-        while(--tw) {
-             DSTday += 7;
-        }
-        if(DSTday > daysInMonth(DSTmonth, currYear)) DSTday -= 7;
 
+        rule.type = DSTR_MWD;
+        
     } else if(*t == 'J') {
 
         t++;
@@ -6487,12 +6347,8 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
         
         t = u;
 
-        DSTmonth = 0;
-        while(it > monthDays[DSTmonth]) {
-            it -= monthDays[DSTmonth++];
-        }
-        DSTmonth++;
-        DSTday = it;
+        rule.type = DSTR_JUL;
+        rule.yday = it;
       
     } else if(*t >= '0' && *t <= '9') {
 
@@ -6500,17 +6356,11 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
         if(!u) return NULL;
 
         if(it < 0 || it > 365) return NULL;
-        if((it > 364) && (!isLeapYear(currYear))) return NULL;
         
         t = u;
 
-        it++;
-        DSTmonth = 1;
-        while(it > daysInMonth(DSTmonth, currYear)) {
-            it -= daysInMonth(DSTmonth, currYear);
-            DSTmonth++;
-        }
-        DSTday = it;
+        rule.type = DSTR_DAY;
+        rule.yday = it;
       
     } else return NULL;
 
@@ -6520,7 +6370,7 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
         if(!u) return NULL;
         
         t = u;
-        if(it >= -167 && it <= 167) DSThour = it;
+        if(it >= -167 && it <= 167) rule.hour = it;
         else return NULL;
         
         if(*t == ':') {
@@ -6529,7 +6379,7 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
             if(!u) return NULL;
             
             t = u;
-            if(it >= 0 && it <= 59) DSTmin = it;
+            if(it >= 0 && it <= 59) rule.minute = it;
             else return NULL;
             
             if(*t == ':') {
@@ -6539,8 +6389,57 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
                 t = u;
             }
         }
-    } else {
-        DSThour = 2;    
+    }
+
+    return t;
+}
+
+/*
+ * Evaluate DST rule for given year
+ */
+static bool evalDSTRule(const DSTRule& rule, int& DSTyear, int& DSTmonth, int& DSTday, int& DSThour, int& DSTmin, int currYear, int correction)
+{
+    int it, tw, dow;
+
+    DSTyear = currYear;
+    DSThour = rule.hour;
+    DSTmin = rule.minute;
+    
+    switch(rule.type) {
+    case DSTR_MWD:
+        // wday (0=Su), week (1,2,3,4=nth week; 5=last)
+        DSTmonth = rule.month;
+        dow = dayOfWeek(1, DSTmonth, currYear);
+        if(dow == 0) dow = 7;
+        DSTday = (rule.wday + 1) - dow;
+        if(DSTday < 1) DSTday += 7;
+        tw = rule.week;
+        while(--tw) {
+             DSTday += 7;
+        }
+        if(DSTday > daysInMonth(DSTmonth, currYear)) DSTday -= 7;
+        break;
+
+    case DSTR_JUL:
+        it = rule.yday;
+        DSTmonth = 0;
+        while(it > monthDays[DSTmonth]) {
+            it -= monthDays[DSTmonth++];
+        }
+        DSTmonth++;
+        DSTday = it;
+        break;
+
+    default:
+        it = rule.yday;
+        if((it > 364) && (!isLeapYear(currYear))) return false;
+        it++;
+        DSTmonth = 1;
+        while(it > daysInMonth(DSTmonth, currYear)) {
+            it -= daysInMonth(DSTmonth, currYear);
+            DSTmonth++;
+        }
+        DSTday = it;
     }
 
     // Correction used for converting DST-end to non-DST
@@ -6586,7 +6485,162 @@ static char *parseDST(char *t, int& DSTyear, int& DSTmonth, int& DSTday, int& DS
         }
     }
     
-    return t;
+    return true;
+}
+
+/*
+ * Evaluate DST rule for given year, and retry with adjacent
+ * year if result is outside of given year (due to hour
+ * numbers >= 24 or < 0).
+ */
+static bool evalDSTRuleForYear(const DSTRule& rule, int& DSTyear, int& DSTmonth, int& DSTday, int& DSThour, int& DSTmin, int currYear, int correction)
+{
+    if(!evalDSTRule(rule, DSTyear, DSTmonth, DSTday, DSThour, DSTmin, currYear, correction))
+        return false;
+
+    if(DSTyear > currYear) {
+        if(!evalDSTRule(rule, DSTyear, DSTmonth, DSTday, DSThour, DSTmin, currYear-1, correction))
+            return false;
+        // Trigger check in parseTZ if still outside of current year
+        if(DSTyear != currYear) DSTyear = currYear + 1;
+    } else if(DSTyear < currYear) {
+        if(!evalDSTRule(rule, DSTyear, DSTmonth, DSTday, DSThour, DSTmin, currYear+1, correction))
+            return false;
+        // Trigger check in parseTZ if still outside of current year
+        if(DSTyear != currYear) DSTyear = currYear - 1;
+    }
+
+    return true;
+}
+
+/*
+ * Compile TZ string into rule
+ * 
+ * Returns false if the TZ-part is bad. If only the DST-part
+ * is bad, returns true with rule.hasDST set to -1.
+ */
+static bool compileTZ(const char *tz, TzRule& rule)
+{
+    const char *t, *u;
+    int diffNorm = 0;
+    int diffDST = 0;
+    int it;
+
+    memset((void *)&rule, 0, sizeof(rule));
+
+    // 0) Basic validity check
+
+    t = tz;
+    while((t = strchr(t, '>'))) { t++; diffNorm++; }
+    t = tz;
+    while((t = strchr(t, '<'))) { t++; diffDST++; }
+    if(diffNorm != diffDST) return false;         // Uneven < and >, string is bad.
+
+    // 1) Find difference between nonDST and DST time
+
+    diffNorm = diffDST = 0;
+
+    // a. Skip TZ name and parse GMT-diff
+    t = tz;
+    if(*t == '<') {
+       t = strchr(t, '>');
+       if(!t) return false;                       // if <, but no >, string is bad. Bad TZ.
+       t++;
+    } else {
+       while(*t && *t != '-' && (*t < '0' || *t > '9')) {
+          if(*t == ',') return false;
+          t++;
+       }
+    }
+    
+    // t = start of diff to GMT
+    if(*t != '-' && *t != '+' && (*t < '0' || *t > '9'))
+        return false;                             // No numerical difference after name -> bad string. Bad TZ.
+
+    t = parseInt(t, it);
+    if(it >= -24 && it <= 24) diffNorm = it * 60;
+    else                      return false;       // Bad hr difference. No DST.
+    
+    if(*t == ':') {
+        t++;
+        u = parseInt(t, it);
+        if(!u) return false;                      // No number following ":". Bad string. Bad TZ.
+        t = u;
+        if(it >= 0 && it <= 59) {
+            if(diffNorm < 0)  diffNorm -= it;
+            else              diffNorm += it;
+        } else return false;                      // Bad min difference. Bad TZ.
+        if(*t == ':') {
+            t++;
+            u = parseInt(t, it);
+            if(u) t = u;
+            // Ignore seconds
+        }
+    }
+    
+    // b. Skip DST TZ name and parse GMT-diff
+    
+    if(*t == '<') {
+       t = strchr(t, '>');
+       if(!t) return false;                       // if <, but no >, string is bad. Bad TZ.
+       t++;
+    } else {
+       while(*t && *t != ',' && *t != '-' && (*t < '0' || *t > '9'))
+          t++;
+    }
+    
+    // t = assumed start of DST-diff to GMT
+    if(*t == 0) {
+        rule.diff = 0;
+    } else if(*t != '-' && *t != '+' && (*t < '0' || *t > '9')) {
+        rule.diff = 60;                           // No numerical difference after name -> Assume 1 hr
+    } else {
+        t = parseInt(t, it);
+        if(it >= -24 && it <= 24) diffDST = it * 60;
+        else                      return false;   // Bad hr difference. Bad TZ.
+        if(*t == ':') {
+            t++;
+            u = parseInt(t, it);
+            if(!u) return false;                  // No number following ":". Bad TZ.
+            t = u;
+            if(it >= 0 && it <= 59) {
+                if(diffDST < 0)  diffDST -= it;
+                else             diffDST += it;
+            } else return false;                  // Bad min difference. Bad TZ.
+            if(*t == ':') {
+                t++;
+                u = parseInt(t, it);
+                if(u) t = u;
+                // Ignore seconds
+            }
+        }
+        rule.diff = -(diffDST - diffNorm);
+    }
+
+    rule.diffGMT = diffNorm;
+    rule.diffGMTDST = rule.diffGMT - rule.diff;
+
+    // 2) Compile DST start and end
+
+    if(*t == 0 || *t != ',') {                    // No DST definition. No DST.
+        rule.hasDST = 0;
+        return true;
+    }
+
+    // Set to "bad DST" until verified valid
+    rule.hasDST = -1;
+
+    t = parseDSTRule(t + 1, rule.DSTon);
+    if(!t) return true;
+
+    if(*t == 0 || *t != ',') return true;         // Have start, but no end. Bad string. No DST.
+
+    t = parseDSTRule(t + 1, rule.DSToff);
+    if(!t) return true;
+
+    rule.hasDST = 1;
+
+    return true;
 }
 
 /*
@@ -6598,7 +6652,11 @@ int mins2Date(int year, int month, int day, int hour, int mins)
 }
 
 /*
- * Parse TZ string and setup DST data
+ * Set up TZ and DST data for given year
+ * 
+ * The TZ string is compiled into a rule upon the first call; 
+ * subsequent calls only evaluate the DST rules for the given 
+ * year.
  * 
  * If TZ-part is bad, always returns FALSE
  * If DST-part is bad, only returns FALSE once
@@ -6606,10 +6664,7 @@ int mins2Date(int year, int month, int day, int hour, int mins)
  */
 bool parseTZ(int index, int currYear, bool doparseDST)
 {
-    char *tz, *t, *u, *v;
-    int diffNorm = 0;
-    int diffDST = 0;
-    int it;
+    char *tz;
     int DSTonYear, DSTonMonth, DSTonDay, DSTonHour, DSTonMinute;
     int DSToffYear, DSToffMonth, DSToffDay, DSToffHour, DSToffMinute;
 
@@ -6623,17 +6678,14 @@ bool parseTZ(int index, int currYear, bool doparseDST)
 
     couldDST[index] = false;
     tzForYear[index] = 0;
-    if(!tzDSTpart[index]) {
-        tzDiffGMT[index] = tzDiffGMTDST[index] = 0;
-    }
-
-    // 0) Basic validity check
 
     if(*tz == 0) {                                    // Empty string. OK, don't use TZ. So be it.
         tzHasDST[index] = 0;
         return true;
     }
 
+    // 1) Compile TZ string
+
     if(tzIsValid[index] < 1) {
 
         // If previously determined to be invalid, bail.
@@ -6642,171 +6694,52 @@ bool parseTZ(int index, int currYear, bool doparseDST)
         // Set TZ to "invalid" until verified
         tzIsValid[index] = 0;
 
-        t = tz;
-        while((t = strchr(t, '>'))) { t++; diffNorm++; }
-        t = tz;
-        while((t = strchr(t, '<'))) { t++; diffDST++; }
-        if(diffNorm != diffDST) return false;         // Uneven < and >, string is bad.
-    }
-
-    // 1) Find difference between nonDST and DST time
+        if(!compileTZ(tz, tzRule[index])) return false;
 
-    if(!tzDSTpart[index]) {
+        tzIsValid[index] = 1;   // TZ is valid
 
-        diffNorm = diffDST = 0;
+        memset((void *)DSTCache[index], 0, sizeof(DSTCache[index]));
+        DSTCacheNext[index] = 0;
 
-        // a. Skip TZ name and parse GMT-diff
-        t = tz;
-        if(*t == '<') {
-           t = strchr(t, '>');
-           if(!t) return false;                       // if <, but no >, string is bad. Bad TZ.
-           t++;
-        } else {
-           while(*t && *t != '-' && (*t < '0' || *t > '9')) {
-              if(*t == ',') return false;
-              t++;
-           }
-        }
-        
-        // t = start of diff to GMT
-        if(*t != '-' && *t != '+' && (*t < '0' || *t > '9'))
-            return false;                             // No numerical difference after name -> bad string. Bad TZ.
-    
-        t = parseInt(t, it);
-        if(it >= -24 && it <= 24) diffNorm = it * 60;
-        else                      return false;       // Bad hr difference. No DST.
-        
-        if(*t == ':') {
-            t++;
-            u = parseInt(t, it);
-            if(!u) return false;                      // No number following ":". Bad string. Bad TZ.
-            t = u;
-            if(it >= 0 && it <= 59) {
-                if(diffNorm < 0)  diffNorm -= it;
-                else              diffNorm += it;
-            } else return false;                      // Bad min difference. Bad TZ.
-            if(*t == ':') {
-                t++;
-                u = parseInt(t, it);
-                if(u) t = u;
-                // Ignore seconds
-            }
-        }
-        
-        // b. Skip DST TZ name and parse GMT-diff
-        
-        if(*t == '<') {
-           t = strchr(t, '>');
-           if(!t) return false;                       // if <, but no >, string is bad. Bad TZ.
-           t++;
-        } else {
-           while(*t && *t != ',' && *t != '-' && (*t < '0' || *t > '9'))
-              t++;
+        if(tzRule[index].hasDST < 0) {
+            tzHasDST[index] = 0;
+            return false;
         }
         
-        // t = assumed start of DST-diff to GMT
-        if(*t == 0) {
-            tzDiff[index] = 0;
-        } else if(*t != '-' && *t != '+' && (*t < '0' || *t > '9')) {
-            tzDiff[index] = 60;                       // No numerical difference after name -> Assume 1 hr
-        } else {
-            t = parseInt(t, it);
-            if(it >= -24 && it <= 24) diffDST = it * 60;
-            else                      return false;   // Bad hr difference. Bad TZ.
-            if(*t == ':') {
-                t++;
-                u = parseInt(t, it);
-                if(!u) return false;                  // No number following ":". Bad TZ.
-                t = u;
-                if(it >= 0 && it <= 59) {
-                    if(diffDST < 0)  diffDST -= it;
-                    else             diffDST += it;
-                } else return false;                  // Bad min difference. Bad TZ.
-                if(*t == ':') {
-                    t++;
-                    u = parseInt(t, it);
-                    if(u) t = u;
-                    // Ignore seconds
-                }
-            }
-            tzDiff[index] = -(diffDST - diffNorm);
-        }
-    
-        tzDiffGMT[index] = diffNorm;
-        tzDiffGMTDST[index] = tzDiffGMT[index] - tzDiff[index];
-    
-        tzDSTpart[index] = t;
-
-        tzIsValid[index] = 1;   // TZ is valid
-
-    } else {
-
-        t = tzDSTpart[index];
-      
     }
 
     if(!tzHasDST[index] || !doparseDST) {
         return true;
     }
     
-    if(*t == 0 || *t != ',') {                        // No DST definition. No DST.
+    if(!tzRule[index].hasDST) {                       // No DST definition. No DST.
         tzHasDST[index] = 0;
         return true;
     }
 
-    t++;
-
     tzForYear[index] = currYear;
 
-    // Set to "no DST" until verified valid
-    tzHasDST[index] = 0;
-
-    // 2) parse DST start
-
-    v = t;
-    u = parseDST(t, DSTonYear, DSTonMonth, DSTonDay, DSTonHour, DSTonMinute, currYear, 0);
-    if(!u) return false;
-
-    // If start crosses end year (due to hour numbers >= 24), need to calculate 
-    // for previous year (which then might be in current year). 
-    // The same goes for the other direction vice versa.
-    if(DSTonYear > currYear) {
-        u = parseDST(v, DSTonYear, DSTonMonth, DSTonDay, DSTonHour, DSTonMinute, currYear-1, 0);
-        if(!u) return false;
-        // Trigger check below if still outside of current year
-        if(DSTonYear != currYear) DSTonYear = currYear + 1;
-    } else if(DSTonYear < currYear) {
-        u = parseDST(v, DSTonYear, DSTonMonth, DSTonDay, DSTonHour, DSTonMinute, currYear+1, 0);
-        if(!u) return false;
-        // Trigger check below if still outside of current year
-        if(DSTonYear != currYear) DSTonYear = currYear - 1;
+    // Use cached data if this year was evaluated before
+    for(int i = 0; i < TZ_DSTCACHE_SIZE; i++) {
+        if(DSTCache[index][i].year == currYear) {
+            couldDST[index] = DSTCache[index][i].couldDST;
+            DSTonMins[index] = DSTCache[index][i].onMins;
+            DSToffMins[index] = DSTCache[index][i].offMins;
+            return true;
+        }
     }
-    
-    t = u;
-
-    if(*t == 0 || *t != ',') return false;          // Have start, but no end. Bad string. No DST.
-    t++;
 
-    // 3) parse DST end
+    // Set to "no DST" until verified valid
+    tzHasDST[index] = 0;
 
-    v = t;
-    u = parseDST(t, DSToffYear, DSToffMonth, DSToffDay, DSToffHour, DSToffMinute, currYear, tzDiff[index]);
-    if(!u) return false;
+    // 2) Evaluate DST start & end for given year
 
-    // See above
-    if(DSToffYear > currYear) {
-        u = parseDST(v, DSToffYear, DSToffMonth, DSToffDay, DSToffHour, DSToffMinute, currYear-1, tzDiff[index]);
-        if(!u) return false;
-        // Trigger check below if still outside of current year
-        if(DSToffYear != currYear) DSToffYear = currYear + 1;
-    } else if(DSToffYear < currYear) {
-        u = parseDST(v, DSToffYear, DSToffMonth, DSToffDay, DSToffHour, DSToffMinute, currYear+1, tzDiff[index]);
-        if(!u) return false;
-        // Trigger check below if still outside of current year
-        if(DSToffYear != currYear) DSToffYear = currYear - 1;
-    }
+    if(!evalDSTRuleForYear(tzRule[index].DSTon, DSTonYear, DSTonMonth, DSTonDay, DSTonHour, DSTonMinute, currYear, 0))
+        return false;
+    if(!evalDSTRuleForYear(tzRule[index].DSToff, DSToffYear, DSToffMonth, DSToffDay, DSToffHour, DSToffMinute, currYear, tzRule[index].diff))
+        return false;
 
-    // 4) Evaluate results
+    // 3) Evaluate results
 
     tzHasDST[index] = 1;  // TZ has valid DST definition
 
@@ -6846,12 +6779,22 @@ bool parseTZ(int index, int currYear, bool doparseDST)
         #ifdef TC_DBG_TIME
         Serial.printf("parseTZ: (%d) %d/%d(%d) DST %d-%02d-%02d/%02d:%02d - %d-%02d-%02d/%02d:%02d\n",
                     index,
-                    tzDiffGMT[index], tzDiffGMTDST[index], tzDiff[index],
+                    tzRule[index].diffGMT, tzRule[index].diffGMTDST, tzRule[index].diff,
                     DSTonYear, DSTonMonth, DSTonDay, DSTonHour, DSTonMinute,
                     DSToffYear, DSToffMonth, DSToffDay, DSToffHour, DSToffMinute);
         #endif
 
     }
+
+    // Cache results for this year, replacing the oldest entry
+    {
+        int i = DSTCacheNext[index];
+        DSTCache[index][i].year = currYear;
+        DSTCache[index][i].couldDST = couldDST[index];
+        DSTCache[index][i].onMins = DSTonMins[index];
+        DSTCache[index][i].offMins = DSToffMins[index];
+        DSTCacheNext[index] = (i + 1) % TZ_DSTCACHE_SIZE;
+    }
         
     return true;
 }
@@ -6880,53 +6823,62 @@ int timeIsDST(int index, int year, int month, int day, int hour, int mins, int&
 
 /*
  * Conversion from/to UTC
+ * dayNum, if given, caches the day number of the given date
+ * across calls with the same date (-1 = not calculated yet).
  */
-static void convTime(int diff, int& y, int& m, int& d, int& h, int& mm)
+static void convTime(int diff, int& y, int& m, int& d, int& h, int& mm, int32_t *dayNum)
 {
+    int32_t dd, days;
+
+    if(!diff) return;
+
+    mm += (h * 60) - diff;
     
-    if(diff > 0) {
+    // Days to move (floored)
+    if(mm < 0) {
+        dd = -((-mm + (24*60 - 1)) / (24*60));
+    } else {
+        dd = mm / (24*60);
+    }
+    mm -= dd * (24*60);
 
-        mm -= diff;
-        while(mm < 0) {
-            mm += 60;
-            h--;
-        }
-        while(h < 0) {
-            h += 24;
-            d--;
-        }
-        while(d < 1) {
-            m--;
-            if(m < 1) {
-                m = 12;
-                y--;
-                if(y < 1) y = 9999;
-            }
-            d += daysInMonth(m, y);
-        }
-        
-    } else if(diff < 0) {
+    h = mm / 60;
+    mm -= h * 60;
+
+    if(!dd) return;
 
-        mm -= diff;
-        while(mm > 59) {
-            mm -= 60;
-            h++;
+    // One day back or forth within the month needs no day numbers
+    #ifdef TC_JULIAN_CAL
+    if(y != jSwitchYear || m != jSwitchMon)
+    #endif
+    {
+        if(dd == -1 && d > 1) {
+            d--;
+            return;
         }
-        while(h > 23) {
-            h -= 24;
+        if(dd == 1 && d < daysInMonth(m, y)) {
             d++;
+            return;
         }
-        while(d > daysInMonth(m, y)) {
-            d -= daysInMonth(m, y);
-            m++;
-            if(m > 12) {
-                m = 1;
-                y++;
-                if(y > 9999) y = 1;
-            }
-        }
+    }
+
+    if(dayNum) {
+        if(*dayNum < 0) *dayNum = dateToDays(y, m, d);
+        days = *dayNum;
+    } else {
+        days = dateToDays(y, m, d);
+    }
+
+    // Years wrap from 9999 to 1 and vice versa
+    days += dd;
 
+    if(days < yr1Days) {
+        days += yr10kDays - yr1Days;
+    } else if(days >= yr10kDays) {
+        days -= yr10kDays - yr1Days;
     }
+
+    daysToDate(days, y, m, d);
 }
 
 static uint32_t 
@@ -6940,24 +6892,23 @@ h(uint8_t *n, uint32_t h, uint32_t m)
     return h;
 }
 
-void UTCtoLocal(DateTime &dtu, DateTime& dtl, int index)
+static void UTCtoLocalInt(const DateTime &dtu, DateTime& dtl, int index, int32_t *utcDayNum)
 {
     int y  = dtu.year();
     int m  = dtu.month();
     int d  = dtu.day();
     int h  = dtu.hour();
     int mm = dtu.minute();
-    int y2 = y, m2 = m, d2 = d, h2 = h, mm2 = mm;
     int ctm = 0;
 
     #ifdef TC_DBG_TIME
     if(dtu.second() == 30) {
-        Serial.printf("UTCtoLocal: (%d) UTC:   %d-%d-%d %d:%d\n", index, y, m, d, h, mm, dtu.second());
+        Serial.printf("UTCtoLocal: (%d) UTC:   %d-%d-%d %d:%d\n", index, y, m, d, h, mm);
     }
     #endif
 
     // Convert to local (non-DST)
-    convTime(tzDiffGMT[index], y, m, d, h, mm);
+    convTime(tzRule[index].diffGMT, y, m, d, h, mm, utcDayNum);
 
     // Check for DST
     if(couldDST[index]) {
@@ -6965,8 +6916,8 @@ void UTCtoLocal(DateTime &dtu, DateTime& dtl, int index)
             parseTZ(index, y);
         }
         if(timeIsDST(index, y, m, d, h, mm, ctm)) {
-            y = y2; m = m2; d = d2; h = h2; mm = mm2;
-            convTime(tzDiffGMTDST[index], y, m, d, h, mm);
+            y = dtu.year(); m = dtu.month(); d = dtu.day(); h = dtu.hour(); mm = dtu.minute();
+            convTime(tzRule[index].diffGMTDST, y, m, d, h, mm, utcDayNum);
         }
     }
 
@@ -6974,15 +6925,45 @@ void UTCtoLocal(DateTime &dtu, DateTime& dtl, int index)
 
     #ifdef TC_DBG_TIME
     if(dtu.second() == 30) {
-        Serial.printf("UTCtoLocal: (%d) Local: %d-%d-%d %d:%d\n", index, y, m, d, h, mm, dtu.second());
+        Serial.printf("UTCtoLocal: (%d) Local: %d-%d-%d %d:%d\n", index, y, m, d, h, mm);
     }
     #endif
 }
 
+void UTCtoLocal(DateTime &dtu, DateTime& dtl, int index)
+{
+    int32_t utcDayNum = -1;
+    
+    UTCtoLocalInt(dtu, dtl, index, &utcDayNum);
+}
+
+/*
+ * Convert UTC to local time for all displays in one go: 
+ * The UTC day number is calculated at most once (and only if 
+ * any time zone's offset moves the date into another month), 
+ * the local times for all time zones are derived from it by 
+ * offset arithmetic.
+ * Sets gdtl, and - in WC mode, if the minute changed or an 
+ * update was triggered - destination and departed times.
+ */
+void updateAllTimes(const DateTime& dtu)
+{
+    int32_t utcDayNum = -1;
+
+    UTCtoLocalInt(dtu, gdtl, 0, &utcDayNum);
+
+    if(isWcMode()) {
+        if((dtu.minute() != wcLastMin) || (wcf & WCF_Trigger)) {
+            wcLastMin = dtu.minute();
+            setDatesTimesWCInt(dtu, &utcDayNum);
+        }
+    }
+}
+
 void LocalToUTC(int& ny, int& nm, int& nd, int& nh, int& nmm, int index)
 {
     int ctm;
-    int diff = tzDiffGMT[index];
+    int diff = tzRule[index].diffGMT;
 
     #ifdef TC_DBG_TIME
     Serial.printf("LocalToUTC: (%d) Local: %d-%d-%d %d:%d\n", index, ny, nm, nd, nh, nmm);
@@ -6990,7 +6971,7 @@ void LocalToUTC(int& ny, int& nm, int& nd, int& nh, int& nmm, int index)
 
     if(couldDST[index]) {
         if(timeIsDST(index, ny, nm, nd, nh, nmm, ctm)) {
-            diff = tzDiffGMTDST[index];
+            diff = tzRule[index].diffGMTDST;
         }
     }
 
@@ -7130,7 +7111,7 @@ static bool NTPHaveCurrentTime()
 // Get UTC time from NTP response
 static bool NTPGetUTC(int& year, int& month, int& day, int& hour, int& minute, int& second)
 {
-    uint32_t temp, c;
+    uint32_t temp;
 
     // Fail if no time received (or stamp is timed out)
     if(!NTPHaveCurrentTime()) return false;
@@ -7143,26 +7124,9 @@ static bool NTPGetUTC(int& year, int& month, int& day, int& hour, int& minute, i
     uint32_t total32 = secsSinceTCepoch / 60;
 
     // Calculate current date
-    year = c = TCEPOCH;
-    while(1) {
-        temp = isLeapYear(c++) ? ((8760+24)*60) : (8760*60);
-        if(total32 < temp) break;
-        year++;
-        total32 -= temp;
-    }
-
-    c = 1;
-    temp = isLeapYear(year) ? 1 : 0;
-    while(c < 12) {
-        if(total32 < (mon_ydayt24t60[temp][c])) break;
-        c++;
-    }
-    month = c;
-    total32 -= (mon_ydayt24t60[temp][c-1]);
-
-    day = total32 / (24*60);
-    total32 -= (day * (24*60));
-    day++;
+    temp = total32 / (24*60);
+    total32 -= (temp * (24*60));
+    daysToGreg(gregToDays(TCEPOCH, 1, 1) + temp, year, month, day);
 
     hour = total32 / 60;
 
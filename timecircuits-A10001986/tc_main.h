@@ -183,6 +183,7 @@ int       mins2Date(int year, int month, int day, int hour, int mins);
 bool      parseTZ(int index, int currYear, bool doparseDST = true);
 int       timeIsDST(int index, int year, int month, int day, int hour, int mins, int& currTimeMins);
 void      UTCtoLocal(DateTime &dtu, DateTime& dtl, int index);
+void      updateAllTimes(const DateTime& dtu);
 void      LocalToUTC(int& ny, int& nm, int& nd, int& nh, int& nmm, int index);
 
 void      ntp_setup(bool doUseNTP, IPAddress& ntpServer, bool couldHaveNTP, bool ntpLUF);
@@ -0,0 +1,153 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Music file name sorting
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_MPSORT_H
+#define _TC_MPSORT_H
+
+/*
+ * Sorting of file names for the music folder renamer
+ * 
+ * Names are compared case-insensitively (a-z folded to A-Z). Every
+ * entry carries its first four folded characters as an integer key,
+ * so that most comparisons need neither strlen() nor a loop. The
+ * sort is a stable merge sort; a plain insertion sort is used if
+ * there is no memory for the merge buffer.
+ * 
+ * This header must not depend on anything Arduino/ESP32 specific,
+ * so that it can be compiled and benchmarked on a host.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+struct MpSortEnt {
+    uint32_t key;         // First four characters, folded, big endian
+    char     *name;
+};
+
+static inline unsigned char mpsort_fold(char a)
+{
+    if(a >= 'a' && a <= 'z')
+        a &= ~0x20;
+
+    return (unsigned char)a;
+}
+
+static inline void mpsort_setEnt(MpSortEnt *e, char *name)
+{
+    uint32_t k = 0;
+    int      i;
+
+    for(i = 0; i < 4 && name[i]; i++) {
+        k = (k << 8) | mpsort_fold(name[i]);
+    }
+    e->key = i ? k << ((4 - i) * 8) : 0;
+    e->name = name;
+}
+
+static inline int mpsort_cmp(const MpSortEnt *a, const MpSortEnt *b)
+{
+    const char *x, *y;
+
+    if(a->key != b->key)
+        return (a->key < b->key) ? -1 : 1;
+
+    x = a->name;
+    y = b->name;
+    for(;;) {
+        unsigned char xx = mpsort_fold(*x++);
+        unsigned char yy = mpsort_fold(*y++);
+        if(xx != yy) return (xx < yy) ? -1 : 1;
+        if(!xx) return 0;
+    }
+}
+
+// Sort a[0..n-1]; tmp must hold n entries, or be NULL
+static inline void mpsort_sort(MpSortEnt *a, MpSortEnt *tmp, int n)
+{
+    if(!tmp) {
+        for(int i = 1; i < n; i++) {
+            MpSortEnt t = a[i];
+            int j = i - 1;
+            while(j >= 0 && mpsort_cmp(&a[j], &t) > 0) {
+                a[j + 1] = a[j];
+                j--;
+            }
+            a[j + 1] = t;
+        }
+        return;
+    }
+
+    // Bottom-up, merging back and forth between a and tmp
+    MpSortEnt *src = a, *dst = tmp, *sw;
+
+    for(int w = 1; w < n; w <<= 1) {
+        for(int lo = 0; lo < n; lo += 2 * w) {
+            int mid = (lo + w < n) ? lo + w : n;
+            int hi = (lo + 2 * w < n) ? lo + 2 * w : n;
+            int i = lo, j = mid, k = lo;
+            while(i < mid && j < hi) {
+                dst[k++] = (mpsort_cmp(&src[j], &src[i]) < 0) ? src[j++] : src[i++];
+            }
+            while(i < mid) dst[k++] = src[i++];
+            while(j < hi)  dst[k++] = src[j++];
+        }
+        sw = src; src = dst; dst = sw;
+    }
+
+    if(src != a) memcpy((void *)a, (void *)src, n * sizeof(MpSortEnt));
+}
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Loop Profiler
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tc_global.h"
+
+#ifdef TC_PROFILER
+
+#include <Arduino.h>
+
+#include "tc_prof.h"
+#include "tc_sched.h"
+#include "tc_wifi.h"
+
+static ProfData       prof[PROF_NUM];
+static uint32_t       profMHz = 240;
+static unsigned long  profLastReport = 0;
+static unsigned long  profLastMHz = 0;
+
+#define PROF_REPORT_INTERVAL (5*60*1000)
+
+static const char *profNames[PROF_TASK0] = {
+    "mydelay", "i2c", "fileread", "audio", "display"
+};
+
+void prof_setup()
+{
+    profMHz = getCpuFrequencyMhz();
+    prof_reset();
+}
+
+void prof_loop()
+{
+    unsigned long now = millis();
+
+    // CPU speed changes in power save mode
+    if(now - profLastMHz >= 1000) {
+        profMHz = getCpuFrequencyMhz();
+        profLastMHz = now;
+    }
+
+    if(now - profLastReport >= PROF_REPORT_INTERVAL) {
+        char *buf = (char *)malloc(PROF_NUM * 160);
+        if(buf) {
+            prof_report(buf, PROF_NUM * 160);
+            Serial.print(buf);
+            free(buf);
+        }
+        profLastReport = now;
+    }
+}
+
+void prof_add(int probe, uint32_t cycles)
+{
+    ProfData *p = &prof[probe];
+    uint32_t mhz = profMHz;
+    uint32_t us = cycles / mhz;
+    int b = us ? 32 - __builtin_clz(us) : 0;
+
+    if(b >= PROF_BUCKETS) b = PROF_BUCKETS - 1;
+
+    // Convert with the clock the sample was taken at;
+    // it changes in power save mode
+    p->count++;
+    p->total += ((uint64_t)us * 1000) + (((cycles - (us * mhz)) * 1000) / mhz);
+    if(us > p->max) p->max = us;
+    p->hist[b]++;
+}
+
+const char *prof_getName(int probe)
+{
+    const SchedTask *t;
+    
+    if(probe < 0 || probe >= PROF_NUM)
+        return NULL;
+    if(probe < PROF_TASK0)
+        return profNames[probe];
+    if((t = sched_getTask(probe - PROF_TASK0)))
+        return t->name;
+
+    return NULL;
+}
+
+const ProfData *prof_getData(int probe)
+{
+    if(probe < 0 || probe >= PROF_NUM)
+        return NULL;
+
+    return &prof[probe];
+}
+
+/*
+ * Text report, one line per probe. Histogram buckets are
+ * listed as <upper limit in us>:<count>, the last one as
+ * >=<lower limit in us>:<count>; empty buckets are skipped.
+ */
+int prof_report(char *buf, int bufLen)
+{
+    int l = 0;
+    
+    l += snprintf(buf + l, bufLen - l, "Probe        count   avg us   max us  histogram\n");
+    
+    for(int i = 0; i < PROF_NUM && l < bufLen; i++) {
+        const char *n = prof_getName(i);
+        ProfData *p = &prof[i];
+        if(!n || !p->count) continue;
+        l += snprintf(buf + l, bufLen - l, "%-10s %7u %8u %8u ", n, p->count, 
+                  (uint32_t)(p->total / p->count / 1000), p->max);
+        for(int b = 0; b < PROF_BUCKETS && l < bufLen; b++) {
+            if(!p->hist[b]) continue;
+            if(b == PROF_BUCKETS - 1) {
+                l += snprintf(buf + l, bufLen - l, " >=%u:%u", 1 << (b - 1), p->hist[b]);
+            } else {
+                l += snprintf(buf + l, bufLen - l, " <%u:%u", 1 << b, p->hist[b]);
+            }
+        }
+        if(l < bufLen) {
+            l += snprintf(buf + l, bufLen - l, "\n");
+        }
+    }
+
+    return (l < bufLen) ? l : bufLen - 1;
+}
+
+void prof_reset()
+{
+    memset((void *)prof, 0, sizeof(prof));
+}
+
+#ifdef TC_HAVEMQTT
+/*
+ * Publish one message per probe to bttf/tcd/prof
+ */
+void prof_mqttReport()
+{
+    char msg[384];
+    
+    if(!mqttConnected())
+        return;
+
+    for(int i = 0; i < PROF_NUM; i++) {
+        const char *n = prof_getName(i);
+        ProfData *p = &prof[i];
+        int l;
+        if(!n || !p->count) continue;
+        l = sprintf(msg, "{\"P\":\"%s\",\"N\":%u,\"A\":%u,\"M\":%u,\"H\":[", n, p->count, 
+                  (uint32_t)(p->total / p->count / 1000), p->max);
+        for(int b = 0; b < PROF_BUCKETS; b++) {
+            l += sprintf(msg + l, b ? ",%u" : "%u", p->hist[b]);
+        }
+        strcpy(msg + l, "]}");
+        mqttPublish("bttf/tcd/prof", msg, strlen(msg) + 1);
+    }
+}
+#endif
+
+#endif  // TC_PROFILER
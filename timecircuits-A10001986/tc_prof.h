@@ -0,0 +1,130 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Loop Profiler
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_PROF_H
+#define _TC_PROF_H
+
+/*
+ * Loop profiler
+ * 
+ * Enabled by TC_PROFILER (tc_global.h); when not defined, all
+ * PROF_xxx macros compile to nothing.
+ * 
+ * Durations are taken from the CPU cycle counter and sorted into
+ * log2 histograms: Bucket 0 is < 1us, bucket b covers 2^(b-1) to 
+ * 2^b - 1 us, the last bucket takes 2^(b-1) us and above.
+ * 
+ * Every probe must only ever be hit from one task: Scheduler and
+ * delay probes from loop(), I2C transactions from the I2C task,
+ * file reads from the audio task.
+ */
+
+#include "tc_sched.h"
+
+#define PROF_DELAY    0     // mydelay()
+#define PROF_I2C      1     // I2C transactions
+#define PROF_FREAD    2     // SD/flash file reads (audio)
+#define PROF_AUDIO    3     // Audio slot in loop()
+#define PROF_DISP     4     // Display update in main_loop()
+#define PROF_TASK0    5     // Scheduler tasks, in order of registration
+#define PROF_NUM      (PROF_TASK0 + SCHED_MAX_TASKS)
+
+#define PROF_BUCKETS  20
+
+#ifdef TC_PROFILER
+
+#include <Arduino.h>
+
+struct ProfData {
+    uint32_t count;
+    uint32_t max;           // us
+    uint64_t total;         // ns
+    uint32_t hist[PROF_BUCKETS];
+};
+
+void  prof_setup();
+void  prof_loop();
+void  prof_add(int probe, uint32_t cycles);
+
+const char      *prof_getName(int probe);
+const ProfData  *prof_getData(int probe);
+int             prof_report(char *buf, int bufLen);
+void            prof_reset();
+#ifdef TC_HAVEMQTT
+void            prof_mqttReport();
+#endif
+
+class ProfScope {
+    public:
+        ProfScope(int probe) : _probe(probe), _start(ESP.getCycleCount()) {}
+        ~ProfScope() { prof_add(_probe, ESP.getCycleCount() - _start); }
+    private:
+        int      _probe;
+        uint32_t _start;
+};
+
+#define PROF_START(v)       uint32_t v = ESP.getCycleCount()
+#define PROF_END(probe, v)  prof_add((probe), ESP.getCycleCount() - (v))
+#define PROF_SCOPE(probe)   ProfScope _profScope(probe)
+
+#else
+
+#define PROF_START(v)
+#define PROF_END(probe, v)
+#define PROF_SCOPE(probe)
+
+#endif  // TC_PROFILER
+
+#endif
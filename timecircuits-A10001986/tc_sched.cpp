@@ -0,0 +1,231 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Cooperative Scheduler
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A minimal cooperative scheduler for loop().
+ * 
+ * Every subsystem registers a task with a period and a worst case 
+ * budget. Tasks are run in the order of registration; a task with 
+ * a period of 0 is run on every pass. After each task, the audio 
+ * slot is run if it has not been run within the audio period 
+ * (0 = after every task, which is what loop() always did).
+ * 
+ * Decoding itself runs in the audio task, which reports every pass
+ * through sched_audioServiced(), so the gap between two services 
+ * is measured where it matters. A gap larger than the deadline 
+ * (while playing) means the I2S DMA buffers possibly ran dry.
+ */
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+
+#include "tc_sched.h"
+#include "tc_prof.h"
+
+static SchedTask  tasks[SCHED_MAX_TASKS];
+static int        numTasks = 0;
+
+static schedFunc      audioFunc = NULL;
+static uint32_t       audioPeriod = 0;
+static uint32_t       audioDeadline = SCHED_AUDIO_DEADLINE;
+static unsigned long  audioLast = 0;        // audio task only
+static unsigned long  audioSlotLast = 0;
+static std::atomic<bool> audioWasPlaying{false};
+static SchedAudio     audioStats;
+
+#ifdef TC_DBG_SCHED
+static unsigned long  lastStatsNow = 0;
+#define SCHED_STATS_INTERVAL (60*1000)
+#endif
+
+int sched_add(const char *name, schedFunc func, uint32_t period, uint32_t budget)
+{
+    if(numTasks >= SCHED_MAX_TASKS)
+        return -1;
+
+    SchedTask *t = &tasks[numTasks];
+
+    memset((void *)t, 0, sizeof(SchedTask));
+    t->name = name;
+    t->func = func;
+    t->period = period;
+    t->budget = budget;
+
+    return numTasks++;
+}
+
+void sched_setAudio(schedFunc func, uint32_t period, uint32_t deadline)
+{
+    audioFunc = func;
+    audioPeriod = period;
+    audioDeadline = deadline;
+}
+
+static void sched_runAudio()
+{
+    if(!audioFunc)
+        return;
+
+    if(audioPeriod && (micros() - audioSlotLast < audioPeriod))
+        return;
+
+    audioSlotLast = micros();
+
+    PROF_START(pc);
+    audioFunc();
+    PROF_END(PROF_AUDIO, pc);
+}
+
+void sched_loop()
+{
+    for(int i = 0; i < numTasks; i++) {
+        SchedTask *t = &tasks[i];
+        unsigned long now = micros();
+        uint32_t elapsed;
+
+        if(t->period && t->runCount && (now - t->lastRun < t->period))
+            continue;
+
+        t->lastRun = now;
+        PROF_START(pc);
+        t->func();
+        PROF_END(PROF_TASK0 + i, pc);
+        elapsed = micros() - now;
+
+        t->runCount++;
+        if(elapsed > t->maxTime) t->maxTime = elapsed;
+        if(t->budget && elapsed > t->budget) t->overruns++;
+
+        sched_runAudio();
+    }
+
+    #ifdef TC_PROFILER
+    prof_loop();
+    #endif
+
+    #ifdef TC_DBG_SCHED
+    if(millis() - lastStatsNow >= SCHED_STATS_INTERVAL) {
+        sched_printStats();
+        lastStatsNow = millis();
+    }
+    #endif
+}
+
+/*
+ * Called by the audio task
+ */
+void sched_audioServiced(bool playing)
+{
+    unsigned long now = micros();
+
+    if(playing) {
+        if(audioWasPlaying.load(std::memory_order_relaxed)) {
+            uint32_t gap = now - audioLast;
+            if(gap > audioStats.maxGap.load(std::memory_order_relaxed)) {
+                audioStats.maxGap.store(gap, std::memory_order_relaxed);
+            }
+            if(gap > audioDeadline) audioStats.late.fetch_add(1, std::memory_order_relaxed);
+        }
+        audioStats.serviced.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    audioLast = now;
+    audioWasPlaying.store(playing, std::memory_order_relaxed);
+}
+
+/*
+ * Statistics
+ */
+
+int sched_numTasks()
+{
+    return numTasks;
+}
+
+const SchedTask *sched_getTask(int idx)
+{
+    if(idx < 0 || idx >= numTasks)
+        return NULL;
+
+    return &tasks[idx];
+}
+
+const SchedAudio *sched_getAudio()
+{
+    return &audioStats;
+}
+
+void sched_resetStats()
+{
+    for(int i = 0; i < numTasks; i++) {
+        tasks[i].runCount = tasks[i].overruns = tasks[i].maxTime = 0;
+    }
+    audioStats.serviced.store(0, std::memory_order_relaxed);
+    audioStats.late.store(0, std::memory_order_relaxed);
+    audioStats.maxGap.store(0, std::memory_order_relaxed);
+    audioWasPlaying.store(false, std::memory_order_relaxed);
+}
+
+void sched_printStats()
+{
+    for(int i = 0; i < numTasks; i++) {
+        Serial.printf("%-10s: runs %u overruns %u (budget %uus) max %uus\n",
+            tasks[i].name, tasks[i].runCount, tasks[i].overruns, 
+            tasks[i].budget, tasks[i].maxTime);
+    }
+    Serial.printf("audio     : serviced %u late %u (deadline %uus) max gap %uus\n",
+        audioStats.serviced.load(), audioStats.late.load(), audioDeadline, audioStats.maxGap.load());
+}
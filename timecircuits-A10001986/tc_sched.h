@@ -0,0 +1,100 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2021-2022 John deGlavina https://circuitsetup.us
+ * (C) 2022-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ * https://tcd.out-a-ti.me
+ *
+ * Cooperative Scheduler
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_SCHED_H
+#define _TC_SCHED_H
+
+#include <atomic>
+
+#define SCHED_MAX_TASKS 8
+
+// Deadline for servicing audio: The I2S output has 32 DMA buffers
+// of 64 samples; at 44.1kHz, that is ~46ms until the output runs 
+// dry. We allow a little less.
+#define SCHED_AUDIO_DEADLINE 40000    // us
+
+typedef void (*schedFunc)(void);
+
+struct SchedTask {
+    const char    *name;
+    schedFunc     func;
+    uint32_t      period;     // us, 0 = every pass
+    uint32_t      budget;     // us, worst case run time
+    unsigned long lastRun;    // micros()
+    uint32_t      runCount;
+    uint32_t      overruns;   // run time > budget
+    uint32_t      maxTime;    // us
+};
+
+// Written by the audio task, read and reset by loop()
+struct SchedAudio {
+    std::atomic<uint32_t> serviced;   // number of audio services while playing
+    std::atomic<uint32_t> late;       // gap between services > deadline
+    std::atomic<uint32_t> maxGap;     // us
+};
+
+int   sched_add(const char *name, schedFunc func, uint32_t period, uint32_t budget);
+void  sched_setAudio(schedFunc func, uint32_t period, uint32_t deadline = SCHED_AUDIO_DEADLINE);
+void  sched_loop();
+
+void  sched_audioServiced(bool playing);
+
+int               sched_numTasks();
+const SchedTask  *sched_getTask(int idx);
+const SchedAudio *sched_getAudio();
+void              sched_resetStats();
+void              sched_printStats();
+
+#endif
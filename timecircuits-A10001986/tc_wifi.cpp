@@ -70,6 +70,12 @@
 #include "tc_settings.h"
 #include "tc_wifi.h"
 #include "tc_keypad.h"
+#include "tc_prof.h"
+#include "tc_i2c.h"
+#include "input.h"
+#ifdef TC_AUDIO_CACHE
+#include "tc_audcache.h"
+#endif
 #ifdef TC_HAVEMQTT
 #include "mqtt.h"
 #endif
@@ -89,6 +95,9 @@ unsigned long mqttInitialConnectNow = 0;
 #endif
 
 static const char R_updateacdone[] = "/uac";
+#ifdef TC_PROFILER
+static const char R_prof[] = "/prof";
+#endif
 
 static const char acul_part1[]  = "</style>";
 static const char acul_part3[]  = "</head><body><div id='wrap'><h1 id='h1'>";
@@ -1983,7 +1992,7 @@ static void preUpdateCallback()
 
     csf |= CSF_REBOOT;  // Force MP "off" state
     mp_stop(true);
-    stopAudio();
+    stopAudio(true);    // Uploads may replace sound files
 
     ettoPulseEnd();
     send_abort_msg();
@@ -2780,9 +2789,36 @@ static const char *wmBuildMQTTTM(const char *dest, int op)
  * Audio data uploader
  */
 
+#ifdef TC_PROFILER
+static void handleProf()
+{
+    int  bufLen = PROF_NUM * 160 + 2048;
+    char *buf = (char *)malloc(bufLen);
+
+    if(!buf) {
+        wm.server->send(500, "text/plain", "Out of memory");
+        return;
+    }
+    
+    int l = prof_report(buf, bufLen);
+    l += tcd_report(buf + l, bufLen - l);
+    l += i2c_report(buf + l, bufLen - l);
+    l += kpd_report(buf + l, bufLen - l);
+    l += audio_report(buf + l, bufLen - l);
+    #ifdef TC_AUDIO_CACHE
+    audc_report(buf + l, bufLen - l);
+    #endif
+    wm.server->send(200, "text/plain", buf);
+    free(buf);
+}
+#endif
+
 static void setupWebServerCallback()
 {
     wm.server->on(R_updateacdone, HTTP_POST, &handleUploadDone, &handleUploading);
+    #ifdef TC_PROFILER
+    wm.server->on(R_prof, HTTP_GET, &handleProf);
+    #endif
 }
 
 static void doReboot()
@@ -2941,6 +2977,11 @@ static void handleUploadDone()
     Serial.printf("handleUploadDone: %d files uploaded\n", numUploads);
     #endif
 
+    #ifdef TC_AUDIO_CACHE
+    // Uploaded files might replace cached sounds
+    if(numUploads) audio_cache_flush();
+    #endif
+
     for(int i = 0; i < numUploads; i++) {
         if(opType[i] > 0) {
             haveAC = true;
@@ -3426,6 +3467,13 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
         }
         tempBuf[tempBufLen] = 0;
 
+        #ifdef TC_PROFILER
+        if(!strcmp(tempBuf, "PROF_REPORT")) {
+            prof_mqttReport();
+            return;
+        }
+        #endif
+
         // Not taking commands under these circumstances:
         if(csf & (CSF_MA|CSF_ST|CSF_P0|CSF_P1|CSF_RE)) {
             // Except status requests
@@ -62,6 +62,7 @@
 
 #include "tcddisplay.h"
 #include "tc_font.h"
+#include "tc_i2c.h"
 
 #define STRLEN(x) (sizeof(x)-1)
 
@@ -165,6 +166,44 @@ static void makeHumidity(char *buf, int hum)
 }
 #endif
 
+#ifdef TC_PROFILER
+// Display RAM writes, all displays: [0] sent, [1] saved by diffing
+static struct {
+    uint32_t txns[2];
+    uint32_t bytes[2];
+    unsigned long since;
+} tcdI2C;
+
+static void tcd_count(int full, int sent)
+{
+    if(!tcdI2C.since) tcdI2C.since = millis();
+    if(sent) {
+        tcdI2C.txns[0]++;
+        tcdI2C.bytes[0] += sent;
+    } else {
+        tcdI2C.txns[1]++;
+    }
+    tcdI2C.bytes[1] += full - sent;
+}
+
+int tcd_report(char *buf, int bufLen)
+{
+    uint32_t secs = tcdI2C.since ? (millis() - tcdI2C.since) / 1000 : 0;
+    int l;
+
+    if(!secs) secs = 1;
+
+    l = snprintf(buf, bufLen, "Display writes: %u (%u/s), %u bytes (%u/s); saved %u (%u/s), %u bytes (%u/s)\n",
+              tcdI2C.txns[0], tcdI2C.txns[0] / secs, tcdI2C.bytes[0], tcdI2C.bytes[0] / secs,
+              tcdI2C.txns[1], tcdI2C.txns[1] / secs, tcdI2C.bytes[1], tcdI2C.bytes[1] / secs);
+
+    return (l < 0) ? 0 : ((l < bufLen) ? l : bufLen - 1);
+}
+#define TCD_COUNT(f, s) tcd_count(f, s)
+#else
+#define TCD_COUNT(f, s)
+#endif
+
 /*
  * tcdDisplay class
  */
@@ -180,6 +219,8 @@ tcdDisplay::tcdDisplay(unsigned int did, uint8_t address)
 void tcdDisplay::begin()
 {
     _rtc = (_did == DISP_PRES);
+
+    _shadowValid = false;
     
     directCmd(0x20 | 1); // turn on oscillator
 
@@ -1093,29 +1134,69 @@ void tcdDisplay::clearDisplay()
 
 void tcdDisplay::directCmd(uint8_t val)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(val);
-    Wire.endTransmission();
+    i2c_write(I2CD_DEST + _did, _address, &val, 1);
 }
 
+// Writes are queued; if one failed since we last looked, we 
+// don't know what the display shows
+bool tcdDisplay::checkShadow()
+{
+    uint32_t errs = i2c_errors(I2CD_DEST + _did);
+
+    if(errs != _i2cErrs) {
+        _i2cErrs = errs;
+        _shadowValid = false;
+    }
+
+    return _shadowValid;
+}
+
+// Write the first len words to the display; only the range of
+// columns that differ from what was last written is sent.
 void tcdDisplay::directBuf(uint16_t *db, int len)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(0x00);
-    for(int i = 0; i < len; i++) {
-        Wire.write(db[i] & 0xff);
-        Wire.write(db[i] >> 8);
+    uint8_t buf[1 + CD_BUF_SIZE * 2];
+    int first = 0, last = len - 1, l = 0;
+
+    if(checkShadow()) {
+        while(first < len && db[first] == _shadow[first]) first++;
+        if(first == len) {
+            TCD_COUNT(1 + len * 2, 0);
+            return;
+        }
+        while(db[last] == _shadow[last]) last--;
+    }
+
+    buf[l++] = first * 2;
+    for(int i = first; i <= last; i++) {
+        buf[l++] = db[i] & 0xff;
+        buf[l++] = db[i] >> 8;
+        _shadow[i] = db[i];
     }
-    Wire.endTransmission();
+    i2c_write(I2CD_DEST + _did, _address, buf, l);
+    if(len == CD_BUF_SIZE) {
+        _shadowValid = true;
+    }
+
+    TCD_COUNT(1 + len * 2, 1 + (last - first + 1) * 2);
 }
 
 // Directly write to a column with supplied segments
 // (leave buffer intact, directly write to display)
 void tcdDisplay::directCol(int col, int segments)
 {
-    Wire.beginTransmission(_address);
-    Wire.write(col * 2);
-    Wire.write(segments & 0xff);
-    Wire.write(segments >> 8);
-    Wire.endTransmission();
+    uint8_t buf[3];
+
+    if(checkShadow() && _shadow[col] == (uint16_t)segments) {
+        TCD_COUNT(3, 0);
+        return;
+    }
+
+    buf[0] = col * 2;
+    buf[1] = segments & 0xff;
+    buf[2] = segments >> 8;
+    i2c_write(I2CD_DEST + _did, _address, buf, 3);
+    _shadow[col] = segments;
+
+    TCD_COUNT(3, 3);
 }
@@ -220,9 +220,13 @@ class tcdDisplay {
         void directCmd(uint8_t val);
         void directBuf(uint16_t *db, int len = CD_BUF_SIZE);
         void directCol(int col, int segments);
+        bool checkShadow();
 
         uint16_t _displayBuffer[CD_BUF_SIZE];
         uint16_t _displayBufferAlt[CD_BUF_SIZE];
+        uint16_t _shadow[CD_BUF_SIZE];  // What the display RAM holds
+        bool     _shadowValid = false;
+        uint32_t _i2cErrs = 0;          // i2c_errors() when shadow was checked
         
         unsigned int _did = 0;
         uint8_t  _address = 0;
@@ -250,4 +254,8 @@ class tcdDisplay {
         int     _savePending = 0;
 };
 
+#ifdef TC_PROFILER
+int tcd_report(char *buf, int bufLen);
+#endif
+
 #endif
@@ -1775,18 +1775,55 @@
 #include "tc_settings.h"
 #include "tc_main.h"
 #include "tc_wifi.h"
+#include "tc_sched.h"
+#include "tc_prof.h"
+#include "tc_i2c.h"
+
+static void scanKeypad_ntp()
+{
+    scanKeypad();
+    ntp_loop();
+}
+
+static void bttfn_loop_skip()
+{
+    bttfn_loop(BNLP_SK_MC|BNLP_SK_NOTDATA|BNLP_SK_EXPIRE);
+}
+
+static void bttfn_loop_all()
+{
+    bttfn_loop();
+    bttfn_loop_ex();
+}
+
+static void sched_setup()
+{
+    // Order and audio slot (after every task) as before
+    sched_add("keypad",  keypad_loop,     0,  2000);
+    sched_add("scan/ntp",scanKeypad_ntp,  0,  2000);
+    sched_add("bttfn_sk",bttfn_loop_skip, 0,  5000);
+    sched_add("main",    main_loop,       0, 20000);
+    sched_add("wifi",    wifi_loop,       0, 10000);
+    sched_add("bttfn",   bttfn_loop_all,  0,  5000);
+    sched_setAudio(audio_loop, 0);
+}
 
 void setup()
 {
     Serial.begin(115200);
     Serial.println();
 
+    #ifdef TC_PROFILER
+    prof_setup();
+    #endif
+
     // I2C init
     // Make sure our i2c buf is 128 bytes
     Wire.setBufferSize(128);
     // PCF8574 only supports 100kHz, can't go to 400 here.
     // Also, speedo cable is usually quite long, play it safe.
     Wire.begin(-1, -1, 100000);
+    i2c_setup();
 
     main_boot();
     settings_setup();
@@ -1794,30 +1831,15 @@ void setup()
     audio_setup();
     keypad_setup();
     main_setup();
+    i2c_fastClock();
+    sched_setup();
 }
 
-#ifdef TC_PROFILER
-#include "zzProfiler.h"
-#else
 void loop()
 {
-    keypad_loop();
-    audio_loop();
-    scanKeypad();
-    ntp_loop();
-    audio_loop();
-    bttfn_loop(BNLP_SK_MC|BNLP_SK_NOTDATA|BNLP_SK_EXPIRE);
-    audio_loop();
-    main_loop();
-    audio_loop();
-    wifi_loop();
-    audio_loop();
-    bttfn_loop();
-    bttfn_loop_ex();
-    audio_loop();
+    sched_loop();
 }
-#endif
 
-#if defined(TC_DBG_TIME) || defined(TC_DBG_NET) || defined(TC_DBG_GPS) || defined(TC_DBG_GEN)
+#if defined(TC_DBG_TIME) || defined(TC_DBG_NET) || defined(TC_DBG_GPS) || defined(TC_DBG_GEN) || defined(TC_DBG_SCHED) || defined(TC_PROFILER)
 #warning "Debug output is enabled. Binary not suitable for release."
 #endif